@@ -21,6 +21,21 @@ if (NOT VULKAN_FOUND)
     CPMAddPackage("gh:khronosgroup/vulkan-hpp@1.3.246")
 endif()
 
+# The parallel standard algorithms of libstdc++ run on TBB, without it they run serially
+find_package(TBB)
+if (NOT TBB_FOUND)
+    CPMAddPackage(
+        NAME TBB
+        VERSION 2021.9.0
+        GITHUB_REPOSITORY oneapi-src/oneTBB
+        GIT_TAG v2021.9.0
+        OPTIONS
+            "TBB_TEST OFF"
+            "TBB_EXAMPLES OFF"
+            "TBB_STRICT OFF"
+    )
+endif()
+
 CPMAddPackage(
     NAME glfw3
     VERSION 3.3.9
@@ -73,17 +88,6 @@ add_library(stb_image INTERFACE EXCLUDE_FROM_ALL ${stb_SOURCE_DIR}/stb_image.h)
 target_include_directories(stb_image INTERFACE $<BUILD_INTERFACE:${stb_SOURCE_DIR}>)
 target_compile_definitions(stb_image INTERFACE "STB_IMAGE_IMPLEMENTATION")
 
-CPMAddPackage(
-    NAME TinyOBJLoader
-    VERSION 2.0.0-rc4
-    GITHUB_REPOSITORY tinyobjloader/tinyobjloader
-    DOWNLOAD_ONLY
-)
-
-add_library(tinyobj INTERFACE EXCLUDE_FROM_ALL "${TinyOBJLoader_SOURCE_DIR}/tiny_obj_loader.h")
-target_include_directories(tinyobj INTERFACE $<BUILD_INTERFACE:${TinyOBJLoader_SOURCE_DIR}>)
-target_compile_definitions(tinyobj INTERFACE "TINYOBJLOADER_IMPLEMENTATION")
-
 CPMAddPackage(
     NAME VulkanMemoryAllocator
     VERSION 3.0.1
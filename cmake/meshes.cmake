@@ -0,0 +1,18 @@
+file(GLOB MODEL_SOURCE_FILES CONFIGURE_DEPENDS "models/*.obj")
+
+# Convert models into binary mesh caches ahead of time, otherwise the first load of each model writes its cache
+foreach(MODEL ${MODEL_SOURCE_FILES})
+  get_filename_component(FILE_NAME ${MODEL} NAME_WE)
+  set(MESH "${PROJECT_BINARY_DIR}/models/${FILE_NAME}.mesh")
+  add_custom_command(
+    OUTPUT ${MESH}
+    COMMAND ${CMAKE_COMMAND} -E make_directory "${PROJECT_BINARY_DIR}/models/"
+    COMMAND $<TARGET_FILE:${PROJECT_NAME}> --convert-mesh "${PROJECT_BINARY_DIR}/models/${FILE_NAME}.obj" ${MESH}
+    DEPENDS ${MODEL} ${PROJECT_NAME})
+  list(APPEND MESH_CACHE_FILES ${MESH})
+endforeach(MODEL)
+
+add_custom_target(
+    Meshes
+    DEPENDS ${MESH_CACHE_FILES}
+    )
@@ -11,9 +11,19 @@ foreach(GLSL ${GLSL_SOURCE_FILES})
   list(APPEND SPIRV_BINARY_FILES ${SPIRV})
 endforeach(GLSL)
 
+# Pack every stage into one archive that the engine mmaps at startup
+add_executable(shader-packer "${CMAKE_CURRENT_SOURCE_DIR}/tools/shader_packer.cpp")
+set_target_properties(shader-packer PROPERTIES CXX_STANDARD 20)
+
+set(SHADER_ARCHIVE "${PROJECT_BINARY_DIR}/shaders/shaders.pak")
+add_custom_command(
+  OUTPUT ${SHADER_ARCHIVE}
+  COMMAND shader-packer ${SHADER_ARCHIVE} ${SPIRV_BINARY_FILES}
+  DEPENDS shader-packer ${SPIRV_BINARY_FILES})
+
 add_custom_target(
     Shaders 
-    DEPENDS ${SPIRV_BINARY_FILES}
+    DEPENDS ${SPIRV_BINARY_FILES} ${SHADER_ARCHIVE}
     )
 
 add_dependencies(${CMAKE_PROJECT_NAME} Shaders)
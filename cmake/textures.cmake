@@ -0,0 +1,19 @@
+file(GLOB TEXTURE_SOURCE_FILES CONFIGURE_DEPENDS "textures/*.png" "textures/*.jpg")
+
+# Block compress textures ahead of time, textures with a current .ktx2 copy next to them load that instead
+foreach(TEXTURE ${TEXTURE_SOURCE_FILES})
+  get_filename_component(FILE_NAME ${TEXTURE} NAME)
+  get_filename_component(FILE_NAME_WE ${TEXTURE} NAME_WE)
+  set(KTX2 "${PROJECT_BINARY_DIR}/textures/${FILE_NAME_WE}.ktx2")
+  add_custom_command(
+    OUTPUT ${KTX2}
+    COMMAND ${CMAKE_COMMAND} -E make_directory "${PROJECT_BINARY_DIR}/textures/"
+    COMMAND $<TARGET_FILE:${PROJECT_NAME}> --convert-texture "${PROJECT_BINARY_DIR}/textures/${FILE_NAME}" ${KTX2}
+    DEPENDS ${TEXTURE} ${PROJECT_NAME})
+  list(APPEND COMPRESSED_TEXTURE_FILES ${KTX2})
+endforeach(TEXTURE)
+
+add_custom_target(
+    Textures
+    DEPENDS ${COMPRESSED_TEXTURE_FILES}
+    )
@@ -1,12 +1,19 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(push_constant) uniform constants {
+	mat4x4 pvm;
+	uint texture_index;
+} draw;
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
 
 layout(location = 0) out vec4 outColor;
 
-layout(binding = 0) uniform sampler2D texSampler;
+// Bindless texture table shared by every pipeline
+layout(set = 0, binding = 0) uniform sampler2D textures[];
 
 void main() {
-	outColor = texture(texSampler, fragTexCoord);
+	outColor = texture(textures[nonuniformEXT(draw.texture_index)], fragTexCoord);
 }
\ No newline at end of file
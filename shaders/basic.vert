@@ -4,14 +4,12 @@
 //				y: -1(top), 1(bottom)
 
 layout(push_constant) uniform constants {
-	mat4x4 model;
-	mat4x4 view;
-	mat4x4 projection;
 	mat4x4 pvm;
-} mvp;
+	uint texture_index;
+} draw;
 
+// Location 1 is only filled by the full vertex layout, see engine::VertexLayout
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
@@ -19,9 +17,9 @@ layout(location = 1) out vec2 fragTexCoord;
 
 void main() {
 
-	gl_Position = mvp.pvm * vec4(inPosition, 1.0);
+	gl_Position = draw.pvm * vec4(inPosition, 1.0);
 
-	fragColor = inColor;
+	fragColor = vec3(1.0);
 	fragTexCoord = inTexCoord;
 	
 }
\ No newline at end of file
@@ -7,5 +7,5 @@ layout(location = 0) out vec4 outColor;
 void main() {
 
     vec2 coord = gl_PointCoord - vec2(0.5);
-    outColor = vec4(fragColor, 0.5 - length(coord));
+    outColor = vec4(fragColor, max(0.5 - length(coord), 0.0));
 }
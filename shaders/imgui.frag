@@ -1,7 +1,15 @@
 #version 450 core
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(push_constant) uniform uPushConstant {
+    vec2 uScale;
+    vec2 uTranslate;
+    uint uTexture;
+} pc;
+
 layout(location = 0) out vec4 fColor;
 
-layout(set=0, binding=0) uniform sampler2D sTexture;
+layout(set=0, binding=0) uniform sampler2D sTextures[];
 
 layout(location = 0) in struct {
     vec4 Color;
@@ -10,5 +18,5 @@ layout(location = 0) in struct {
 
 void main()
 {
-    fColor = In.Color * texture(sTexture, In.UV.st);
+    fColor = In.Color * texture(sTextures[nonuniformEXT(pc.uTexture)], In.UV.st);
 }
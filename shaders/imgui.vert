@@ -6,6 +6,7 @@ layout(location = 2) in vec4 aColor;
 layout(push_constant) uniform uPushConstant {
     vec2 uScale;
     vec2 uTranslate;
+    uint uTexture;
 } pc;
 
 out gl_PerVertex {
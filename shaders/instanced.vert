@@ -0,0 +1,24 @@
+#version 450
+
+layout(push_constant) uniform constants {
+	mat4x4 view_projection;
+	uint texture_index;
+} draw;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+
+// Per instance, advanced once for every instance of the draw
+layout(location = 3) in mat4x4 inTransform;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+void main() {
+
+	gl_Position = draw.view_projection * inTransform * vec4(inPosition, 1.0);
+
+	fragColor = vec3(1.0);
+	fragTexCoord = inTexCoord;
+	
+}
@@ -0,0 +1,34 @@
+#version 450
+
+layout(push_constant) uniform constants {
+	mat4x4 view_projection;
+} camera;
+
+struct Instance {
+	mat4 transform;
+	uint mesh;
+	uint texture;
+	uint padding[2];
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Instances {
+	Instance instances[];
+};
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) flat out uint fragTexture;
+
+void main() {
+
+	// Indirect draws carry the instance index in firstInstance
+	Instance instance = instances[gl_InstanceIndex];
+
+	gl_Position = camera.view_projection * instance.transform * vec4(inPosition, 1.0);
+
+	fragTexCoord = inTexCoord;
+	fragTexture = instance.texture;
+	
+}
\ No newline at end of file
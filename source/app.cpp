@@ -1,10 +1,16 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
 #include <memory>
-#include <ranges>
+#include <random>
 
 #include <imgui.h>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include "app.hpp"
 
+#include "engine/core/texture_loader.hpp"
 #include "engine/utils/logging.hpp"
 
 App::App (std::string_view title) {
@@ -38,18 +44,33 @@ App::App (std::string_view title) {
 
         static bool vsync = engine_settings.vsync;
         static int fps = engine_settings.fps_limit;
+        static bool additive_particles = engine_settings.additive_particles;
+        static bool dynamic_rendering = engine_settings.dynamic_rendering;
+        static float lod_threshold = engine_settings.lod_threshold;
         
         ImGui::Begin("Preferences", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
         if(ImGui::Checkbox("Verical Synchronization", &vsync))
             graphics_engine->set<"vsync">(vsync);
         if(ImGui::InputInt("FPS Limit", &fps, 1, 10, ImGuiInputTextFlags_EnterReturnsTrue))
             graphics_engine->set<"fps_limit">(fps);
+        if(ImGui::Checkbox("Additive Particles", &additive_particles))
+            graphics_engine->set<"additive_particles">(additive_particles);
+        if(ImGui::Checkbox("Dynamic Rendering", &dynamic_rendering))
+            graphics_engine->set<"dynamic_rendering">(dynamic_rendering);
+        if(ImGui::SliderFloat("LOD Threshold (px)", &lod_threshold, 0.0f, 8.0f))
+            graphics_engine->set<"lod_threshold">(lod_threshold);
         ImGui::End();
 
         ImGui::Begin("Available Objects", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
         for(auto[key, value] : objects)
             if(ImGui::RadioButton(key.data(), settings.selected_object == key))
                 settings.selected_object = key;
+        if(ImGui::RadioButton(scene_name.data(), settings.selected_object == scene_name))
+            settings.selected_object = scene_name;
+        if(ImGui::RadioButton(batch_name.data(), settings.selected_object == batch_name))
+            settings.selected_object = batch_name;
+        if(ImGui::RadioButton(graph_name.data(), settings.selected_object == graph_name))
+            settings.selected_object = graph_name;
         ImGui::End();
     };
 
@@ -59,6 +80,13 @@ App::~App ( ) {
 
     auto ec = glz::write_file(settings, "settings.json");
 
+    // GPU resources have to go before the engine tears down the device
+    scene.reset();
+    batcher.reset();
+    graph_batcher.reset();
+    graph = engine::SceneGraph();
+    objects.clear();
+
     delete graphics_engine;
     glfwTerminate();
 
@@ -117,7 +145,11 @@ void App::set_fullscreen (bool state) {
 
 }
 
-void App::run ( ) {
+void App::load_objects ( ) {
+
+    // Decoded on the loader's workers while the meshes below are loaded
+    engine::TextureLoader::prefetch("textures/image.jpg");
+    engine::TextureLoader::prefetch("textures/viking_room.png");
 
     auto vertices = std::vector<engine::Vertex> {
         {{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
@@ -131,12 +163,129 @@ void App::run ( ) {
         {{-0.5f, 0.5f, -0.5f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}
     };
 
-    auto indices = std::vector<uint16_t> { 0, 1, 2, 2, 3, 0,
+    auto indices = std::vector<uint32_t> { 0, 1, 2, 2, 3, 0,
                                            4, 5, 6, 6, 7, 4 };
 
+    auto layout = engine::parse_vertex_layout(settings.vertex_layout);
+    if (!layout) logw("Unknown vertex layout {}, selecting one automatically", settings.vertex_layout);
+
+    auto vertex_layout = layout.value_or(engine::VertexLayout::automatic);
+
+    objects["Rimuru Tempest"] = std::make_shared<engine::Object>("textures/image.jpg", vertices, indices, vertex_layout);
+    objects["Viking Room"] = std::make_shared<engine::Object>("textures/viking_room.png", "models/viking_room.obj", vertex_layout);
+
+}
+
+void App::place_randomly (std::size_t instance_count, std::size_t object_count,
+    std::function<void(std::size_t, const glm::mat4x4&)> place) {
+
+    auto generator = std::mt19937(42);
+    auto position = std::uniform_real_distribution(-4.0f, 4.0f);
+    auto angle = std::uniform_real_distribution(0.0f, glm::radians(360.0f));
+    auto scale = std::uniform_real_distribution(0.05f, 0.2f);
+    auto pick = std::uniform_int_distribution<std::size_t>(0, object_count - 1);
+
+    for (std::size_t i = 0; i < instance_count; ++i) {
+
+        auto object = pick(generator);
+
+        auto transform = glm::translate(glm::mat4(1.0f), glm::vec3(position(generator), position(generator), position(generator)));
+        transform = glm::rotate(transform, angle(generator), glm::vec3(0.0f, 0.0f, 1.0f));
+        transform = glm::scale(transform, glm::vec3(scale(generator)));
+
+        place(object, transform);
+
+    }
+
+}
+
+void App::make_scene (std::size_t instance_count) {
+
+    scene = std::make_shared<engine::Scene>();
+
+    auto meshes = std::vector<std::pair<uint32_t, uint32_t>>();
+    for (auto& [key, object] : objects)
+        meshes.emplace_back(scene->add_mesh(object->model), object->texture.get_index());
+
+    place_randomly(instance_count, meshes.size(), [&] (std::size_t object, const glm::mat4x4& transform) {
+        auto [mesh, texture] = meshes.at(object);
+        scene->add_instance(mesh, texture, transform);
+    });
+
+    scene->upload();
+
+}
+
+void App::make_batches (std::size_t instance_count) {
+
+    if (!batcher) batcher = std::make_shared<engine::InstanceBatcher>();
+    batcher->clear();
+
+    auto sources = std::vector<std::shared_ptr<engine::Object>>();
+    for (auto& [key, object] : objects) sources.push_back(object);
+
+    place_randomly(instance_count, sources.size(), [&] (std::size_t object, const glm::mat4x4& transform) {
+        batcher->submit(sources.at(object), transform);
+    });
+
+}
+
+// A spinning root carrying a ring of objects, each ring node carries a smaller object orbiting it
+void App::make_graph ( ) {
+
+    graph = engine::SceneGraph();
+    graph_orbits.clear();
+    graph_batcher = std::make_shared<engine::InstanceBatcher>();
+
+    graph_root = graph.add_node(glm::mat4(1.0f));
+
+    auto sources = std::vector<std::shared_ptr<engine::Object>>();
+    for (auto& [key, object] : objects) sources.push_back(object);
+
+    constexpr auto ring_size = 8;
+
+    for (auto i = 0; i < ring_size; ++i) {
+
+        auto angle = glm::radians(360.0f) * i / ring_size;
+
+        auto ring = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 0.0f, 1.0f));
+        ring = glm::translate(ring, glm::vec3(1.5f, 0.0f, 0.0f));
+        ring = glm::scale(ring, glm::vec3(0.4f));
+
+        auto node = graph.add_node(ring, graph_root, sources.at(i % sources.size()));
+        auto orbit = graph.add_node(glm::mat4(1.0f), node);
+
+        graph_orbits.push_back(orbit);
+        graph.add_node(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(1.2f, 0.0f, 0.0f)), glm::vec3(0.5f)),
+            orbit, sources.at((i + 1) % sources.size()));
+
+    }
+
+}
+
+void App::draw_graph ( ) {
 
-    objects["Rimuru Tempest"] = std::make_shared<engine::Object>("textures/image.jpg", vertices, indices);
-    objects["Viking Room"] = std::make_shared<engine::Object>("textures/viking_room.png", "models/viking_room.obj");
+    static auto start = std::chrono::high_resolution_clock::now();
+    auto time = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+
+    auto up = glm::vec3(0.0f, 0.0f, 1.0f);
+
+    graph.set_local_transform(graph_root, glm::rotate(glm::mat4(1.0f), time / 3 * glm::radians(90.0f), up));
+    for (auto orbit : graph_orbits)
+        graph.set_local_transform(orbit, glm::rotate(glm::mat4(1.0f), time * glm::radians(180.0f), up));
+
+    graph.update();
+
+    graph_batcher->clear();
+    graph.submit(*graph_batcher);
+
+    graphics_engine->draw(graph_batcher);
+
+}
+
+void App::run ( ) {
+
+    load_objects();
 
     auto callback = [] (GLFWwindow* window, int key, int scancode, int action, int mods) {
         auto app = reinterpret_cast<App*>(glfwGetWindowUserPointer(window));
@@ -160,8 +309,22 @@ void App::run ( ) {
     while (!glfwWindowShouldClose(window)) {
 
         glfwPollEvents();
-        graphics_engine->draw(objects.at(settings.selected_object));
+
+        // The generated modes are only built once they are first selected
+        if (settings.selected_object == scene_name) {
+            if (!scene) make_scene(10'000);
+            graphics_engine->draw(scene);
+        }
+        else if (settings.selected_object == batch_name) {
+            if (!batcher) make_batches(5'000);
+            graphics_engine->draw(batcher);
+        }
+        else if (settings.selected_object == graph_name) {
+            if (!graph_batcher) make_graph();
+            draw_graph();
+        }
+        else graphics_engine->draw(objects.at(settings.selected_object));
 
     }
 
-}
\ No newline at end of file
+}
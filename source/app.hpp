@@ -2,6 +2,8 @@
 
 #include <map>
 #include <cstddef>
+#include <functional>
+#include <span>
 #include <string_view>
 
 #include <GLFW/glfw3.h>
@@ -15,8 +17,9 @@ struct Settings {
     std::size_t height = 600;
 
     std::string selected_object = "Viking Room";
+    std::string vertex_layout = "quantized"; // full, compact, quantized or automatic, see engine::VertexLayout
 
-    GLZ_LOCAL_META(Settings, width, height, selected_object);
+    GLZ_LOCAL_META(Settings, width, height, selected_object, vertex_layout);
 
 };
 
@@ -30,6 +33,29 @@ class App {
     void set_fullscreen (bool state);
 
     std::map<std::string_view, std::shared_ptr<engine::Object>> objects;
+    std::shared_ptr<engine::Scene> scene;
+    std::shared_ptr<engine::InstanceBatcher> batcher;
+
+    engine::SceneGraph graph;
+    engine::NodeHandle graph_root;
+    std::vector<engine::NodeHandle> graph_orbits;
+    std::shared_ptr<engine::InstanceBatcher> graph_batcher;
+
+    static constexpr std::string_view scene_name = "Instanced Scene";
+    static constexpr std::string_view batch_name = "Instanced Objects";
+    static constexpr std::string_view graph_name = "Scene Graph";
+
+    void load_objects ( );
+
+    // Scatters instances of randomly picked objects through a volume around the origin,
+    // the fixed seed keeps benchmark runs comparable
+    static void place_randomly (std::size_t instance_count, std::size_t object_count,
+        std::function<void(std::size_t, const glm::mat4x4&)> place);
+
+    void make_scene (std::size_t instance_count);
+    void make_batches (std::size_t instance_count);
+    void make_graph ( );
+    void draw_graph ( );
 
     public:
 
@@ -38,4 +64,51 @@ class App {
 
     void run();
 
+    // Runs the benchmark whose flag is among the arguments, with the argument after the flag as its input.
+    // False when there is none. The benchmarks live in benchmarks.cpp
+    bool run_benchmark (std::span<const std::string_view> args);
+
+    // Prints the mean CPU command recording time of the instanced scene at growing instance counts
+    void benchmark_scene (std::size_t frame_count = 500);
+
+    // Compares one draw call per instance against batched instanced draws at growing instance counts
+    void benchmark_instancing (std::size_t frame_count = 200);
+
+    // Measures scene graph updates on 100k nodes when nothing, a few leaves or the root changed
+    void benchmark_graph (std::size_t update_count = 100);
+
+    // Reports OBJ parse and weld throughput, generates a two million triangle grid when no file is given
+    void benchmark_obj (std::string_view path = { });
+
+    // Compares parsing an OBJ with mapping its binary mesh cache
+    void benchmark_mesh_cache (std::string_view path = { });
+
+    // Prints vertex cache statistics before and after optimizing a mesh
+    void benchmark_mesh_optimizer (std::string_view path = { });
+
+    // Compares triangles drawn and frame time with and without LOD selection at growing camera distances
+    void benchmark_lod (std::size_t frame_count = 200);
+
+    // Compares memory footprint, fetched vertex bytes and frame time of a mesh in every vertex layout
+    void benchmark_vertex_layouts (std::string_view path = { }, std::size_t frame_count = 200);
+
+    // Compares triangles submitted and rendered and frame time with and without meshlet culling,
+    // draws a dense generated sphere when no file is given
+    void benchmark_clusters (std::string_view path = { }, std::size_t frame_count = 200);
+
+    // Compares loading every image of a directory one after the other with decoding on the loader's workers
+    void benchmark_textures (std::string_view directory = { });
+
+    // Compares an image as RGBA8 with its block compressed KTX2 conversion: encoding error, memory footprint, load
+    // time and the frame time of drawing layers of it back to front
+    void benchmark_texture_formats (std::string_view path = { }, std::size_t frame_count = 200);
+
+    // Compares load time and quality of mipmaps blitted by the device and filtered on the CPU. Quality is the PSNR
+    // of a level scaled back up to the image against the image, higher keeps more of its detail
+    void benchmark_mipmaps (std::string_view path = { });
+
+    // Reports the throughput of the CPU particle simulator at growing particle counts, in particles per second
+    // overall and per hardware thread
+    void benchmark_particles (std::size_t step_count = 200);
+
 };
\ No newline at end of file
@@ -0,0 +1,719 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <random>
+#include <span>
+#include <thread>
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "app.hpp"
+
+#include "engine/core/block_compression.hpp"
+#include "engine/core/ktx2.hpp"
+#include "engine/core/mesh_cache.hpp"
+#include "engine/core/mesh_optimizer.hpp"
+#include "engine/core/mipmaps.hpp"
+#include "engine/core/obj_loader.hpp"
+#include "engine/core/texture_loader.hpp"
+#include "engine/particle_simulator.hpp"
+#include "engine/utils/logging.hpp"
+
+namespace {
+
+    struct Benchmark {
+        std::string_view flag;
+        void (*run) (App& app, std::string_view argument); // the argument following the flag, empty when there is none
+    };
+
+    const auto benchmarks = std::array {
+        Benchmark { "--scene-benchmark", [] (App& app, std::string_view) { app.benchmark_scene(); } },
+        Benchmark { "--instancing-benchmark", [] (App& app, std::string_view) { app.benchmark_instancing(); } },
+        Benchmark { "--graph-benchmark", [] (App& app, std::string_view) { app.benchmark_graph(); } },
+        Benchmark { "--obj-benchmark", [] (App& app, std::string_view path) { app.benchmark_obj(path); } },
+        Benchmark { "--mesh-benchmark", [] (App& app, std::string_view path) { app.benchmark_mesh_cache(path); } },
+        Benchmark { "--optimize-benchmark", [] (App& app, std::string_view path) { app.benchmark_mesh_optimizer(path); } },
+        Benchmark { "--lod-benchmark", [] (App& app, std::string_view) { app.benchmark_lod(); } },
+        Benchmark { "--layout-benchmark", [] (App& app, std::string_view path) { app.benchmark_vertex_layouts(path); } },
+        Benchmark { "--cluster-benchmark", [] (App& app, std::string_view path) { app.benchmark_clusters(path); } },
+        Benchmark { "--texture-benchmark", [] (App& app, std::string_view directory) { app.benchmark_textures(directory); } },
+        Benchmark { "--ktx-benchmark", [] (App& app, std::string_view path) { app.benchmark_texture_formats(path); } },
+        Benchmark { "--mip-benchmark", [] (App& app, std::string_view path) { app.benchmark_mipmaps(path); } },
+        Benchmark { "--particle-benchmark", [] (App& app, std::string_view) { app.benchmark_particles(); } }
+    };
+
+}
+
+bool App::run_benchmark (std::span<const std::string_view> args) {
+
+    for (const auto& benchmark : benchmarks)
+        if (auto flag = std::ranges::find(args, benchmark.flag); flag != args.end()) {
+            benchmark.run(*this, std::next(flag) != args.end() ? *std::next(flag) : std::string_view());
+            return true;
+        }
+
+    return false;
+
+}
+
+void App::benchmark_scene (std::size_t frame_count) {
+
+    load_objects();
+
+    for (auto instance_count : std::array<std::size_t, 3> { 1'000, 10'000, 100'000 }) {
+
+        make_scene(instance_count);
+
+        auto total = 0.0;
+
+        for (std::size_t i = 0; i < frame_count && !glfwWindowShouldClose(window); ++i) {
+            glfwPollEvents();
+            graphics_engine->draw(scene);
+            total += graphics_engine->get_record_time();
+        }
+
+        fmt::print("{:>7} instances: {:.4f} ms mean command recording time over {} frames\n",
+            instance_count, total / frame_count, frame_count);
+
+    }
+
+}
+
+void App::benchmark_graph (std::size_t update_count) {
+
+    using hrc = std::chrono::high_resolution_clock;
+
+    constexpr std::size_t node_count = 100'000, branching = 8;
+
+    // Implicit tree like a heap, node i hangs below node (i - 1) / branching
+    auto benchmark = engine::SceneGraph();
+    auto nodes = std::vector<engine::NodeHandle>();
+
+    for (std::size_t i = 0; i < node_count; ++i) {
+        auto transform = glm::translate(glm::mat4(1.0f), glm::vec3(0.1f));
+        if (i == 0) nodes.push_back(benchmark.add_node(transform));
+        else nodes.push_back(benchmark.add_node(transform, nodes.at((i - 1) / branching)));
+    }
+
+    auto start = hrc::now();
+    benchmark.update();
+    auto build_time = std::chrono::duration<double, std::milli>(hrc::now() - start).count();
+
+    fmt::print("{} nodes, {} levels, first update with sorting {:.3f} ms\n", benchmark.get_size(), benchmark.get_depth(), build_time);
+
+    auto measure = [&] (std::string_view name, std::function<void(std::size_t)> change) {
+
+        auto start = hrc::now();
+
+        for (std::size_t i = 0; i < update_count; ++i) {
+            change(i);
+            benchmark.update();
+        }
+
+        auto duration = std::chrono::duration<double, std::milli>(hrc::now() - start).count() / update_count;
+        fmt::print("{:>16}: {:.4f} ms per update\n", name, duration);
+
+    };
+
+    auto generator = std::mt19937(42);
+    auto leaf = std::uniform_int_distribution<std::size_t>(node_count - node_count / branching, node_count - 1);
+
+    measure("static", [] (std::size_t) { });
+    measure("100 leaves moved", [&] (std::size_t i) {
+        for (auto j = 0; j < 100; ++j)
+            benchmark.set_local_transform(nodes.at(leaf(generator)), glm::translate(glm::mat4(1.0f), glm::vec3(0.1f * i)));
+    });
+    measure("root moved", [&] (std::size_t i) {
+        benchmark.set_local_transform(nodes.front(), glm::translate(glm::mat4(1.0f), glm::vec3(0.1f * i)));
+    });
+
+}
+
+void App::benchmark_obj (std::string_view path) {
+
+    auto file = std::filesystem::path(path);
+
+    if (file.empty()) {
+
+        constexpr auto size = 1000;
+
+        file = std::filesystem::temp_directory_path() / "obj_benchmark_grid.obj";
+        auto output = std::ofstream(file);
+
+        for (auto y = 0; y <= size; ++y) for (auto x = 0; x <= size; ++x)
+            output << fmt::format("v {:.6f} {:.6f} {:.6f}\n", float(x) / size, float(y) / size, float(x * y % 7) / 7);
+        for (auto y = 0; y <= size; ++y) for (auto x = 0; x <= size; ++x)
+            output << fmt::format("vt {:.6f} {:.6f}\n", float(x) / size, float(y) / size);
+
+        for (auto y = 0; y < size; ++y) for (auto x = 0; x < size; ++x) {
+            auto a = y * (size + 1) + x + 1, b = a + 1, c = a + size + 2, d = a + size + 1;
+            output << fmt::format("f {0}/{0} {1}/{1} {2}/{2}\nf {0}/{0} {2}/{2} {3}/{3}\n", a, b, c, d);
+        }
+
+    }
+
+    auto mesh = engine::load_obj(file);
+    const auto& statistics = mesh.statistics;
+
+    fmt::print("{}: {:.1f} MB, {} triangles, {} corners welded into {} vertices\n", file.string(),
+        statistics.bytes / 1e6, statistics.triangles, statistics.corners, statistics.vertices);
+    fmt::print("parse {:.1f} ms, {:.1f} MB/s\n", statistics.parse_time, statistics.bytes / 1e3 / statistics.parse_time);
+    fmt::print("weld {:.1f} ms, {:.1f} M corners/s\n", statistics.weld_time, statistics.corners / 1e3 / statistics.weld_time);
+
+}
+
+void App::benchmark_mesh_cache (std::string_view path) {
+
+    using hrc = std::chrono::high_resolution_clock;
+
+    auto source = std::filesystem::path(path.empty() ? "models/viking_room.obj" : path);
+    auto cache = std::filesystem::temp_directory_path() / source.filename().replace_extension(".mesh");
+
+    if (!engine::MeshCache::convert(source, cache)) return;
+
+    auto start = hrc::now();
+    auto mesh = engine::load_obj(source);
+    auto obj_time = std::chrono::duration<double, std::milli>(hrc::now() - start).count();
+
+    // Copying the streams out stands in for the copy into staging memory
+    start = hrc::now();
+    auto mapping = engine::MeshCache::open(source, cache);
+    auto vertices = std::vector<engine::Vertex>(mapping->get_vertices().begin(), mapping->get_vertices().end());
+    auto indices = std::vector<std::byte>(mapping->get_index_data().begin(), mapping->get_index_data().end());
+    auto cache_time = std::chrono::duration<double, std::milli>(hrc::now() - start).count();
+
+    auto cache_size = mapping->get_size();
+
+    fmt::print("{}: {} vertices, {} triangles\n", source.string(), vertices.size(), mesh.statistics.triangles);
+    fmt::print("obj   {:>9.3f} ms, {:>8.1f} MB/s of {:.1f} MB\n", obj_time, mesh.statistics.bytes / 1e3 / obj_time, mesh.statistics.bytes / 1e6);
+    fmt::print("cache {:>9.3f} ms, {:>8.1f} MB/s of {:.1f} MB, {:.1f}x faster\n", cache_time, cache_size / 1e3 / cache_time,
+        cache_size / 1e6, obj_time / cache_time);
+
+}
+
+void App::benchmark_mesh_optimizer (std::string_view path) {
+
+    auto source = std::filesystem::path(path.empty() ? "models/viking_room.obj" : path);
+    auto mesh = engine::load_obj(source);
+
+    auto fifo_sizes = std::array<std::size_t, 3> { 8, 16, 32 };
+    auto before = std::vector<engine::VertexCacheStatistics>();
+
+    for (auto size : fifo_sizes) before.push_back(engine::analyze_vertex_cache(mesh.indices, mesh.vertices.size(), size));
+
+    auto statistics = engine::optimize_mesh(mesh.vertices, mesh.indices);
+
+    fmt::print("{}: {} triangles, {} clusters, optimized in {:.3f} ms\n", source.string(), mesh.indices.size() / 3,
+        statistics.clusters, statistics.time);
+
+    for (std::size_t i = 0; i < fifo_sizes.size(); ++i) {
+        auto after = engine::analyze_vertex_cache(mesh.indices, mesh.vertices.size(), fifo_sizes[i]);
+        fmt::print("FIFO {:>2}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}\n", fifo_sizes[i],
+            before[i].acmr, after.acmr, before[i].atvr, after.atvr);
+    }
+
+}
+
+void App::benchmark_lod (std::size_t frame_count) {
+
+    using hrc = std::chrono::high_resolution_clock;
+
+    constexpr auto instance_count = std::size_t(2'000);
+
+    auto object = std::make_shared<engine::Object>("textures/viking_room.png", "models/viking_room.obj");
+    auto lod_batcher = std::make_shared<engine::InstanceBatcher>();
+
+    auto lods = object->model.get_lods();
+
+    fmt::print("{} levels of detail:", lods.size());
+    for (std::size_t lod = 0; lod < lods.size(); ++lod)
+        fmt::print(" {} triangles ({:.4f})", object->model.get_triangle_count(lod), lods[lod].error);
+    fmt::print("\n{:>8} {:>10} {:>12} {:>11} {:>10}\n", "distance", "threshold", "triangles", "draw calls", "frame ms");
+
+    auto eye = graphics_engine->get_camera_position();
+    auto direction = glm::normalize(graphics_engine->get_camera_target() - eye);
+
+    auto threshold = graphics_engine->get_settings().lod_threshold;
+    auto measured_threshold = threshold > 0 ? threshold : 1.0f;
+
+    for (auto distance : std::array { 0.5f, 1.0f, 2.0f, 4.0f, 8.0f }) {
+
+        // A cluster of instances around a point straight ahead of the camera
+        auto generator = std::mt19937(42);
+        auto offset = std::uniform_real_distribution(-0.25f, 0.25f);
+
+        lod_batcher->clear();
+
+        for (std::size_t i = 0; i < instance_count; ++i) {
+            auto position = eye + direction * distance + glm::vec3(offset(generator), offset(generator), offset(generator)) * distance;
+            lod_batcher->submit(object, glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.05f)));
+        }
+
+        for (auto lod_threshold : { 0.0f, measured_threshold }) {
+
+            graphics_engine->set<"lod_threshold">(lod_threshold);
+
+            auto start = hrc::now();
+
+            for (std::size_t frame = 0; frame < frame_count && !glfwWindowShouldClose(window); ++frame) {
+                glfwPollEvents();
+                graphics_engine->draw(lod_batcher);
+            }
+
+            auto frame_time = std::chrono::duration<double, std::milli>(hrc::now() - start).count() / frame_count;
+
+            fmt::print("{:>8.1f} {:>10} {:>12} {:>11} {:>10.4f}\n", distance, lod_threshold > 0 ? fmt::format("{:.1f} px", lod_threshold) : "off",
+                lod_batcher->get_triangle_count(), lod_batcher->get_draw_count(), frame_time);
+
+        }
+
+    }
+
+    graphics_engine->set<"lod_threshold">(threshold);
+
+}
+
+void App::benchmark_vertex_layouts (std::string_view path, std::size_t frame_count) {
+
+    using hrc = std::chrono::high_resolution_clock;
+
+    auto source = std::string(path.empty() ? "models/viking_room.obj" : path);
+    constexpr auto instance_count = std::size_t(5'000);
+
+    fmt::print("{:>9} {:>6} {:>10} {:>14} {:>10} {:>10}\n", "layout", "stride", "vertex KiB", "fetched MiB/f", "max error", "frame ms");
+
+    for (std::size_t i = 0; i < engine::vertex_layout_count; ++i) {
+
+        auto requested = static_cast<engine::VertexLayout>(i);
+        auto object = std::make_shared<engine::Object>("textures/viking_room.png", source, requested);
+
+        const auto& model = object->model;
+        auto layout = model.get_layout();
+        auto stride = engine::get_vertex_stride(layout);
+
+        // Every post transform cache miss fetches one vertex, the optimizer stats give the miss count
+        auto full_detail = model.get_indices().first(model.get_triangle_count() * 3);
+        auto misses = engine::analyze_vertex_cache(full_detail, model.get_vertices().size()).acmr * model.get_triangle_count();
+        auto fetched = misses * stride * instance_count;
+
+        // Largest distance between a position and what the vertex input reconstructs from the encoded stream
+        auto max_error = 0.0f;
+
+        if (layout == engine::VertexLayout::quantized) {
+
+            auto encoded = engine::encode_vertices(model.get_vertices(), layout, engine::get_bounds(model.get_vertices()));
+
+            for (std::size_t v = 0; v < model.get_vertices().size(); ++v) {
+                auto quantized = engine::QuantizedVertex();
+                std::memcpy(&quantized, encoded.data() + v * stride, stride);
+                auto normalized = glm::vec4(quantized.position[0], quantized.position[1], quantized.position[2], 65535.0f) / 65535.0f;
+                auto decoded = glm::vec3(model.get_dequantization() * normalized);
+                max_error = std::max(max_error, glm::length(decoded - model.get_vertices()[v].position));
+            }
+
+        }
+
+        auto layout_batcher = std::make_shared<engine::InstanceBatcher>();
+        place_randomly(instance_count, 1, [&] (std::size_t, const glm::mat4x4& transform) { layout_batcher->submit(object, transform); });
+
+        auto start = hrc::now();
+
+        for (std::size_t frame = 0; frame < frame_count && !glfwWindowShouldClose(window); ++frame) {
+            glfwPollEvents();
+            graphics_engine->draw(layout_batcher);
+        }
+
+        auto frame_time = std::chrono::duration<double, std::milli>(hrc::now() - start).count() / frame_count;
+
+        fmt::print("{:>9} {:>6} {:>10.1f} {:>14.1f} {:>10.6f} {:>10.4f}\n", engine::to_string(layout), stride,
+            model.get_vertices().size() * stride / 1024.0, fetched / (1024.0 * 1024.0), max_error, frame_time);
+
+    }
+
+}
+
+void App::benchmark_instancing (std::size_t frame_count) {
+
+    using hrc = std::chrono::high_resolution_clock;
+
+    load_objects();
+
+    fmt::print("{:>9} {:>10} {:>11} {:>10} {:>10}\n", "instances", "mode", "draw calls", "record ms", "frame ms");
+
+    for (auto instance_count : std::array<std::size_t, 4> { 100, 1'000, 5'000, 20'000 }) {
+
+        make_batches(instance_count);
+
+        for (auto batching : { false, true }) {
+
+            batcher->set_batching(batching);
+
+            auto record_time = 0.0;
+            auto start = hrc::now();
+
+            for (std::size_t i = 0; i < frame_count && !glfwWindowShouldClose(window); ++i) {
+                glfwPollEvents();
+                graphics_engine->draw(batcher);
+                record_time += graphics_engine->get_record_time();
+            }
+
+            auto frame_time = std::chrono::duration<double, std::milli>(hrc::now() - start).count() / frame_count;
+
+            fmt::print("{:>9} {:>10} {:>11} {:>10.4f} {:>10.4f}\n", instance_count, batching ? "instanced" : "per object",
+                batcher->get_draw_count(), record_time / frame_count, frame_time);
+
+        }
+
+    }
+
+}
+
+// UV sphere of radius one half around the origin with counter clockwise triangles seen from outside,
+// the poles repeat their vertex for every segment so texture coordinates stay continuous
+static void make_sphere (uint32_t rings, uint32_t segments, std::vector<engine::Vertex>& vertices, std::vector<uint32_t>& indices) {
+
+    for (uint32_t ring = 0; ring <= rings; ++ring) for (uint32_t segment = 0; segment <= segments; ++segment) {
+
+        auto polar = glm::pi<float>() * ring / rings;
+        auto azimuth = glm::two_pi<float>() * segment / segments;
+
+        vertices.push_back({
+            .position = glm::vec3(std::sin(polar) * std::cos(azimuth), std::sin(polar) * std::sin(azimuth), std::cos(polar)) * 0.5f,
+            .color = glm::vec3(1.0f),
+            .texture_coordinates = glm::vec2(float(segment) / segments, float(ring) / rings)
+        });
+
+    }
+
+    for (uint32_t ring = 0; ring < rings; ++ring) for (uint32_t segment = 0; segment < segments; ++segment) {
+
+        auto a = ring * (segments + 1) + segment, b = a + segments + 1, c = b + 1, d = a + 1;
+
+        // The first and last ring have one corner of each quad in the pole
+        if (ring + 1 != rings) indices.insert(indices.end(), { a, b, c });
+        if (ring != 0) indices.insert(indices.end(), { a, c, d });
+
+    }
+
+}
+
+void App::benchmark_clusters (std::string_view path, std::size_t frame_count) {
+
+    using hrc = std::chrono::high_resolution_clock;
+
+    auto object = std::shared_ptr<engine::Object>();
+
+    if (path.empty()) {
+        auto vertices = std::vector<engine::Vertex>();
+        auto indices = std::vector<uint32_t>();
+        make_sphere(250, 1000, vertices, indices);
+        engine::optimize_mesh(vertices, indices);
+        object = std::make_shared<engine::Object>("textures/viking_room.png", vertices, indices);
+    } else object = std::make_shared<engine::Object>("textures/viking_room.png", path);
+
+    auto renderer = std::make_shared<engine::ClusterRenderer>(object);
+
+    // A ring around the camera target, the instances behind the camera are left to frustum culling
+    constexpr auto instance_count = 8;
+
+    auto target = graphics_engine->get_camera_target();
+    auto sphere = object->model.get_bounding_sphere();
+    auto scale = 0.5f / sphere.w;
+
+    for (auto i = 0; i < instance_count; ++i) {
+        auto angle = glm::two_pi<float>() * i / instance_count;
+        auto position = target + glm::vec3(std::cos(angle), std::sin(angle), 0.0f) * 1.5f;
+        auto transform = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(scale));
+        renderer->add_instance(glm::translate(transform, -glm::vec3(sphere)));
+    }
+
+    renderer->upload();
+
+    fmt::print("{} triangles in {} meshlets, {} instances\n", object->model.get_triangle_count(), object->model.get_meshlets().size(), instance_count);
+    fmt::print("{:>8} {:>12} {:>12} {:>8} {:>10}\n", "culling", "submitted", "rendered", "culled", "frame ms");
+
+    for (auto culling : { false, true }) {
+
+        renderer->set_culling(culling);
+
+        auto start = hrc::now();
+
+        for (std::size_t frame = 0; frame < frame_count && !glfwWindowShouldClose(window); ++frame) {
+            glfwPollEvents();
+            graphics_engine->draw(renderer);
+        }
+
+        auto frame_time = std::chrono::duration<double, std::milli>(hrc::now() - start).count() / frame_count;
+
+        auto submitted = renderer->get_submitted_triangles();
+        auto rendered = renderer->get_rendered_triangles();
+
+        fmt::print("{:>8} {:>12} {:>12} {:>7.1f}% {:>10.4f}\n", culling ? "on" : "off", submitted, rendered,
+            submitted ? 100.0 * (submitted - rendered) / submitted : 0.0, frame_time);
+
+    }
+
+}
+
+void App::benchmark_textures (std::string_view directory) {
+
+    using hrc = std::chrono::high_resolution_clock;
+
+    auto paths = std::vector<std::filesystem::path>();
+    auto extensions = std::array<std::string_view, 6> { ".png", ".jpg", ".jpeg", ".bmp", ".tga", ".hdr" };
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory.empty() ? "textures" : directory)) {
+        auto extension = entry.path().extension().string();
+        std::ranges::transform(extension, extension.begin(), [] (unsigned char c) { return std::tolower(c); });
+        if (entry.is_regular_file() && std::ranges::find(extensions, extension) != extensions.end()) paths.push_back(entry.path());
+    }
+
+    std::ranges::sort(paths);
+
+    fmt::print("{} textures, {} decode workers\n", paths.size(), engine::TextureLoader::get_worker_count());
+    fmt::print("{:>9} {:>9} {:>9} {:>9} {:>9} {:>9}\n", "loading", "read", "decode", "mipmaps", "upload", "wall ms");
+
+    auto print = [] (std::string_view name, const engine::TextureLoadTimings& timings, double wall) {
+        fmt::print("{:>9} {:>9.2f} {:>9.2f} {:>9.2f} {:>9.2f} {:>9.2f}\n", name, timings.read, timings.decode, timings.mipmaps, timings.upload, wall);
+    };
+
+    {
+        auto timings = engine::TextureLoadTimings();
+        auto textures = std::vector<std::unique_ptr<engine::Texture>>();
+
+        auto start = hrc::now();
+
+        for (const auto& path : paths) {
+            auto image = engine::decode_image(path);
+            timings.read += image.read_time;
+            timings.decode += image.decode_time;
+            textures.push_back(std::make_unique<engine::Texture>(std::move(image), &timings));
+        }
+
+        print("serial", timings, std::chrono::duration<double, std::milli>(hrc::now() - start).count());
+    }
+
+    {
+        auto timings = engine::TextureLoadTimings();
+
+        auto start = hrc::now();
+        auto textures = engine::TextureLoader::load(paths, timings);
+
+        print("parallel", timings, std::chrono::duration<double, std::milli>(hrc::now() - start).count());
+    }
+
+}
+
+// Peak signal to noise ratio of the color of two RGBA8 images of the same size in decibels, alpha is left out
+static double get_psnr (std::span<const std::byte> reference, std::span<const std::byte> pixels) {
+
+    auto squared_error = 0.0;
+
+    for (std::size_t i = 0; i < reference.size(); ++i) {
+        if (i % 4 == 3) continue;
+        auto difference = std::to_integer<int>(reference[i]) - std::to_integer<int>(pixels[i]);
+        squared_error += difference * difference;
+    }
+
+    auto mean_error = squared_error / (reference.size() / 4 * 3);
+    return mean_error > 0 ? 10 * std::log10(255.0 * 255.0 / mean_error) : std::numeric_limits<double>::infinity();
+
+}
+
+void App::benchmark_texture_formats (std::string_view path, std::size_t frame_count) {
+
+    using hrc = std::chrono::high_resolution_clock;
+
+    auto source = std::filesystem::path(path.empty() ? "textures/viking_room.png" : path);
+    auto compressed = std::filesystem::temp_directory_path() / (source.stem().string() + ".ktx2");
+
+    auto start = hrc::now();
+    if (!engine::TextureLoader::convert(source, compressed)) return;
+    auto convert_time = std::chrono::duration<double, std::milli>(hrc::now() - start).count();
+
+    auto image = engine::decode_image(source);
+    auto file = engine::read_ktx2(compressed);
+    if (!file) return;
+
+    auto decoded = engine::decompress_blocks(file->levels.front(), file->width, file->height, *engine::get_block_format(file->format));
+
+    auto psnr = get_psnr(image.pixels, decoded);
+
+    fmt::print("{} {}x{} as {}, {} levels, {:.2f} dB PSNR, converted in {:.1f} ms\n", source.string(), image.width, image.height,
+        vk::to_string(file->format), file->levels.size(), psnr, convert_time);
+
+    // Quads facing the camera from the target towards it, drawn far to near so every layer passes the depth test
+    auto vertices = std::vector<engine::Vertex>();
+
+    for (auto corner : std::array<glm::vec2, 4> { glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1) })
+        vertices.push_back({ .position = glm::vec3(corner * 2.0f, 0.0f), .color = glm::vec3(1.0f), .texture_coordinates = (corner + 1.0f) * 4.0f });
+
+    auto indices = std::vector<uint32_t> { 0, 1, 2, 0, 2, 3, 0, 2, 1, 0, 3, 2 };
+
+    constexpr auto layer_count = 32;
+
+    auto camera = graphics_engine->get_camera_position();
+    auto target = graphics_engine->get_camera_target();
+
+    fmt::print("{:>8} {:>10} {:>10} {:>10}\n", "texture", "VRAM KiB", "load ms", "frame ms");
+
+    // Without the preference the source loads as RGBA8 even when the Textures target left a .ktx2 next to it
+    engine::TextureLoader::set_prefer_compressed(false);
+
+    for (auto texture : { source, compressed }) {
+
+        auto bytes = engine::perf_statistics["Texture bytes"];
+
+        start = hrc::now();
+        auto object = std::make_shared<engine::Object>(texture.string(), vertices, indices);
+        auto load_time = std::chrono::duration<double, std::milli>(hrc::now() - start).count();
+
+        bytes = engine::perf_statistics["Texture bytes"] - bytes;
+
+        auto renderer = std::make_shared<engine::ClusterRenderer>(object);
+        renderer->set_culling(false);
+
+        for (auto layer = 0; layer < layer_count; ++layer) {
+            auto position = glm::mix(target, camera, 0.8f * layer / layer_count);
+            renderer->add_instance(glm::inverse(glm::lookAt(position, camera, glm::vec3(0.0f, 0.0f, 1.0f))));
+        }
+
+        renderer->upload();
+
+        start = hrc::now();
+
+        for (std::size_t frame = 0; frame < frame_count && !glfwWindowShouldClose(window); ++frame) {
+            glfwPollEvents();
+            graphics_engine->draw(renderer);
+        }
+
+        auto frame_time = std::chrono::duration<double, std::milli>(hrc::now() - start).count() / frame_count;
+
+        fmt::print("{:>8} {:>10} {:>10.2f} {:>10.4f}\n", texture == source ? "RGBA8" : "BC", bytes / 1024, load_time, frame_time);
+
+    }
+
+    engine::TextureLoader::set_prefer_compressed(true);
+
+}
+
+// Bilinear scaling of RGBA8 pixels with texel centers aligned, as a sampler magnifies a smaller level
+static std::vector<std::byte> scale_bilinear (std::span<const std::byte> pixels, std::size_t width, std::size_t height,
+    std::size_t target_width, std::size_t target_height) {
+
+    auto result = std::vector<std::byte>(target_width * target_height * 4);
+
+    for (std::size_t y = 0; y < target_height; ++y) for (std::size_t x = 0; x < target_width; ++x) {
+
+        auto source_x = std::clamp((x + 0.5f) * width / target_width - 0.5f, 0.0f, float(width - 1));
+        auto source_y = std::clamp((y + 0.5f) * height / target_height - 0.5f, 0.0f, float(height - 1));
+
+        auto x0 = static_cast<std::size_t>(source_x), y0 = static_cast<std::size_t>(source_y);
+        auto x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+        auto fx = source_x - x0, fy = source_y - y0;
+
+        for (auto channel = 0; channel < 4; ++channel) {
+
+            auto texel = [&] (std::size_t tx, std::size_t ty) { return float(std::to_integer<uint8_t>(pixels[(ty * width + tx) * 4 + channel])); };
+
+            auto top = texel(x0, y0) * (1 - fx) + texel(x1, y0) * fx;
+            auto bottom = texel(x0, y1) * (1 - fx) + texel(x1, y1) * fx;
+
+            result[(y * target_width + x) * 4 + channel] = std::byte(static_cast<uint8_t>(std::round(top * (1 - fy) + bottom * fy)));
+
+        }
+
+    }
+
+    return result;
+
+}
+
+void App::benchmark_mipmaps (std::string_view path) {
+
+    using hrc = std::chrono::high_resolution_clock;
+
+    constexpr auto measured_levels = 3u;
+
+    auto paths = std::array { std::filesystem::path(path.empty() ? "textures/viking_room.png" : path) };
+    auto image = engine::decode_image(paths.front());
+
+    if (image.pixels.empty()) return;
+
+    fmt::print("{} {}x{}, PSNR of levels 1 to {} scaled back up\n", paths.front().string(), image.width, image.height, measured_levels);
+    fmt::print("{:>8} {:>9} {:>9} {:>9} {:>9} {:>8} {:>8} {:>8}\n", "filter", "decode", "mipmaps", "upload", "wall ms", "level 1", "level 2", "level 3");
+
+    auto previous = engine::TextureLoader::get_mip_filter();
+
+    for (auto filter : { engine::MipFilter::blit, engine::MipFilter::box, engine::MipFilter::kaiser, engine::MipFilter::lanczos }) {
+
+        engine::TextureLoader::set_mip_filter(filter);
+
+        auto timings = engine::TextureLoadTimings();
+
+        auto start = hrc::now();
+        auto textures = engine::TextureLoader::load(paths, timings);
+        auto wall_time = std::chrono::duration<double, std::milli>(hrc::now() - start).count();
+
+        fmt::print("{:>8} {:>9.2f} {:>9.2f} {:>9.2f} {:>9.2f}", engine::to_string(filter), timings.decode, timings.mipmaps, timings.upload, wall_time);
+
+        for (uint32_t level = 1; level <= measured_levels && level < textures.front()->get_mip_levels(); ++level) {
+            auto pixels = textures.front()->read_level(level);
+            if (pixels.empty()) break;
+            auto scaled = scale_bilinear(pixels, engine::get_mip_extent(image.width, level), engine::get_mip_extent(image.height, level), image.width, image.height);
+            fmt::print(" {:>8.2f}", get_psnr(image.pixels, scaled));
+        }
+
+        fmt::print("\n");
+
+    }
+
+    engine::TextureLoader::set_mip_filter(previous);
+
+}
+
+void App::benchmark_particles (std::size_t step_count) {
+
+    using hrc = std::chrono::high_resolution_clock;
+
+    auto threads = std::max(1u, std::thread::hardware_concurrency());
+
+    auto generator = std::mt19937(42);
+    auto position = std::uniform_real_distribution<float>(-1.f, 1.f);
+    auto velocity = std::uniform_real_distribution<float>(-0.5f, 0.5f);
+
+    fmt::print("CPU particle simulation on {} hardware threads, {} steps each\n", threads, step_count);
+
+    for (auto particle_count : std::array<std::size_t, 4> { 4'096, 65'536, 1'048'576, 8'388'608 }) {
+
+        auto particles = std::vector<engine::Particle>(particle_count);
+
+        for (auto& particle : particles) {
+            particle.position = { position(generator), position(generator) };
+            particle.velocity = { velocity(generator), velocity(generator) };
+            particle.color = glm::vec4(1.f);
+        }
+
+        auto simulator = engine::ParticleSimulator(particles);
+
+        auto start = hrc::now();
+        for (std::size_t i = 0; i < step_count; ++i) simulator.step(1e-3f);
+        auto seconds = std::chrono::duration<double>(hrc::now() - start).count();
+
+        auto throughput = particle_count * step_count / seconds;
+
+        fmt::print("{:>9} particles in {:>4} chunks: {:>8.1f} M particles/s, {:>7.1f} M particles/s per core\n",
+            particle_count, simulator.get_chunk_count(), throughput / 1e6, throughput / threads / 1e6);
+
+    }
+
+}
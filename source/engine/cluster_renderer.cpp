@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cstring>
+
+#include "cluster_renderer.hpp"
+#include "engine.hpp"
+
+#include "core/descriptor_allocator.hpp"
+#include "core/layout_cache.hpp"
+#include "core/pipeline_registry.hpp"
+#include "core/shaders.hpp"
+#include "core/texture_table.hpp"
+
+#include "utils/utils.hpp"
+#include "utils/logging.hpp"
+
+namespace engine {
+
+    // Push constants of shaders/cluster_cull.comp
+    struct ClusterCullConstants {
+        std::array<glm::vec4, 6> planes;
+        glm::vec4 camera_position;
+        uint32_t index_stride;
+        uint32_t culling;
+        uint32_t first_instance;
+    };
+
+    ClusterRenderer::ClusterRenderer (std::shared_ptr<Object> object) : object(object) {
+
+        object->model.build_meshlets();
+
+        auto reflection = Shader::reflect("shaders/cluster_cull");
+
+        cull_layout = LayoutCache::get_pipeline_layout(reflection);
+        cull_pipeline = PipelineRegistry::acquire_compute(cull_layout, "shaders/cluster_cull");
+
+        draw_layout = LayoutCache::get_pipeline_layout("shaders/instanced");
+
+        // One workgroup per meshlet along x and per instance along y, instances past the limit go to further dispatches
+        auto max_groups = device->get_gpu().getProperties().limits.maxComputeWorkGroupCount;
+        if (object->model.get_meshlets().size() > max_groups[0])
+            loge("Model has {} meshlets, more than the {} workgroups a dispatch can have", object->model.get_meshlets().size(), max_groups[0]);
+
+        max_instance_groups = max_groups[1];
+
+    }
+
+    ClusterRenderer::~ClusterRenderer ( ) {
+
+        // Frames in flight may still read the meshlet, index and indirect buffers
+        device->get_handle().waitIdle();
+
+        cull_pipeline.reset();
+        draw_pipeline.reset();
+
+    }
+
+    void ClusterRenderer::add_instance (const glm::mat4x4& transform) {
+
+        transforms.push_back(transform);
+
+    }
+
+    std::size_t ClusterRenderer::get_submitted_triangles ( ) const {
+
+        return object->model.get_triangle_count() * transforms.size();
+
+    }
+
+    void ClusterRenderer::upload ( ) {
+
+        SCOPED_PERF_LOG;
+
+        using enum vk::BufferUsageFlagBits;
+
+        const auto& model = object->model;
+        auto meshlets = model.get_meshlets();
+        auto meshlet_indices = model.get_meshlet_indices();
+
+        meshlet_buffer = std::make_unique<Buffer>(meshlets.size_bytes(), eStorageBuffer, false, true);
+        meshlet_buffer->write(meshlets.data());
+
+        meshlet_index_buffer = std::make_unique<Buffer>(meshlet_indices.size_bytes(), eStorageBuffer, false, true);
+        meshlet_index_buffer->write(meshlet_indices.data());
+
+        auto instances = std::vector<InstanceData>();
+        for (const auto& transform : transforms) instances.push_back({ .transform = transform * model.get_dequantization() });
+
+        transform_buffer = std::make_unique<Buffer>(transforms.size() * sizeof(glm::mat4x4), eStorageBuffer, false, true);
+        transform_buffer->write(transforms.data());
+
+        instance_buffer = std::make_unique<Buffer>(instances.size() * sizeof(InstanceData), eVertexBuffer, false, true);
+        instance_buffer->write(instances.data());
+
+        // Every instance draws from its own range, the cull pass only ever raises the index counts
+        index_stride = to_u32(meshlet_indices.size());
+        initial_commands.clear();
+
+        for (uint32_t i = 0; i < transforms.size(); ++i)
+            initial_commands.push_back({ .indexCount = 0, .instanceCount = 1, .firstIndex = i * index_stride, .vertexOffset = 0, .firstInstance = i });
+
+        // Frame resources refer to the old buffers
+        command_buffers.clear();
+        index_buffers.clear();
+        cull_sets.clear();
+
+        logi("Uploaded {} meshlets for {} instances, {} KiB of indices per frame", meshlets.size(), transforms.size(),
+            transforms.size() * meshlet_indices.size_bytes() / 1024);
+
+    }
+
+    void ClusterRenderer::make_frame (uint32_t index) {
+
+        using enum vk::BufferUsageFlagBits;
+
+        command_buffers.resize(index + 1);
+        index_buffers.resize(index + 1);
+        cull_sets.resize(index + 1);
+
+        auto& command_buffer = command_buffers.at(index);
+        auto& index_buffer = index_buffers.at(index);
+
+        command_buffer = std::make_unique<Buffer>(initial_commands.size() * sizeof(vk::DrawIndexedIndirectCommand), eStorageBuffer | eIndirectBuffer, true, false, true);
+        std::memcpy(command_buffer->get_mapped(), initial_commands.data(), command_buffer->get_size());
+        command_buffer->flush();
+
+        index_buffer = std::make_unique<Buffer>(std::size_t(index_stride) * transforms.size() * sizeof(uint32_t), eStorageBuffer | eIndexBuffer, false, true);
+
+        auto cull_reflection = Shader::reflect("shaders/cluster_cull");
+        auto cull_set_layout = LayoutCache::get_set_layout(cull_reflection.descriptor_sets.at(0));
+
+        auto storage_binding = [] (uint32_t binding, const Buffer& buffer) {
+            return DescriptorBinding {
+                .binding = binding,
+                .type = vk::DescriptorType::eStorageBuffer,
+                .buffer = { .buffer = buffer.get_handle(), .offset = 0, .range = VK_WHOLE_SIZE }
+            };
+        };
+
+        auto bindings = std::array {
+            storage_binding(0, *meshlet_buffer),
+            storage_binding(1, *meshlet_index_buffer),
+            storage_binding(2, *transform_buffer),
+            storage_binding(3, *command_buffer),
+            storage_binding(4, *index_buffer)
+        };
+
+        cull_sets.at(index) = DescriptorAllocator::get(cull_set_layout, bindings);
+
+    }
+
+    void ClusterRenderer::make_draw_pipeline (vk::RenderPass render_pass) {
+
+        auto sample_count = get_max_sample_count(device->get_gpu());
+        auto layout = object->model.get_layout();
+
+        this->render_pass = render_pass;
+        draw_pipeline = PipelineRegistry::acquire({
+            .binding_description = get_binding_description(layout),
+            .attribute_descriptions = get_attribute_descriptions(layout),
+            .instance_binding_description = InstanceData::get_binding_description(),
+            .instance_attribute_descriptions = InstanceData::get_attribute_descriptions(),
+            .multisampling_info = create_multisampling_info(sample_count, true),
+            .layout = draw_layout,
+            .render_pass = render_pass,
+            .shader_path = "shaders/instanced"
+        });
+
+    }
+
+    void ClusterRenderer::record_cull (const vk::CommandBuffer& commands, uint32_t index, const glm::mat4x4& view_projection,
+        const glm::vec3& camera_position) {
+
+        SCOPED_PERF_LOG;
+
+        if (transforms.empty() || !meshlet_buffer) return;
+
+        if (index >= command_buffers.size() || !command_buffers.at(index)) make_frame(index);
+        else {
+
+            // Recording starts after SwapChain::acquire_image waited for the frame's fence, so the last cull of this
+            // frame index is complete and its writes were made available to the host by the barrier below
+            const auto& command_buffer = command_buffers.at(index);
+            auto results = static_cast<vk::DrawIndexedIndirectCommand*>(command_buffer->get_mapped());
+
+            command_buffer->invalidate();
+
+            rendered_triangles = 0;
+            for (std::size_t i = 0; i < initial_commands.size(); ++i) rendered_triangles += results[i].indexCount / 3;
+
+            std::memcpy(results, initial_commands.data(), initial_commands.size() * sizeof(vk::DrawIndexedIndirectCommand));
+            command_buffer->flush();
+
+        }
+
+        auto constants = ClusterCullConstants {
+            .planes = get_frustum_planes(view_projection),
+            .camera_position = glm::vec4(camera_position, 1.f),
+            .index_stride = index_stride,
+            .culling = is_culling
+        };
+
+        commands.bindPipeline(vk::PipelineBindPoint::eCompute, cull_pipeline->get());
+        commands.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cull_layout, 0, 1, &cull_sets.at(index), 0, nullptr);
+
+        auto instance_count = to_u32(transforms.size());
+
+        for (uint32_t first = 0; first < instance_count; first += max_instance_groups) {
+            constants.first_instance = first;
+            commands.pushConstants(cull_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(ClusterCullConstants), &constants);
+            commands.dispatch(to_u32(object->model.get_meshlets().size()), std::min(max_instance_groups, instance_count - first), 1);
+        }
+
+        // The draw reads the commands and indices, the host reads the index counts back once the fence signals
+        auto cull_barrier = vk::MemoryBarrier {
+            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+            .dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eHostRead
+        };
+
+        commands.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eHost,
+            vk::DependencyFlags(), 1, &cull_barrier, 0, nullptr, 0, nullptr);
+
+        perf_statistics["Cluster triangles submitted"] = get_submitted_triangles();
+        perf_statistics["Cluster triangles rendered"] = rendered_triangles;
+
+    }
+
+    void ClusterRenderer::draw (const vk::CommandBuffer& commands, uint32_t index, const glm::mat4x4& view_projection, vk::RenderPass render_pass) {
+
+        SCOPED_PERF_LOG;
+
+        if (transforms.empty() || index >= command_buffers.size() || !command_buffers.at(index)) return;
+        if (!draw_pipeline || render_pass != this->render_pass) make_draw_pipeline(render_pass);
+
+        constexpr auto stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+
+        auto texture_index = object->texture.get_index();
+        auto offsets = std::array<vk::DeviceSize, 1> { };
+
+        commands.bindPipeline(vk::PipelineBindPoint::eGraphics, draw_pipeline->get());
+        TextureTable::bind(commands, draw_layout);
+        commands.pushConstants(draw_layout, stages, 0, sizeof(glm::mat4x4), &view_projection);
+        commands.pushConstants(draw_layout, stages, offsetof(DrawConstants, texture_index), sizeof(uint32_t), &texture_index);
+        commands.bindVertexBuffers(0, 1, &object->model.get_vertex(), offsets.data());
+        commands.bindVertexBuffers(1, 1, &instance_buffer->get_handle(), offsets.data());
+        commands.bindIndexBuffer(index_buffers.at(index)->get_handle(), 0, vk::IndexType::eUint32);
+
+        commands.drawIndexedIndirect(command_buffers.at(index)->get_handle(), 0, to_u32(transforms.size()), sizeof(vk::DrawIndexedIndirectCommand));
+
+    }
+
+}
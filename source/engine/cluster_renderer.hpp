@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "core/device.hpp"
+#include "core/memory.hpp"
+#include "core/pipeline.hpp"
+
+#include "utils/primitives.hpp"
+
+namespace engine {
+
+    struct Object;
+
+    // Draws the instances of one object with meshlet culling and without mesh shaders: a compute pass tests every
+    // meshlet of every instance against the frustum and its normal cone, and appends the indices of survivors to
+    // the instance's range of an index buffer. One drawIndexedIndirect then draws every instance from its range
+    class ClusterRenderer {
+
+        std::shared_ptr<Device> device = Device::get();
+
+        std::shared_ptr<Object> object;
+        std::vector<glm::mat4x4> transforms;
+
+        std::unique_ptr<Buffer> meshlet_buffer;
+        std::unique_ptr<Buffer> meshlet_index_buffer;
+        std::unique_ptr<Buffer> transform_buffer; // model matrices the meshlet bounds are culled with
+        std::unique_ptr<Buffer> instance_buffer;  // the same with the dequantization folded in, read by the vertex input
+
+        std::vector<vk::DrawIndexedIndirectCommand> initial_commands;
+
+        // Per frame in flight, created on first use of a frame index. Commands are host visible and cached, they
+        // are reset and their index counts read back by the CPU once the frame's fence has signalled
+        std::vector<std::unique_ptr<Buffer>> command_buffers;
+        std::vector<std::unique_ptr<Buffer>> index_buffers;
+        std::vector<vk::DescriptorSet> cull_sets;
+
+        vk::PipelineLayout cull_layout;
+        vk::PipelineLayout draw_layout;
+        std::shared_ptr<PipelineHandle> cull_pipeline;
+        std::shared_ptr<PipelineHandle> draw_pipeline;
+        vk::RenderPass render_pass;
+
+        uint32_t index_stride = 0; // indices reserved per instance, every meshlet of the model fits
+        uint32_t max_instance_groups = 1; // instances one cull dispatch covers, maxComputeWorkGroupCount along y
+        bool is_culling = true;
+        std::size_t rendered_triangles = 0;
+
+        void make_frame (uint32_t index);
+        void make_draw_pipeline (vk::RenderPass render_pass);
+
+        public:
+
+        // Builds the object's meshlets unless it has them already
+        ClusterRenderer (std::shared_ptr<Object> object);
+        ~ClusterRenderer ( );
+
+        void add_instance (const glm::mat4x4& transform);
+
+        // Moves meshlets and instances to the GPU, must be called after the instances are added
+        void upload ( );
+
+        void record_cull (const vk::CommandBuffer& commands, uint32_t index, const glm::mat4x4& view_projection,
+            const glm::vec3& camera_position);
+        void draw (const vk::CommandBuffer& commands, uint32_t index, const glm::mat4x4& view_projection, vk::RenderPass render_pass);
+
+        // Without culling every meshlet is appended, the same triangles as drawing the whole mesh
+        constexpr void set_culling (bool enabled) { is_culling = enabled; }
+
+        std::size_t get_submitted_triangles ( ) const;
+
+        // Counted by the cull pass, so it trails the frames recorded by the number of frames in flight
+        constexpr std::size_t get_rendered_triangles ( ) const { return rendered_triangles; }
+        constexpr std::size_t get_instance_count ( ) const { return transforms.size(); }
+
+    };
+
+}
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <execution>
+#include <limits>
+#include <numeric>
+
+#include "block_compression.hpp"
+
+namespace engine {
+
+    namespace {
+
+        using Texels = std::array<glm::vec4, block_extent * block_extent>;
+
+        uint16_t pack_565 (const glm::vec3& color) {
+
+            auto quantize = [] (float value, float max) { return static_cast<uint16_t>(std::clamp(std::round(value * max / 255.f), 0.f, max)); };
+            return quantize(color.r, 31) << 11 | quantize(color.g, 63) << 5 | quantize(color.b, 31);
+
+        }
+
+        glm::vec3 unpack_565 (uint16_t color) {
+
+            auto r = color >> 11 & 31, g = color >> 5 & 63, b = color & 31;
+            return glm::vec3(r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2);
+
+        }
+
+        // Colors the four indices of a block stand for, three colors and black when the first endpoint isn't the larger
+        std::array<glm::vec3, 4> get_palette (uint16_t first, uint16_t second, bool four_colors) {
+
+            auto a = unpack_565(first), b = unpack_565(second);
+
+            if (four_colors || first > second) return { a, b, glm::round((a * 2.f + b) / 3.f), glm::round((a + b * 2.f) / 3.f) };
+            return { a, b, glm::round((a + b) / 2.f), glm::vec3(0.f) };
+
+        }
+
+        struct ColorFit {
+            uint16_t first;
+            uint16_t second;
+            uint32_t indices = 0;
+            float error = 0;
+        };
+
+        // Endpoints are ordered so the block decodes in four color mode, equal endpoints give every texel index 0
+        ColorFit fit_indices (const Texels& texels, const glm::vec3& first, const glm::vec3& second) {
+
+            auto fit = ColorFit { pack_565(first), pack_565(second) };
+            if (fit.first < fit.second) std::swap(fit.first, fit.second);
+
+            auto palette = get_palette(fit.first, fit.second, true);
+
+            for (std::size_t i = 0; i < texels.size(); ++i) {
+
+                auto best = uint32_t(0);
+                auto best_error = std::numeric_limits<float>::max();
+
+                for (uint32_t candidate = 0; candidate < (fit.first == fit.second ? 1u : 4u); ++candidate) {
+                    auto difference = glm::vec3(texels[i]) - palette[candidate];
+                    auto error = glm::dot(difference, difference);
+                    if (error < best_error) best = candidate, best_error = error;
+                }
+
+                fit.indices |= best << (i * 2);
+                fit.error += best_error;
+
+            }
+
+            return fit;
+
+        }
+
+        // Endpoints along the principal axis of the colors, refined once by least squares over the chosen indices
+        void encode_color (const Texels& texels, std::byte* output) {
+
+            auto mean = glm::vec3(0.f);
+            for (const auto& texel : texels) mean += glm::vec3(texel);
+            mean /= float(texels.size());
+
+            auto covariance = glm::mat3(0.f);
+            auto minimum = glm::vec3(255.f), maximum = glm::vec3(0.f);
+
+            for (const auto& texel : texels) {
+                auto offset = glm::vec3(texel) - mean;
+                covariance += glm::outerProduct(offset, offset);
+                minimum = glm::min(minimum, glm::vec3(texel));
+                maximum = glm::max(maximum, glm::vec3(texel));
+            }
+
+            auto axis = maximum - minimum;
+
+            for (auto iteration = 0; iteration < 8 && glm::dot(axis, axis) > 0; ++iteration) {
+                axis = covariance * axis;
+                auto length = glm::length(axis);
+                if (length > 0) axis /= length;
+            }
+
+            auto low = 0.f, high = 0.f;
+
+            if (glm::dot(axis, axis) > 0) for (const auto& texel : texels) {
+                auto projection = glm::dot(glm::vec3(texel) - mean, axis);
+                low = std::min(low, projection);
+                high = std::max(high, projection);
+            }
+
+            // Pulling the endpoints in a little lowers the error of the colors between them
+            auto inset = (high - low) / 16.f;
+            auto fit = fit_indices(texels, mean + axis * (high - inset), mean + axis * (low + inset));
+
+            // Index weights of the first endpoint in palette order
+            constexpr auto weights = std::array { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+
+            auto aa = 0.f, ab = 0.f, bb = 0.f;
+            auto ax = glm::vec3(0.f), bx = glm::vec3(0.f);
+
+            for (std::size_t i = 0; i < texels.size(); ++i) {
+                auto w = weights[fit.indices >> (i * 2) & 3];
+                aa += w * w;
+                ab += w * (1 - w);
+                bb += (1 - w) * (1 - w);
+                ax += glm::vec3(texels[i]) * w;
+                bx += glm::vec3(texels[i]) * (1 - w);
+            }
+
+            if (auto determinant = aa * bb - ab * ab; std::abs(determinant) > 1e-6f) {
+                auto first = glm::clamp((ax * bb - bx * ab) / determinant, 0.f, 255.f);
+                auto second = glm::clamp((bx * aa - ax * ab) / determinant, 0.f, 255.f);
+                if (auto refined = fit_indices(texels, first, second); refined.error < fit.error) fit = refined;
+            }
+
+            std::memcpy(output, &fit.first, 2);
+            std::memcpy(output + 2, &fit.second, 2);
+            std::memcpy(output + 4, &fit.indices, 4);
+
+        }
+
+        // Endpoints at the extremes in eight value mode, every texel takes the nearest of the values between them
+        void encode_alpha (const Texels& texels, std::byte* output) {
+
+            auto [low, high] = std::minmax_element(texels.begin(), texels.end(), [] (const glm::vec4& a, const glm::vec4& b) { return a.a < b.a; });
+            auto first = static_cast<uint8_t>(high->a), second = static_cast<uint8_t>(low->a);
+
+            auto values = std::array<float, 8> { float(first), float(second) };
+            for (auto k = 2; k < 8; ++k) values[k] = std::round(((8 - k) * first + (k - 1) * second) / 7.f);
+
+            auto indices = uint64_t(0);
+
+            for (std::size_t i = 0; i < texels.size() && first != second; ++i) {
+                auto nearest = std::ranges::min_element(values, { }, [&] (float value) { return std::abs(value - texels[i].a); });
+                indices |= uint64_t(nearest - values.begin()) << (i * 3);
+            }
+
+            output[0] = std::byte(first);
+            output[1] = std::byte(second);
+            std::memcpy(output + 2, &indices, 6);
+
+        }
+
+        void decode_color (const std::byte* input, std::span<glm::vec4, block_extent * block_extent> texels, bool four_colors) {
+
+            uint16_t first, second;
+            uint32_t indices;
+
+            std::memcpy(&first, input, 2);
+            std::memcpy(&second, input + 2, 2);
+            std::memcpy(&indices, input + 4, 4);
+
+            auto palette = get_palette(first, second, four_colors);
+            auto transparent = !four_colors && first <= second;
+
+            for (std::size_t i = 0; i < texels.size(); ++i) {
+                auto index = indices >> (i * 2) & 3;
+                texels[i] = glm::vec4(palette[index], transparent && index == 3 ? 0.f : 255.f);
+            }
+
+        }
+
+        void decode_alpha (const std::byte* input, std::span<glm::vec4, block_extent * block_extent> texels) {
+
+            auto first = std::to_integer<uint8_t>(input[0]), second = std::to_integer<uint8_t>(input[1]);
+
+            auto indices = uint64_t(0);
+            std::memcpy(&indices, input + 2, 6);
+
+            auto values = std::array<float, 8> { float(first), float(second) };
+
+            if (first > second) for (auto k = 2; k < 8; ++k) values[k] = std::round(((8 - k) * first + (k - 1) * second) / 7.f);
+            else {
+                for (auto k = 2; k < 6; ++k) values[k] = std::round(((6 - k) * first + (k - 1) * second) / 5.f);
+                values[6] = 0;
+                values[7] = 255;
+            }
+
+            for (std::size_t i = 0; i < texels.size(); ++i) texels[i].a = values[indices >> (i * 3) & 7];
+
+        }
+
+    }
+
+    std::optional<BlockFormat> get_block_format (vk::Format format) {
+
+        for (auto candidate : { BlockFormat::bc1, BlockFormat::bc3 })
+            if (get_vk_format(candidate) == format) return candidate;
+
+        return std::nullopt;
+
+    }
+
+    BlockFormat pick_block_format (std::span<const std::byte> pixels) {
+
+        for (std::size_t i = 3; i < pixels.size(); i += 4)
+            if (std::to_integer<uint8_t>(pixels[i]) != 255) return BlockFormat::bc3;
+
+        return BlockFormat::bc1;
+
+    }
+
+    std::vector<std::byte> compress_blocks (std::span<const std::byte> pixels, std::size_t width, std::size_t height, BlockFormat format) {
+
+        auto blocks_x = (width + block_extent - 1) / block_extent;
+        auto blocks_y = (height + block_extent - 1) / block_extent;
+        auto block_size = get_block_size(format);
+
+        auto blocks = std::vector<std::byte>(blocks_x * blocks_y * block_size);
+
+        auto rows = std::vector<std::size_t>(blocks_y);
+        std::iota(rows.begin(), rows.end(), 0);
+
+        std::for_each(std::execution::par, rows.begin(), rows.end(), [&] (std::size_t block_y) {
+
+            auto texels = Texels();
+
+            for (std::size_t block_x = 0; block_x < blocks_x; ++block_x) {
+
+                for (std::size_t y = 0; y < block_extent; ++y) for (std::size_t x = 0; x < block_extent; ++x) {
+                    auto source = std::min(block_y * block_extent + y, height - 1) * width + std::min(block_x * block_extent + x, width - 1);
+                    auto texel = pixels.subspan(source * 4, 4);
+                    texels[y * block_extent + x] = glm::vec4(std::to_integer<uint8_t>(texel[0]), std::to_integer<uint8_t>(texel[1]),
+                        std::to_integer<uint8_t>(texel[2]), std::to_integer<uint8_t>(texel[3]));
+                }
+
+                auto output = blocks.data() + (block_y * blocks_x + block_x) * block_size;
+
+                if (format == BlockFormat::bc3) {
+                    encode_alpha(texels, output);
+                    output += 8;
+                }
+
+                encode_color(texels, output);
+
+            }
+
+        });
+
+        return blocks;
+
+    }
+
+    std::vector<std::byte> decompress_blocks (std::span<const std::byte> blocks, std::size_t width, std::size_t height, BlockFormat format) {
+
+        auto blocks_x = (width + block_extent - 1) / block_extent;
+        auto blocks_y = (height + block_extent - 1) / block_extent;
+        auto block_size = get_block_size(format);
+
+        auto pixels = std::vector<std::byte>(width * height * 4);
+        auto texels = Texels();
+
+        for (std::size_t block_y = 0; block_y < blocks_y; ++block_y) for (std::size_t block_x = 0; block_x < blocks_x; ++block_x) {
+
+            auto input = blocks.data() + (block_y * blocks_x + block_x) * block_size;
+
+            if (format == BlockFormat::bc3) {
+                decode_color(input + 8, texels, true);
+                decode_alpha(input, texels);
+            } else decode_color(input, texels, false);
+
+            for (std::size_t y = 0; y < block_extent; ++y) for (std::size_t x = 0; x < block_extent; ++x) {
+
+                auto pixel_x = block_x * block_extent + x, pixel_y = block_y * block_extent + y;
+                if (pixel_x >= width || pixel_y >= height) continue;
+
+                const auto& texel = texels[y * block_extent + x];
+                auto output = pixels.data() + (pixel_y * width + pixel_x) * 4;
+
+                for (auto channel = 0; channel < 4; ++channel) output[channel] = std::byte(static_cast<uint8_t>(texel[channel]));
+
+            }
+
+        }
+
+        return pixels;
+
+    }
+
+}
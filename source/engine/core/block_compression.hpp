@@ -0,0 +1,39 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace engine {
+
+    // Formats of 4x4 texel blocks GPUs sample directly. BC1 stores color in 8 bytes per block, half a byte per texel,
+    // BC3 adds 8 bytes of alpha. Endpoints are encoded as they are, so sRGB data stays sRGB
+    enum class BlockFormat : uint32_t {
+        bc1,
+        bc3
+    };
+
+    constexpr std::size_t block_extent = 4;
+
+    constexpr std::size_t get_block_size (BlockFormat format) { return format == BlockFormat::bc1 ? 8 : 16; }
+
+    constexpr std::size_t get_compressed_size (std::size_t width, std::size_t height, BlockFormat format) {
+        return (width + block_extent - 1) / block_extent * ((height + block_extent - 1) / block_extent) * get_block_size(format);
+    }
+
+    constexpr vk::Format get_vk_format (BlockFormat format) {
+        return format == BlockFormat::bc1 ? vk::Format::eBc1RgbSrgbBlock : vk::Format::eBc3SrgbBlock;
+    }
+
+    std::optional<BlockFormat> get_block_format (vk::Format format);
+
+    // BC1 for opaque images and BC3 as soon as one texel is translucent
+    BlockFormat pick_block_format (std::span<const std::byte> pixels);
+
+    // RGBA8 pixels in rows to blocks in rows. Blocks over the edge of the image repeat its last row and column
+    std::vector<std::byte> compress_blocks (std::span<const std::byte> pixels, std::size_t width, std::size_t height, BlockFormat format);
+
+    // Back to RGBA8, for devices that can't sample the format and to measure the encoding error
+    std::vector<std::byte> decompress_blocks (std::span<const std::byte> blocks, std::size_t width, std::size_t height, BlockFormat format);
+
+}
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <array>
+
+#include "descriptor_allocator.hpp"
+
+#include "device.hpp"
+
+#include "../utils/utils.hpp"
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    // Size classes double from the first pool up to the last one, which is then reused for every new pool
+    constexpr uint32_t min_pool_sets = 64;
+    constexpr uint32_t max_pool_sets = 4096;
+
+    // Descriptors reserved per set, by type
+    constexpr auto pool_ratios = std::array {
+        std::pair { vk::DescriptorType::eStorageBuffer, 2u },
+        std::pair { vk::DescriptorType::eUniformBuffer, 2u },
+        std::pair { vk::DescriptorType::eCombinedImageSampler, 4u },
+        std::pair { vk::DescriptorType::eStorageImage, 1u }
+    };
+
+    vk::DescriptorPool DescriptorAllocator::make_pool (uint32_t max_sets, vk::DescriptorPoolCreateFlags flags) {
+
+        auto pool_sizes = std::vector<vk::DescriptorPoolSize>();
+
+        for (const auto& [type, ratio] : pool_ratios)
+            pool_sizes.push_back({ .type = type, .descriptorCount = ratio * max_sets });
+
+        auto create_info = vk::DescriptorPoolCreateInfo {
+            .flags = flags,
+            .maxSets = max_sets,
+            .poolSizeCount = to_u32(pool_sizes.size()),
+            .pPoolSizes = pool_sizes.data()
+        };
+
+        try {
+            auto pool = Device::get()->get_handle().createDescriptorPool(create_info);
+            logi("Created Descriptor Pool for {} sets", max_sets);
+            pool_count++;
+            return pool;
+        } catch (vk::SystemError err) {
+            loge("Failed to create Descriptor Pool");
+            return nullptr;
+        }
+
+    }
+
+    vk::DescriptorSet DescriptorAllocator::allocate (PoolChain& chain, vk::DescriptorSetLayout layout, vk::DescriptorPoolCreateFlags flags) {
+
+        auto device = Device::get();
+
+        auto try_allocate = [&] (std::size_t index) {
+
+            auto allocate_info = vk::DescriptorSetAllocateInfo {
+                .descriptorPool = chain.pools.at(index),
+                .descriptorSetCount = 1,
+                .pSetLayouts = &layout
+            };
+
+            auto set = vk::DescriptorSet();
+            auto result = device->get_handle().allocateDescriptorSets(&allocate_info, &set);
+
+            if (result != vk::Result::eSuccess && result != vk::Result::eErrorOutOfPoolMemory && result != vk::Result::eErrorFragmentedPool)
+                loge("Failed to allocate DescriptorSet");
+
+            return result == vk::Result::eSuccess ? set : vk::DescriptorSet();
+
+        };
+
+        if (chain.current < chain.pools.size())
+            if (auto set = try_allocate(chain.current)) {
+                allocations++;
+                return set;
+            }
+
+        // The current pool is exhausted, the others may have room again from freed sets or a reset
+        for (std::size_t i = 0; i < chain.pools.size(); ++i) {
+            if (i == chain.current) continue;
+            if (auto set = try_allocate(i)) {
+                chain.current = i;
+                allocations++;
+                return set;
+            }
+        }
+
+        auto max_sets = std::min(max_pool_sets, min_pool_sets << std::min<std::size_t>(chain.pools.size(), 6));
+        auto pool = make_pool(max_sets, flags);
+        if (!pool) return nullptr;
+
+        chain.pools.push_back(pool);
+        chain.current = chain.pools.size() - 1;
+
+        auto set = try_allocate(chain.current);
+        if (set) allocations++;
+
+        return set;
+
+    }
+
+    static void write_bindings (vk::DescriptorSet set, std::span<const DescriptorBinding> bindings) {
+
+        auto writes = std::vector<vk::WriteDescriptorSet>();
+
+        for (const auto& binding : bindings) {
+
+            using enum vk::DescriptorType;
+            auto is_image = binding.type == eCombinedImageSampler || binding.type == eSampledImage
+                || binding.type == eStorageImage || binding.type == eSampler;
+
+            writes.push_back({
+                .dstSet = set,
+                .dstBinding = binding.binding,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = binding.type,
+                .pImageInfo = is_image ? &binding.image : nullptr,
+                .pBufferInfo = is_image ? nullptr : &binding.buffer
+            });
+
+        }
+
+        Device::get()->get_handle().updateDescriptorSets(to_u32(writes.size()), writes.data(), 0, nullptr);
+
+    }
+
+    std::size_t DescriptorAllocator::KeyHash::operator() (const Key& key) const {
+
+        std::size_t seed = 0;
+        hash_combine(seed, static_cast<VkDescriptorSetLayout>(key.layout));
+
+        for (const auto& binding : key.bindings) {
+            hash_combine(seed, binding.binding, binding.type);
+            hash_combine(seed, static_cast<VkBuffer>(binding.buffer.buffer), binding.buffer.offset, binding.buffer.range);
+            hash_combine(seed, static_cast<VkSampler>(binding.image.sampler), static_cast<VkImageView>(binding.image.imageView), binding.image.imageLayout);
+        }
+
+        return seed;
+
+    }
+
+    vk::DescriptorSet DescriptorAllocator::get (vk::DescriptorSetLayout layout, std::span<const DescriptorBinding> bindings) {
+
+        auto lock = std::scoped_lock(mutex);
+
+        auto key = Key { layout, std::vector(bindings.begin(), bindings.end()) };
+
+        if (auto cached = cache.find(key); cached != cache.end()) {
+            cache_hits++;
+            update_statistics();
+            return cached->second.set;
+        }
+
+        auto set = allocate(persistent, layout, vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+        update_statistics();
+
+        if (!set) return nullptr;
+
+        write_bindings(set, bindings);
+        cache[std::move(key)] = { set, persistent.pools.at(persistent.current) };
+
+        return set;
+
+    }
+
+    vk::DescriptorSet DescriptorAllocator::get_transient (uint32_t frame, vk::DescriptorSetLayout layout, std::span<const DescriptorBinding> bindings) {
+
+        auto lock = std::scoped_lock(mutex);
+
+        if (frame >= frames.size()) frames.resize(frame + 1);
+
+        auto set = allocate(frames.at(frame), layout, vk::DescriptorPoolCreateFlags());
+        if (set) write_bindings(set, bindings);
+
+        update_statistics();
+
+        return set;
+
+    }
+
+    void DescriptorAllocator::reset_frame (uint32_t frame) {
+
+        auto lock = std::scoped_lock(mutex);
+
+        if (frame >= frames.size()) return;
+
+        auto device = Device::get();
+
+        for (auto& pool : frames.at(frame).pools) device->get_handle().resetDescriptorPool(pool);
+
+        frames.at(frame).current = 0;
+
+    }
+
+    void DescriptorAllocator::release_if (std::function<bool(const DescriptorBinding&)> references) {
+
+        auto lock = std::scoped_lock(mutex);
+
+        if (cache.empty()) return;
+
+        auto device = Device::get();
+
+        std::erase_if(cache, [&] (const auto& entry) {
+            if (std::ranges::none_of(entry.first.bindings, references)) return false;
+            device->get_handle().freeDescriptorSets(entry.second.pool, entry.second.set);
+            return true;
+        });
+
+    }
+
+    void DescriptorAllocator::release (vk::Buffer buffer) {
+
+        if (buffer) release_if([buffer] (const DescriptorBinding& binding) { return binding.buffer.buffer == buffer; });
+
+    }
+
+    void DescriptorAllocator::release (vk::ImageView view) {
+
+        if (view) release_if([view] (const DescriptorBinding& binding) { return binding.image.imageView == view; });
+
+    }
+
+    void DescriptorAllocator::update_statistics ( ) {
+
+        perf_statistics["Descriptor sets allocated"] = allocations;
+        perf_statistics["Descriptor set cache hits"] = cache_hits;
+        perf_statistics["Descriptor pools"] = pool_count;
+
+    }
+
+    void DescriptorAllocator::clear ( ) {
+
+        auto lock = std::scoped_lock(mutex);
+        auto device = Device::get();
+
+        for (auto& pool : persistent.pools) device->get_handle().destroyDescriptorPool(pool);
+
+        for (auto& chain : frames)
+            for (auto& pool : chain.pools) device->get_handle().destroyDescriptorPool(pool);
+
+        persistent = { };
+        frames.clear();
+        cache.clear();
+
+    }
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+
+    // A resource bound to a single descriptor, only the info matching the type is read
+    struct DescriptorBinding {
+        uint32_t binding;
+        vk::DescriptorType type;
+        vk::DescriptorBufferInfo buffer = { };
+        vk::DescriptorImageInfo image = { };
+
+        bool operator== (const DescriptorBinding&) const = default;
+    };
+
+    // Hands out descriptor sets from chained pools that grow through size classes when one runs out.
+    // Persistent sets are cached by layout and bound resources and freed once one of those resources is
+    // destroyed, transient sets come from per-frame pools that are reset wholesale once the frame is done
+    class DescriptorAllocator {
+
+        struct PoolChain {
+            std::vector<vk::DescriptorPool> pools;
+            std::size_t current = 0;
+        };
+
+        // The hash only picks the bucket, sets are shared when the layout and every binding compare equal
+        struct Key {
+            vk::DescriptorSetLayout layout;
+            std::vector<DescriptorBinding> bindings;
+
+            bool operator== (const Key&) const = default;
+        };
+
+        struct KeyHash {
+            std::size_t operator() (const Key& key) const;
+        };
+
+        struct CachedSet {
+            vk::DescriptorSet set;
+            vk::DescriptorPool pool;
+        };
+
+        static inline std::mutex mutex;
+
+        static inline PoolChain persistent;
+        static inline std::vector<PoolChain> frames;
+        static inline std::unordered_map<Key, CachedSet, KeyHash> cache;
+
+        static inline std::size_t allocations = 0, cache_hits = 0, pool_count = 0;
+
+        static vk::DescriptorPool make_pool (uint32_t max_sets, vk::DescriptorPoolCreateFlags flags);
+        static vk::DescriptorSet allocate (PoolChain& chain, vk::DescriptorSetLayout layout, vk::DescriptorPoolCreateFlags flags);
+        static void release_if (std::function<bool(const DescriptorBinding&)> references);
+        static void update_statistics ( );
+
+        public:
+
+        static vk::DescriptorSet get (vk::DescriptorSetLayout layout, std::span<const DescriptorBinding> bindings);
+
+        // Valid until reset_frame is called for the same frame, for sets rewritten every frame
+        static vk::DescriptorSet get_transient (uint32_t frame, vk::DescriptorSetLayout layout, std::span<const DescriptorBinding> bindings);
+
+        // Must only be called once the frame's command buffers have finished executing
+        static void reset_frame (uint32_t frame);
+
+        // Frees the cached sets bound to the resource, called when it is destroyed. Sets handed out
+        // for it must no longer be in use by the device
+        static void release (vk::Buffer buffer);
+        static void release (vk::ImageView view);
+
+        static void clear ( );
+
+    };
+
+}
@@ -1,3 +1,5 @@
+#include <cstring>
+#include <fstream>
 #include <ranges>
 #include <set>
 
@@ -10,6 +12,15 @@ namespace engine {
 
     static std::weak_ptr<Device> device_instance;
 
+    constexpr auto pipeline_cache_path = "pipeline_cache.bin";
+
+    // Prepended to the driver's blob, the Vulkan header itself doesn't carry the driver version
+    struct PipelineCachePrefix {
+        uint32_t magic = 0x4C56504B;
+        uint32_t driver_version;
+        uint64_t data_size;
+    };
+
     void Device::set_static_instance (std::shared_ptr<Device>& device) {
 
         device_instance = device;
@@ -38,11 +49,16 @@ namespace engine {
         };
 
         vmaCreateAllocator(&create_info, &allocator);
+
+        make_pipeline_cache();
         
     }
 
     Device::~Device ( ) {
 
+        save_pipeline_cache();
+        handle.destroyPipelineCache(pipeline_cache);
+
         logi("Destroying Allocator");
         vmaDestroyAllocator(allocator);
         logi("Destroying Device");
@@ -85,7 +101,7 @@ namespace engine {
         };
 
         auto app_info = vk::ApplicationInfo {
-            .apiVersion = VK_VERSION_1_3
+            .apiVersion = VK_API_VERSION_1_3
         };
 
         auto create_info = vk::InstanceCreateInfo {
@@ -159,6 +175,8 @@ namespace engine {
 
         auto device_features = vk::PhysicalDeviceFeatures();
         device_features.samplerAnisotropy = VK_TRUE;
+        device_features.multiDrawIndirect = VK_TRUE;
+        device_features.drawIndirectFirstInstance = VK_TRUE;
         device_features.sampleRateShading = VK_TRUE;
 
         auto extensions = std::vector { "VK_KHR_swapchain" };
@@ -166,7 +184,41 @@ namespace engine {
         
         if constexpr (debug) layers.push_back("VK_LAYER_KHRONOS_validation");
 
+        // Dynamic rendering is core in 1.3, the render pass path is kept for older devices
+        auto vulkan13_features = vk::PhysicalDeviceVulkan13Features { .dynamicRendering = VK_TRUE };
+
+        if (gpu.getProperties().apiVersion >= VK_API_VERSION_1_3) {
+            auto supported = gpu.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan13Features>();
+            dynamic_rendering_supported = supported.get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering;
+        }
+
+        // Descriptor indexing backs the bindless texture table and indirect count drives the scene renderer,
+        // there is no fallback for either. Indirect commands also pick their instance data through firstInstance
+        auto vulkan12_features = vk::PhysicalDeviceVulkan12Features {
+            .pNext = dynamic_rendering_supported ? &vulkan13_features : nullptr,
+            .drawIndirectCount = VK_TRUE,
+            .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+            .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+            .descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+            .descriptorBindingPartiallyBound = VK_TRUE,
+            .runtimeDescriptorArray = VK_TRUE
+        };
+
+        auto supported = gpu.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>()
+            .get<vk::PhysicalDeviceVulkan12Features>();
+
+        if (!supported.shaderSampledImageArrayNonUniformIndexing || !supported.descriptorBindingSampledImageUpdateAfterBind
+            || !supported.descriptorBindingUpdateUnusedWhilePending || !supported.descriptorBindingPartiallyBound
+            || !supported.runtimeDescriptorArray)
+            throw std::runtime_error("Device does not support descriptor indexing");
+
+        auto core_features = gpu.getFeatures();
+
+        if (!supported.drawIndirectCount || !core_features.multiDrawIndirect || !core_features.drawIndirectFirstInstance)
+            throw std::runtime_error("Device does not support indirect count draws");
+
         auto device_info = vk::DeviceCreateInfo {
+            .pNext = &vulkan12_features,
             .flags = vk::DeviceCreateFlags(),
             .queueCreateInfoCount = to_u32(queue_info.size()),
             .pQueueCreateInfos = queue_info.data(),
@@ -186,4 +238,81 @@ namespace engine {
 
     }
     
+    void Device::make_pipeline_cache ( ) {
+
+        auto properties = gpu.getProperties();
+        auto data = std::vector<std::byte>();
+
+        auto file = std::ifstream(pipeline_cache_path, std::ios::binary | std::ios::ate);
+        auto file_size = file ? static_cast<std::size_t>(file.tellg()) : 0;
+        auto prefix = PipelineCachePrefix();
+
+        file.seekg(0);
+
+        // The size is checked against the file before anything is allocated for it, a corrupt prefix could ask for gigabytes
+        if (file_size >= sizeof(prefix) && file.read(reinterpret_cast<char*>(&prefix), sizeof(prefix))) {
+
+            auto header = vk::PipelineCacheHeaderVersionOne();
+
+            bool valid = prefix.magic == PipelineCachePrefix().magic
+                && prefix.driver_version == properties.driverVersion
+                && prefix.data_size == file_size - sizeof(prefix)
+                && prefix.data_size >= sizeof(header);
+
+            if (valid) {
+                data.resize(prefix.data_size);
+                file.read(reinterpret_cast<char*>(data.data()), data.size());
+                std::memcpy(&header, data.data(), sizeof(header));
+            }
+
+            valid = valid && file
+                && header.headerVersion == vk::PipelineCacheHeaderVersion::eOne
+                && header.vendorID == properties.vendorID
+                && header.deviceID == properties.deviceID
+                && header.pipelineCacheUUID == properties.pipelineCacheUUID;
+
+            if (!valid) {
+                logw("Pipeline cache is stale or corrupted, discarding it");
+                data.clear();
+            }
+
+        }
+
+        auto create_info = vk::PipelineCacheCreateInfo {
+            .flags = vk::PipelineCacheCreateFlags(),
+            .initialDataSize = data.size(),
+            .pInitialData = data.data()
+        };
+
+        try {
+            pipeline_cache = handle.createPipelineCache(create_info);
+            logi("Created Pipeline Cache from {} bytes of data", data.size());
+        } catch (vk::SystemError err) {
+            loge("Failed to create Pipeline Cache");
+        }
+
+    }
+
+    void Device::save_pipeline_cache ( ) {
+
+        if (!pipeline_cache) return;
+
+        auto data = handle.getPipelineCacheData(pipeline_cache);
+
+        auto prefix = PipelineCachePrefix {
+            .driver_version = gpu.getProperties().driverVersion,
+            .data_size = data.size()
+        };
+
+        auto file = std::ofstream(pipeline_cache_path, std::ios::binary | std::ios::trunc);
+
+        if (!file.is_open()) { logw("Failed to open {} for writing", pipeline_cache_path); return; }
+
+        file.write(reinterpret_cast<const char*>(&prefix), sizeof(prefix));
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+        logi("Saved {} bytes of Pipeline Cache", data.size());
+
+    }
+    
 }
\ No newline at end of file
@@ -18,6 +18,8 @@ namespace engine {
         GLFWwindow* window;
 
         VmaAllocator allocator;
+        vk::PipelineCache pipeline_cache;
+        bool dynamic_rendering_supported = false;
 
         void create_handle ( );
         void choose_physical_device ( );
@@ -25,6 +27,9 @@ namespace engine {
         void make_instance ( );
         void make_surface ( );
 
+        void make_pipeline_cache ( );
+        void save_pipeline_cache ( );
+
         public:
 
         Device (GLFWwindow*);
@@ -39,6 +44,8 @@ namespace engine {
         constexpr const vk::Instance& get_instance ( ) const { return instance; }
         constexpr const GLFWwindow* get_window ( ) const { return window; }
         constexpr const VmaAllocator& get_allocator ( ) const { return allocator; }
+        constexpr const vk::PipelineCache& get_pipeline_cache ( ) const { return pipeline_cache; }
+        constexpr bool supports_dynamic_rendering ( ) const { return dynamic_rendering_supported; }
 
         constexpr const vk::Extent2D get_extent ( ) const {
 
@@ -1,11 +1,16 @@
+#include <cstring>
+#include <optional>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
-#include "stb_image.h"
-
 #include "image.hpp"
 
+#include "block_compression.hpp"
+#include "descriptor_allocator.hpp"
 #include "memory.hpp"
+#include "mipmaps.hpp"
+#include "texture_table.hpp"
 #include "pipeline.hpp"
 
 #include "../utils/utils.hpp"
@@ -13,6 +18,28 @@
 
 namespace engine {
 
+    namespace {
+
+        bool supports_linear_blits (vk::Format format) {
+
+            using enum vk::FormatFeatureFlagBits;
+
+            auto required = vk::FormatFeatureFlags(eBlitSrc | eBlitDst | eSampledImageFilterLinear);
+            auto features = Device::get()->get_gpu().getFormatProperties(format).optimalTilingFeatures;
+
+            return (features & required) == required;
+
+        }
+
+    }
+
+    Image::~Image ( ) {
+
+        DescriptorAllocator::release(view.get());
+        vmaDestroyImage(device->get_allocator(), VkImage(handle), allocation);
+
+    }
+
     void Image::create_handle ( ) {
         
         auto create_info = vk::ImageCreateInfo {
@@ -93,18 +120,10 @@ namespace engine {
     
     Texture::Texture (std::string_view path) {
 
-        int width, height, channels;
-
-        auto stbi_image = stbi_load(path.data(), &width, &height, &channels, 4);
-        auto pixels = reinterpret_cast<std::byte*>(stbi_image);
-
-        this->width = width;
-        this->height = height;
-        size = width * height * 4; 
+        if (auto compressed = TextureLoader::find_compressed(path))
+            if (auto texture = read_ktx2(*compressed); texture && set_compressed(*texture)) return;
 
-        create_handle();
-        set_data({pixels, pixels + size});
-        stbi_image_free(pixels);
+        set_image(TextureLoader::take(path), nullptr);
 
     }
 
@@ -113,26 +132,50 @@ namespace engine {
         this->width = width;
         this->height = height;
 
-        create_handle();
         size = pixels.size();
+        create_handle();
         set_data(pixels);
 
     };
+
+    Texture::Texture (DecodedImage image, TextureLoadTimings* timings) {
+
+        set_image(std::move(image), timings);
+
+    }
+
+    Texture::~Texture ( ) {
+
+        TextureTable::remove(index);
+
+    }
     
     void Texture::create_handle ( ) {
 
-        mip_levels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+        using enum vk::ImageUsageFlagBits;
+
+        // Block compressed textures come with their format and levels, everything else is RGBA8 with levels blitted from the first
+        auto compressed = format != vk::Format::eUndefined;
+
+        if (!compressed) {
+            mip_levels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+            format = vk::Format::eR8G8B8A8Srgb;
+            usage = eTransferSrc | eTransferDst | eSampled;
+        } else usage = eTransferDst | eSampled;
 
-        format = vk::Format::eR8G8B8A8Srgb;
         sample_count = vk::SampleCountFlagBits::e1;
 
-        using enum vk::ImageUsageFlagBits;
-        usage = eTransferSrc | eTransferDst | eSampled;
+        auto uncompressed_size = std::size_t(0);
+        for (uint32_t level = 0; level < mip_levels; ++level)
+            uncompressed_size += std::max<std::size_t>(1, width >> level) * std::max<std::size_t>(1, height >> level) * 4;
+
+        perf_statistics["Texture bytes"] += compressed ? size : uncompressed_size;
+        perf_statistics["Texture bytes saved by compression"] += compressed ? uncompressed_size - std::min(size, uncompressed_size) : 0;
 
         Image::create_handle();
 
         create_sampler();
-        create_descriptor_set();
+        index = TextureTable::add(sampler.get(), view.get());
         
     }
 
@@ -163,63 +206,6 @@ namespace engine {
 
     }
 
-    void Texture::create_descriptor_set ( ) {
-
-        auto pool_size = vk::DescriptorPoolSize {
-            .type = vk::DescriptorType::eCombinedImageSampler,
-            .descriptorCount = 1
-        };
-
-        auto create_info = vk::DescriptorPoolCreateInfo {
-            .flags = vk::DescriptorPoolCreateFlags(),
-            .maxSets = 1,
-            .poolSizeCount = 1,
-            .pPoolSizes = &pool_size
-        };
-
-        try {
-            descriptor_pool = device->get_handle().createDescriptorPoolUnique(create_info);
-            logi("Successfully created Descriptor Pool");
-        } catch (vk::SystemError err) {
-            loge("Failed to create Descriptor Pool");
-        }
-
-        auto layout = create_descriptor_set_layout();
-
-        auto allocate_info = vk::DescriptorSetAllocateInfo {
-            .descriptorPool = descriptor_pool.get(),
-            .descriptorSetCount = 1,
-            .pSetLayouts = &layout
-        };
-
-        try {
-            auto result = device->get_handle().allocateDescriptorSets(allocate_info);
-            logi("Allocated DescriptorSet's");
-            descriptor_set = result.at(0);
-        } catch (vk::SystemError err) {
-            loge("Failed to allocate DescriptorSet's");
-        }
-
-        auto image_info = vk::DescriptorImageInfo {
-            .sampler = sampler.get(),
-            .imageView = view.get(),
-            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
-        };
-
-        auto write_info = vk::WriteDescriptorSet {
-            .dstSet = descriptor_set,
-            .dstBinding = 0,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-            .pImageInfo = &image_info
-        };
-
-        device->get_handle().updateDescriptorSets(1, &write_info, 0, nullptr);
-        device->get_handle().destroyDescriptorSetLayout(layout);
-
-    }
-
     void Texture::generate_mipmaps (const vk::CommandBuffer& command_buffer) {
 
         auto barrier = vk::ImageMemoryBarrier {
@@ -301,10 +287,111 @@ namespace engine {
 
     }
 
-    void Texture::set_data(std::span<std::byte> pixels) {
+    void Texture::set_image (DecodedImage image, TextureLoadTimings* timings) {
 
-        auto staging = Buffer(size, vk::BufferUsageFlagBits::eTransferSrc);
-        staging.write(pixels.data());
+        if (image.pixels.empty()) image = { .width = 1, .height = 1, .pixels = std::vector<std::byte>(4, std::byte(255)) };
+
+        width = image.width;
+        height = image.height;
+        size = image.pixels.size();
+
+        create_handle();
+
+        // Blits need linear filtering of the format, without it the levels are filtered here instead
+        if (image.mipmaps.empty() && mip_levels > 1 && !supports_linear_blits(format)) {
+            logw("The device can't blit {} with linear filtering, filtering mipmaps on the CPU", vk::to_string(format));
+            auto timer = ScopedTimer([timings] (double duration) { if (timings) timings->mipmaps += duration; });
+            image.mipmaps = generate_mipmaps(image.pixels, width, height, MipFilter::box);
+        }
+
+        if (image.mipmaps.empty()) {
+            set_data(image.pixels, timings);
+            return;
+        }
+
+        auto levels = std::vector<std::span<const std::byte>> { image.pixels };
+        levels.insert(levels.end(), image.mipmaps.begin(), image.mipmaps.end());
+
+        upload_levels(levels, timings);
+
+    }
+
+    bool Texture::set_compressed (const Ktx2Texture& texture) {
+
+        auto features = device->get_gpu().getFormatProperties(texture.format).optimalTilingFeatures;
+
+        if (!(features & vk::FormatFeatureFlagBits::eSampledImage)) {
+
+            auto block_format = get_block_format(texture.format);
+
+            if (!block_format) {
+                logw("The device can't sample {}", vk::to_string(texture.format));
+                return false;
+            }
+
+            // The mip chain of the file is dropped, the blits rebuild it from the first level
+            logw("The device can't sample {}, decompressing the texture", vk::to_string(texture.format));
+
+            set_image({
+                .width = texture.width,
+                .height = texture.height,
+                .pixels = decompress_blocks(texture.levels.front(), texture.width, texture.height, *block_format)
+            }, nullptr);
+
+            return true;
+
+        }
+
+        width = texture.width;
+        height = texture.height;
+        format = texture.format;
+        mip_levels = static_cast<uint32_t>(texture.levels.size());
+
+        size = 0;
+        for (const auto& level : texture.levels) size += level.size();
+
+        create_handle();
+
+        auto levels = std::vector<std::span<const std::byte>>(texture.levels.begin(), texture.levels.end());
+        upload_levels(levels, nullptr);
+
+        return true;
+
+    }
+
+    void Texture::upload_levels (std::span<const std::span<const std::byte>> levels, TextureLoadTimings* timings) {
+
+        auto upload_timer = std::optional<ScopedTimer>();
+        if (timings) upload_timer.emplace([timings] (double duration) { timings->upload += duration; });
+
+        auto staging_size = std::size_t(0);
+        for (const auto& level : levels) staging_size += level.size();
+
+        auto staging = Buffer(staging_size, vk::BufferUsageFlagBits::eTransferSrc);
+        auto regions = std::vector<vk::BufferImageCopy>();
+        auto offset = std::size_t(0);
+
+        for (uint32_t level = 0; level < levels.size(); ++level) {
+
+            staging.write(levels[level].data(), levels[level].size(), offset);
+
+            regions.push_back({
+                .bufferOffset = offset,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .mipLevel = level,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                },
+                .imageOffset = { 0, 0, 0 },
+                .imageExtent = { to_u32(get_mip_extent(width, level)), to_u32(get_mip_extent(height, level)), 1 }
+            });
+
+            offset += levels[level].size();
+
+        }
 
         auto transient_buffer = TransientBuffer(true);
         auto command_buffer = transient_buffer.get();
@@ -312,32 +399,152 @@ namespace engine {
         insert_image_memory_barrier(command_buffer, handle, vk::ImageAspectFlagBits::eColor, 
             { vk::PipelineStageFlagBits::eHost, vk::PipelineStageFlagBits::eTransfer },
             { vk::AccessFlagBits::eNone, vk::AccessFlagBits::eTransferWrite },
-            { vk::ImageLayout::eUndefined,  vk::ImageLayout::eTransferDstOptimal }, mip_levels
+            { vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal }, mip_levels
         );
 
-        auto subres_layers = vk::ImageSubresourceLayers {
-            .aspectMask = vk::ImageAspectFlagBits::eColor,
-            .mipLevel = 0,
-            .baseArrayLayer = 0,
-            .layerCount = 1
-        };
+        command_buffer.copyBufferToImage(staging.get_handle(), handle,
+            vk::ImageLayout::eTransferDstOptimal, to_u32(regions.size()), regions.data());
 
-        auto region = vk::BufferImageCopy {
-            .bufferOffset = 0,
-            .bufferRowLength = 0,
-            .bufferImageHeight = 0,
-            .imageSubresource = subres_layers,
-            .imageOffset = { 0, 0, 0 },
-            .imageExtent = { to_u32(width), to_u32(height), 1 }
-        };
+        insert_image_memory_barrier(command_buffer, handle, vk::ImageAspectFlagBits::eColor, 
+            { vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader },
+            { vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead },
+            { vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal }, mip_levels
+        );
 
-        command_buffer.copyBufferToImage(staging.get_handle(), handle,
-            vk::ImageLayout::eTransferDstOptimal, 1, &region);
+        transient_buffer.submit();
+
+    }
+
+    void Texture::set_data (std::span<std::byte> pixels, TextureLoadTimings* timings) {
+
+        auto upload_timer = std::optional<ScopedTimer>();
+        if (timings) upload_timer.emplace([timings] (double duration) { timings->upload += duration; });
+
+        auto staging = Buffer(size, vk::BufferUsageFlagBits::eTransferSrc);
+        staging.write(pixels.data());
+
+        {
+            auto transient_buffer = TransientBuffer(true);
+            auto command_buffer = transient_buffer.get();
+
+            insert_image_memory_barrier(command_buffer, handle, vk::ImageAspectFlagBits::eColor, 
+                { vk::PipelineStageFlagBits::eHost, vk::PipelineStageFlagBits::eTransfer },
+                { vk::AccessFlagBits::eNone, vk::AccessFlagBits::eTransferWrite },
+                { vk::ImageLayout::eUndefined,  vk::ImageLayout::eTransferDstOptimal }, mip_levels
+            );
+
+            auto subres_layers = vk::ImageSubresourceLayers {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            };
+
+            auto region = vk::BufferImageCopy {
+                .bufferOffset = 0,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = subres_layers,
+                .imageOffset = { 0, 0, 0 },
+                .imageExtent = { to_u32(width), to_u32(height), 1 }
+            };
+
+            command_buffer.copyBufferToImage(staging.get_handle(), handle,
+                vk::ImageLayout::eTransferDstOptimal, 1, &region);
 
-        generate_mipmaps(command_buffer);
+            if (!timings) generate_mipmaps(command_buffer);
 
+            transient_buffer.submit();
+        }
+
+        if (!timings) return;
+
+        upload_timer.reset();
+
+        // The barriers of the blits order them after the copy submitted before
+        auto mipmap_timer = ScopedTimer([timings] (double duration) { timings->mipmaps += duration; });
+
+        auto transient_buffer = TransientBuffer(true);
+        generate_mipmaps(transient_buffer.get());
         transient_buffer.submit();
 
     }
 
-}
\ No newline at end of file
+    std::vector<std::byte> Texture::read_level (uint32_t level) const {
+
+        // Block compressed textures are neither four bytes per texel nor created as transfer sources
+        if (format != vk::Format::eR8G8B8A8Srgb || level >= mip_levels) {
+            logw("Can't read back level {} of a {} texture", level, vk::to_string(format));
+            return { };
+        }
+
+        auto level_width = to_u32(get_mip_extent(width, level)), level_height = to_u32(get_mip_extent(height, level));
+        auto readback = Buffer(std::size_t(level_width) * level_height * 4, vk::BufferUsageFlagBits::eTransferDst, true, false, true);
+
+        {
+            auto transient_buffer = TransientBuffer(true);
+            auto command_buffer = transient_buffer.get();
+
+            auto barrier = vk::ImageMemoryBarrier {
+                .srcAccessMask = vk::AccessFlagBits::eShaderRead,
+                .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+                .oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+                .newLayout = vk::ImageLayout::eTransferSrcOptimal,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = handle,
+                .subresourceRange = {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = level,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                }
+            };
+
+            insert_image_memory_barrier(command_buffer, barrier,
+                { vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer });
+
+            auto region = vk::BufferImageCopy {
+                .bufferOffset = 0,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .mipLevel = level,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                },
+                .imageOffset = { 0, 0, 0 },
+                .imageExtent = { level_width, level_height, 1 }
+            };
+
+            command_buffer.copyImageToBuffer(handle, vk::ImageLayout::eTransferSrcOptimal, readback.get_handle(), 1, &region);
+
+            auto readback_barrier = vk::MemoryBarrier {
+                .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                .dstAccessMask = vk::AccessFlagBits::eHostRead
+            };
+
+            command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                vk::DependencyFlags(), 1, &readback_barrier, 0, nullptr, 0, nullptr);
+
+            std::swap(barrier.srcAccessMask, barrier.dstAccessMask);
+            std::swap(barrier.oldLayout, barrier.newLayout);
+
+            insert_image_memory_barrier(command_buffer, barrier,
+                { vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader });
+
+            transient_buffer.submit();
+        }
+
+        readback.invalidate();
+
+        auto pixels = std::vector<std::byte>(readback.get_size());
+        std::memcpy(pixels.data(), readback.get_mapped(), pixels.size());
+
+        return pixels;
+
+    }
+
+}
@@ -6,6 +6,8 @@
 #include <vk_mem_alloc.h>
 
 #include "device.hpp"
+#include "texture_loader.hpp"
+#include "ktx2.hpp"
 
 namespace engine {
 
@@ -22,7 +24,7 @@ namespace engine {
         vk::UniqueImageView view;
         VmaAllocation allocation;
 
-        vk::Format format;
+        vk::Format format = vk::Format::eUndefined;
         vk::ImageUsageFlags usage;
         vk::SampleCountFlagBits sample_count;
 
@@ -35,7 +37,7 @@ namespace engine {
         uint32_t mip_levels, vk::SampleCountFlagBits sample_count) :
             width(width), height(height), format(format), usage(usage), 
             mip_levels(mip_levels), sample_count(sample_count) { create_handle(); }
-        ~Image ( ) { vmaDestroyImage(device->get_allocator(), VkImage(handle), allocation); };
+        ~Image ( );
 
         static vk::UniqueImageView create_view (vk::Image& image, vk::Format format, vk::ImageAspectFlags flags, uint32_t mip_levels = 1);
 
@@ -46,6 +48,7 @@ namespace engine {
 
         constexpr const std::size_t get_width ( ) const { return width; }
         constexpr const std::size_t get_height ( ) const { return height; }
+        constexpr uint32_t get_mip_levels ( ) const { return mip_levels; }
 
     };
 
@@ -54,24 +57,39 @@ namespace engine {
         std::size_t size;
 
         vk::UniqueSampler sampler;
-
-        vk::UniqueDescriptorPool descriptor_pool;
-        vk::DescriptorSet descriptor_set;
+        uint32_t index;
 
         void create_handle ( ) override;
         void create_sampler ( );
-        void create_descriptor_set ( );
         void generate_mipmaps (const vk::CommandBuffer& command_buffer);
 
+        void set_image (DecodedImage image, TextureLoadTimings* timings);
+
+        // Copies prepared levels, the first is the full resolution, and leaves them ready for sampling
+        void upload_levels (std::span<const std::span<const std::byte>> levels, TextureLoadTimings* timings);
+
+        // Copies every level of the file as it is, false when the device can sample neither the format nor its decompression
+        bool set_compressed (const Ktx2Texture& texture);
+
         public:
 
+        // Loads the block compressed copy of the path when there is one, see TextureLoader::find_compressed
         Texture (std::string_view path);
         Texture (std::size_t width, std::size_t height, std::span<std::byte> pixels);
 
-        void set_data(std::span<std::byte> pixels);
+        // Images that failed to decode become a single white texel, so whatever uses the texture still draws
+        Texture (DecodedImage image, TextureLoadTimings* timings = nullptr);
+        ~Texture ( );
+
+        // With timings the copy and the mipmap generation are submitted and waited for one after the other
+        void set_data (std::span<std::byte> pixels, TextureLoadTimings* timings = nullptr);
+
+        // Pixels of one level of an RGBA8 texture read back from the device, waits for the copy. Empty for block
+        // compressed textures
+        std::vector<std::byte> read_level (uint32_t level) const;
 
         constexpr const vk::Sampler& get_sampler ( ) const { return sampler.get(); }
-        constexpr const vk::DescriptorSet& get_descriptor_set ( ) const { return descriptor_set; }
+        constexpr uint32_t get_index ( ) const { return index; }
 
     };
 
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include "ktx2.hpp"
+#include "block_compression.hpp"
+#include "mipmaps.hpp"
+
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    namespace {
+
+        // Khronos data format descriptor values of the block formats
+        constexpr uint8_t color_model_bc1a = 128;
+        constexpr uint8_t color_model_bc3 = 130;
+        constexpr uint8_t channel_color = 0;
+        constexpr uint8_t channel_alpha = 15;
+        constexpr uint8_t primaries_bt709 = 1;
+        constexpr uint8_t transfer_srgb = 2;
+
+        template <typename T> void append (std::vector<std::byte>& data, const T& value) {
+
+            auto bytes = std::as_bytes(std::span(&value, 1));
+            data.insert(data.end(), bytes.begin(), bytes.end());
+
+        }
+
+        // A basic descriptor block with one 64 bit sample per block half, BC3 keeps alpha in the first half
+        std::vector<std::byte> make_data_format_descriptor (BlockFormat format) {
+
+            struct Sample {
+                uint16_t bit_offset;
+                uint8_t bit_length; // minus one
+                uint8_t channel;
+            };
+
+            auto samples = format == BlockFormat::bc3
+                ? std::vector<Sample> { { 0, 63, channel_alpha }, { 64, 63, channel_color } }
+                : std::vector<Sample> { { 0, 63, channel_color } };
+
+            auto block_size = uint16_t(24 + 16 * samples.size());
+
+            auto data = std::vector<std::byte>();
+
+            append(data, uint32_t(sizeof(uint32_t) + block_size));
+            append(data, uint32_t(0)); // Khronos vendor, basic descriptor type
+            append(data, uint32_t(2 | block_size << 16)); // version 1.3
+            append(data, std::array<uint8_t, 4> { format == BlockFormat::bc3 ? color_model_bc3 : color_model_bc1a, primaries_bt709, transfer_srgb, 0 });
+            append(data, std::array<uint8_t, 4> { block_extent - 1, block_extent - 1, 0, 0 });
+            append(data, std::array<uint8_t, 8> { static_cast<uint8_t>(get_block_size(format)) });
+
+            for (const auto& sample : samples) {
+                append(data, sample);
+                append(data, uint32_t(0)); // sample position
+                append(data, uint32_t(0));
+                append(data, std::numeric_limits<uint32_t>::max());
+            }
+
+            return data;
+
+        }
+
+        // Texels per block side and bytes per block of the formats levels can be read in
+        struct TexelBlock {
+            uint32_t extent;
+            uint32_t size;
+        };
+
+        std::optional<TexelBlock> get_texel_block (vk::Format format) {
+
+            using enum vk::Format;
+
+            switch (format) {
+                case eR8G8B8A8Unorm: case eR8G8B8A8Srgb: case eB8G8R8A8Unorm: case eB8G8R8A8Srgb:
+                    return TexelBlock { 1, 4 };
+                case eBc1RgbUnormBlock: case eBc1RgbSrgbBlock: case eBc1RgbaUnormBlock: case eBc1RgbaSrgbBlock:
+                case eBc4UnormBlock: case eBc4SnormBlock:
+                    return TexelBlock { 4, 8 };
+                case eBc2UnormBlock: case eBc2SrgbBlock: case eBc3UnormBlock: case eBc3SrgbBlock:
+                case eBc5UnormBlock: case eBc5SnormBlock: case eBc6HUfloatBlock: case eBc6HSfloatBlock:
+                case eBc7UnormBlock: case eBc7SrgbBlock:
+                    return TexelBlock { 4, 16 };
+                default:
+                    return std::nullopt;
+            }
+
+        }
+
+        constexpr uint64_t align (uint64_t offset, uint64_t alignment) {
+
+            return (offset + alignment - 1) / alignment * alignment;
+
+        }
+
+    }
+
+    std::optional<Ktx2Texture> read_ktx2 (const std::filesystem::path& path) {
+
+        SCOPED_PERF_LOG;
+
+        auto input = std::ifstream(path, std::ios::binary | std::ios::ate);
+
+        if (!input) {
+            logw("Failed to open {}", path.string());
+            return std::nullopt;
+        }
+
+        auto data = std::vector<std::byte>(static_cast<std::size_t>(input.tellg()));
+        input.seekg(0);
+        input.read(reinterpret_cast<char*>(data.data()), data.size());
+
+        auto header = Ktx2Header();
+
+        if (!input || data.size() < sizeof(header)) {
+            logw("KTX2 file {} is truncated", path.string());
+            return std::nullopt;
+        }
+
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        if (header.identifier != Ktx2Header::identifier_value) {
+            logw("{} is not a KTX2 file", path.string());
+            return std::nullopt;
+        }
+
+        if (header.supercompression_scheme != 0) {
+            logw("KTX2 file {} is supercompressed, which needs a transcoder", path.string());
+            return std::nullopt;
+        }
+
+        if (header.pixel_depth > 1 || header.layer_count > 1 || header.face_count != 1 || header.level_count == 0
+            || header.pixel_width == 0 || header.pixel_height == 0) {
+            logw("KTX2 file {} is not a 2D texture with a mip chain", path.string());
+            return std::nullopt;
+        }
+
+        // Checked before anything is sized by the header, a full chain bounds the level count
+        if (header.level_count > get_mip_count(header.pixel_width, header.pixel_height)) {
+            logw("KTX2 file {} has {} levels, more than a {}x{} texture can have", path.string(), header.level_count,
+                header.pixel_width, header.pixel_height);
+            return std::nullopt;
+        }
+
+        if (header.level_count * sizeof(Ktx2Level) > data.size() - sizeof(header)) {
+            logw("KTX2 file {} is truncated", path.string());
+            return std::nullopt;
+        }
+
+        auto texture = Ktx2Texture {
+            .format = static_cast<vk::Format>(header.vk_format),
+            .width = header.pixel_width,
+            .height = header.pixel_height
+        };
+
+        auto block = get_texel_block(texture.format);
+
+        if (!block) {
+            logw("KTX2 file {} has the unsupported format {}", path.string(), vk::to_string(texture.format));
+            return std::nullopt;
+        }
+
+        auto level_table = std::vector<Ktx2Level>(header.level_count);
+        std::memcpy(level_table.data(), data.data() + sizeof(header), level_table.size() * sizeof(Ktx2Level));
+
+        for (uint32_t level = 0; level < header.level_count; ++level) {
+
+            const auto& entry = level_table[level];
+
+            auto columns = (get_mip_extent(texture.width, level) + block->extent - 1) / block->extent;
+            auto rows = (get_mip_extent(texture.height, level) + block->extent - 1) / block->extent;
+
+            if (entry.offset > data.size() || entry.length > data.size() - entry.offset || entry.length != columns * rows * block->size) {
+                logw("Level {} of KTX2 file {} is invalid", level, path.string());
+                return std::nullopt;
+            }
+
+            auto first = data.begin() + entry.offset;
+            texture.levels.emplace_back(first, first + entry.length);
+
+        }
+
+        return texture;
+
+    }
+
+    bool write_ktx2 (const std::filesystem::path& path, const Ktx2Texture& texture) {
+
+        auto block_format = get_block_format(texture.format);
+
+        if (!block_format || texture.levels.empty()) {
+            loge("Only BC1 and BC3 textures can be written to KTX2");
+            return false;
+        }
+
+        auto descriptor = make_data_format_descriptor(*block_format);
+
+        auto header = Ktx2Header {
+            .vk_format = static_cast<uint32_t>(texture.format),
+            .pixel_width = texture.width,
+            .pixel_height = texture.height,
+            .level_count = static_cast<uint32_t>(texture.levels.size()),
+            .dfd_offset = static_cast<uint32_t>(sizeof(Ktx2Header) + texture.levels.size() * sizeof(Ktx2Level)),
+            .dfd_length = static_cast<uint32_t>(descriptor.size())
+        };
+
+        // Levels are stored smallest first, each aligned to its block size
+        auto level_table = std::vector<Ktx2Level>(texture.levels.size());
+        auto offset = uint64_t(header.dfd_offset + header.dfd_length);
+
+        for (auto level = texture.levels.size(); level-- > 0; ) {
+            offset = align(offset, get_block_size(*block_format));
+            level_table[level] = { offset, texture.levels[level].size(), texture.levels[level].size() };
+            offset += texture.levels[level].size();
+        }
+
+        // Written next to the destination and renamed, so readers never open a partial file
+        auto temporary = std::filesystem::path(path).concat(".tmp");
+
+        {
+            auto output = std::ofstream(temporary, std::ios::binary | std::ios::trunc);
+
+            auto write_at = [&output] (uint64_t offset, const void* data, std::size_t size) {
+                while (static_cast<uint64_t>(output.tellp()) < offset) output.put(0);
+                output.write(static_cast<const char*>(data), size);
+            };
+
+            write_at(0, &header, sizeof(header));
+            write_at(sizeof(header), level_table.data(), level_table.size() * sizeof(Ktx2Level));
+            write_at(header.dfd_offset, descriptor.data(), descriptor.size());
+
+            for (auto level = texture.levels.size(); level-- > 0; )
+                write_at(level_table[level].offset, texture.levels[level].data(), texture.levels[level].size());
+
+            if (!output) {
+                logw("Failed to write {}", path.string());
+                return false;
+            }
+        }
+
+        auto error = std::error_code();
+        std::filesystem::rename(temporary, path, error);
+
+        if (error) {
+            logw("Failed to write {}: {}", path.string(), error.message());
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+
+        return true;
+
+    }
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace engine {
+
+    // Header of a KTX2 container as laid out in the file, followed by one Ktx2Level per mip level
+    struct Ktx2Header {
+
+        static constexpr std::array<uint8_t, 12> identifier_value = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+        std::array<uint8_t, 12> identifier = identifier_value;
+        uint32_t vk_format = 0;
+        uint32_t type_size = 1;
+        uint32_t pixel_width = 0;
+        uint32_t pixel_height = 0;
+        uint32_t pixel_depth = 0;
+        uint32_t layer_count = 0;
+        uint32_t face_count = 1;
+        uint32_t level_count = 0;
+        uint32_t supercompression_scheme = 0;
+        uint32_t dfd_offset = 0;
+        uint32_t dfd_length = 0;
+        uint32_t kvd_offset = 0;
+        uint32_t kvd_length = 0;
+        uint64_t sgd_offset = 0;
+        uint64_t sgd_length = 0;
+
+    };
+
+    struct Ktx2Level {
+        uint64_t offset;
+        uint64_t length;
+        uint64_t uncompressed_length;
+    };
+
+    static_assert(sizeof(Ktx2Header) == 80);
+    static_assert(sizeof(Ktx2Level) == 24);
+
+    // A 2D texture with its mip chain, level 0 is the full resolution
+    struct Ktx2Texture {
+        vk::Format format = vk::Format::eUndefined;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<std::vector<std::byte>> levels;
+    };
+
+    // Only plain 2D textures without supercompression in RGBA8 or a BC format are read, every level has to
+    // hold exactly the blocks of its extent
+    std::optional<Ktx2Texture> read_ktx2 (const std::filesystem::path& path);
+
+    // Writes BC1 and BC3 textures, the only formats there's a data format descriptor for
+    bool write_ktx2 (const std::filesystem::path& path, const Ktx2Texture& texture);
+
+}
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <vector>
+
+#include "layout_cache.hpp"
+
+#include "device.hpp"
+#include "shaders.hpp"
+
+#include "../utils/utils.hpp"
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    std::size_t LayoutCache::KeyHash::operator() (const SetLayoutKey& key) const {
+
+        std::size_t seed = 0;
+
+        for (const auto& binding : key)
+            hash_combine(seed, binding.binding, binding.descriptorType, binding.descriptorCount,
+                static_cast<VkShaderStageFlags>(binding.stageFlags), static_cast<const void*>(binding.pImmutableSamplers));
+
+        return seed;
+
+    }
+
+    std::size_t LayoutCache::KeyHash::operator() (const PipelineLayoutKey& key) const {
+
+        std::size_t seed = 0;
+
+        for (const auto& layout : key.set_layouts)
+            hash_combine(seed, static_cast<VkDescriptorSetLayout>(layout));
+
+        if (const auto& range = key.push_constant_range)
+            hash_combine(seed, static_cast<VkShaderStageFlags>(range->stageFlags), range->offset, range->size);
+
+        return seed;
+
+    }
+
+    vk::DescriptorSetLayout LayoutCache::get_set_layout (std::span<const vk::DescriptorSetLayoutBinding> bindings) {
+
+        auto lock = std::scoped_lock(mutex);
+        return get_set_layout_locked(bindings);
+
+    }
+
+    vk::DescriptorSetLayout LayoutCache::get_set_layout_locked (std::span<const vk::DescriptorSetLayoutBinding> bindings) {
+
+        auto key = SetLayoutKey(bindings.begin(), bindings.end());
+
+        if (auto layout = set_layouts.find(key); layout != set_layouts.end()) return layout->second;
+
+        auto resolved = std::vector(bindings.begin(), bindings.end());
+        auto binding_flags = std::vector<vk::DescriptorBindingFlags>(bindings.size());
+        auto is_bindless = false;
+
+        for (std::size_t i = 0; i < resolved.size(); i++) {
+
+            if (resolved.at(i).descriptorCount) continue;
+
+            using enum vk::DescriptorBindingFlagBits;
+
+            resolved.at(i).descriptorCount = bindless_capacity;
+            binding_flags.at(i) = ePartiallyBound | eUpdateAfterBind | eUpdateUnusedWhilePending;
+            is_bindless = true;
+
+        }
+
+        auto binding_flags_info = vk::DescriptorSetLayoutBindingFlagsCreateInfo {
+            .bindingCount = to_u32(binding_flags.size()),
+            .pBindingFlags = binding_flags.data()
+        };
+
+        auto create_info = vk::DescriptorSetLayoutCreateInfo {
+            .pNext = is_bindless ? &binding_flags_info : nullptr,
+            .flags = is_bindless ? vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool : vk::DescriptorSetLayoutCreateFlags(),
+            .bindingCount = to_u32(resolved.size()),
+            .pBindings = resolved.data()
+        };
+
+        try {
+            auto layout = Device::get()->get_handle().createDescriptorSetLayout(create_info);
+            logi("Created DescriptorSet layout with {} bindings", bindings.size());
+            return set_layouts[std::move(key)] = layout;
+        } catch (vk::SystemError err) {
+            loge("Failed to create DescriptorSet layout");
+            return nullptr;
+        }
+
+    }
+
+    vk::PipelineLayout LayoutCache::get_pipeline_layout (const ShaderReflection& reflection) {
+
+        auto lock = std::scoped_lock(mutex);
+
+        auto layouts = std::vector<vk::DescriptorSetLayout>();
+        auto set_count = reflection.descriptor_sets.empty() ? 0 : reflection.descriptor_sets.rbegin()->first + 1;
+
+        // Sets skipped by the shader still need a (empty) layout in their slot
+        for (uint32_t set = 0; set < set_count; set++) {
+            auto bindings = reflection.descriptor_sets.find(set);
+            if (bindings == reflection.descriptor_sets.end()) layouts.push_back(get_set_layout_locked({ }));
+            else layouts.push_back(get_set_layout_locked(bindings->second));
+        }
+
+        auto key = PipelineLayoutKey { layouts, reflection.push_constant_range };
+
+        if (auto layout = pipeline_layouts.find(key); layout != pipeline_layouts.end()) return layout->second;
+
+        auto create_info = vk::PipelineLayoutCreateInfo {
+            .flags = vk::PipelineLayoutCreateFlags(),
+            .setLayoutCount = to_u32(layouts.size()),
+            .pSetLayouts = layouts.data(),
+            .pushConstantRangeCount = reflection.push_constant_range ? 1u : 0u,
+            .pPushConstantRanges = reflection.push_constant_range ? &reflection.push_constant_range.value() : nullptr
+        };
+
+        try {
+            auto layout = Device::get()->get_handle().createPipelineLayout(create_info);
+            logi("Created PipeLine Layout");
+            return pipeline_layouts[std::move(key)] = layout;
+        } catch (vk::SystemError err) {
+            loge("Failed to create PipeLine Layout");
+            return nullptr;
+        }
+
+    }
+
+    vk::PipelineLayout LayoutCache::get_pipeline_layout (std::string shader_path) {
+
+        return get_pipeline_layout(Shader::reflect(shader_path));
+
+    }
+
+    void LayoutCache::clear ( ) {
+
+        auto lock = std::scoped_lock(mutex);
+        auto device = Device::get();
+
+        for (auto& [key, layout] : pipeline_layouts) device->get_handle().destroyPipelineLayout(layout);
+        for (auto& [key, layout] : set_layouts) device->get_handle().destroyDescriptorSetLayout(layout);
+
+        pipeline_layouts.clear();
+        set_layouts.clear();
+
+    }
+
+}
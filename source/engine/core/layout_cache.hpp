@@ -0,0 +1,51 @@
+#pragma once
+
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "reflection.hpp"
+
+namespace engine {
+
+    // Descriptor set and pipeline layouts are deduplicated by their contents and live until clear()
+    class LayoutCache {
+
+        // Layouts are keyed by their full contents, the hash only picks the bucket
+        using SetLayoutKey = std::vector<vk::DescriptorSetLayoutBinding>;
+
+        struct PipelineLayoutKey {
+            std::vector<vk::DescriptorSetLayout> set_layouts;
+            std::optional<vk::PushConstantRange> push_constant_range;
+
+            bool operator== (const PipelineLayoutKey&) const = default;
+        };
+
+        struct KeyHash {
+            std::size_t operator() (const SetLayoutKey& key) const;
+            std::size_t operator() (const PipelineLayoutKey& key) const;
+        };
+
+        static inline std::mutex mutex;
+        static inline std::unordered_map<SetLayoutKey, vk::DescriptorSetLayout, KeyHash> set_layouts;
+        static inline std::unordered_map<PipelineLayoutKey, vk::PipelineLayout, KeyHash> pipeline_layouts;
+
+        static vk::DescriptorSetLayout get_set_layout_locked (std::span<const vk::DescriptorSetLayoutBinding> bindings);
+
+        public:
+
+        // Unsized descriptor arrays in shaders are created as bindless tables of this many descriptors
+        static constexpr uint32_t bindless_capacity = 4096;
+
+        static vk::DescriptorSetLayout get_set_layout (std::span<const vk::DescriptorSetLayoutBinding> bindings);
+        static vk::PipelineLayout get_pipeline_layout (const ShaderReflection& reflection);
+        static vk::PipelineLayout get_pipeline_layout (std::string shader_path);
+
+        static void clear ( );
+
+    };
+
+}
@@ -3,6 +3,7 @@
 #define VMA_IMPLEMENTATION
 
 #include "memory.hpp"
+#include "descriptor_allocator.hpp"
 
 #include "../utils/logging.hpp"
 #include "../utils/utils.hpp"
@@ -70,10 +71,10 @@ namespace engine {
 
     }
 
-    VMABuffer::VMABuffer (std::size_t size, vk::BufferUsageFlags usage, bool persistent, bool device_local) 
+    VMABuffer::VMABuffer (std::size_t size, vk::BufferUsageFlags usage, bool persistent, bool device_local, bool readback) 
         : size(size), persistent(persistent), device_local(device_local) {
 
-        auto flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+        auto flags = readback ? VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT : VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
 
         if(device_local) {
             usage |= vk::BufferUsageFlagBits::eTransferDst;
@@ -106,10 +107,23 @@ namespace engine {
 
     VMABuffer::~VMABuffer ( ) {
 
+        DescriptorAllocator::release(handle);
         vmaDestroyBuffer(Device::get()->get_allocator(), VkBuffer(handle), allocation);
 
     }
 
+    void VMABuffer::invalidate ( ) const {
+
+        vmaInvalidateAllocation(Device::get()->get_allocator(), allocation, 0, VK_WHOLE_SIZE);
+
+    }
+
+    void VMABuffer::flush (std::size_t offset, std::size_t size) const {
+
+        vmaFlushAllocation(Device::get()->get_allocator(), allocation, offset, size);
+
+    }
+
     void copy_buffer (const vk::Buffer& source, const vk::Buffer& destination, std::size_t size) {
 
         auto device = Device::get();
@@ -80,7 +80,8 @@ namespace engine {
 
         public:
 
-        VMABuffer (std::size_t size, vk::BufferUsageFlags usage, bool persistent = false, bool device_local = false);
+        // Readback buffers are allocated for random host access, so the CPU reads them from cached memory
+        VMABuffer (std::size_t size, vk::BufferUsageFlags usage, bool persistent = false, bool device_local = false, bool readback = false);
         ~VMABuffer ( );
 
         VMABuffer (const VMABuffer&) = delete;
@@ -113,8 +114,13 @@ namespace engine {
 
         }
 
+        // Make device writes visible to the host and host writes visible to the device, no-ops on coherent memory
+        void invalidate ( ) const;
+        void flush (std::size_t offset = 0, std::size_t size = VK_WHOLE_SIZE) const;
+
         constexpr const vk::Buffer& get_handle ( ) const { return handle; }
         constexpr const std::size_t get_size ( ) const { return size; }
+        constexpr void* get_mapped ( ) const { return persistent ? alloc_info.pMappedData : nullptr; }
 
     };
 
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <limits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "model.hpp"
+#include "obj_loader.hpp"
+
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    namespace {
+
+        struct MappedFile {
+            void* data = MAP_FAILED;
+            std::size_t size = 0;
+        };
+
+        MappedFile map_file (const std::filesystem::path& path, int flags = 0) {
+
+            auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) return { };
+
+            struct stat status;
+            auto size = fstat(fd, &status) == 0 ? static_cast<std::size_t>(status.st_size) : 0;
+            auto data = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE | flags, fd, 0) : MAP_FAILED;
+
+            ::close(fd);
+
+            return { data, size };
+
+        }
+
+        // Largest index of a run of the index table, which lies in the file and is aligned
+        template <typename Index> uint64_t get_max_index (std::span<const std::byte> index_data, uint32_t first, uint32_t count) {
+
+            auto indices = std::span(reinterpret_cast<const Index*>(index_data.data()) + first, count);
+            return *std::ranges::max_element(indices);
+
+        }
+
+        struct SourceInfo {
+            uint64_t size;
+            int64_t time;
+        };
+
+        std::optional<SourceInfo> get_source_info (const std::filesystem::path& source) {
+
+            auto error = std::error_code();
+
+            auto size = std::filesystem::file_size(source, error);
+            if (error) return std::nullopt;
+
+            auto time = std::filesystem::last_write_time(source, error);
+            if (error) return std::nullopt;
+
+            return SourceInfo { size, static_cast<int64_t>(time.time_since_epoch().count()) };
+
+        }
+
+        std::optional<uint64_t> hash_source (const std::filesystem::path& source) {
+
+            auto file = map_file(source);
+            if (file.data == MAP_FAILED) return std::nullopt;
+
+            auto hash = hash_mesh_source(static_cast<const unsigned char*>(file.data), file.size);
+            munmap(file.data, file.size);
+
+            return hash;
+
+        }
+
+        // The source changed on disk but not in content, recording its new size and time spares the next open hashing it
+        void refresh_source_info (const std::filesystem::path& cache, const SourceInfo& info) {
+
+            auto file = std::fstream(cache, std::ios::binary | std::ios::in | std::ios::out);
+
+            file.seekp(offsetof(MeshCacheHeader, source_size));
+            file.write(reinterpret_cast<const char*>(&info.size), sizeof(info.size));
+            file.seekp(offsetof(MeshCacheHeader, source_time));
+            file.write(reinterpret_cast<const char*>(&info.time), sizeof(info.time));
+
+            if (!file) logw("Failed to refresh mesh cache {}", cache.string());
+
+        }
+
+        constexpr uint64_t align (uint64_t offset) {
+
+            return (offset + mesh_cache_alignment - 1) / mesh_cache_alignment * mesh_cache_alignment;
+
+        }
+
+    }
+
+    MeshCache::Mapping::~Mapping ( ) {
+
+        if (data) munmap(data, size);
+
+    }
+
+    std::span<const Vertex> MeshCache::Mapping::get_vertices ( ) const {
+
+        const auto& header = get_header();
+        return { reinterpret_cast<const Vertex*>(static_cast<const std::byte*>(data) + header.vertex_offset), header.vertex_count };
+
+    }
+
+    std::span<const std::byte> MeshCache::Mapping::get_index_data ( ) const {
+
+        const auto& header = get_header();
+        return { static_cast<const std::byte*>(data) + header.index_offset, header.index_count * header.index_size };
+
+    }
+
+    std::span<const MeshCacheSubmesh> MeshCache::Mapping::get_submeshes ( ) const {
+
+        const auto& header = get_header();
+        return { reinterpret_cast<const MeshCacheSubmesh*>(static_cast<const std::byte*>(data) + header.submesh_offset), header.submesh_count };
+
+    }
+
+    std::span<const MeshCacheLod> MeshCache::Mapping::get_lods ( ) const {
+
+        const auto& header = get_header();
+        return { reinterpret_cast<const MeshCacheLod*>(static_cast<const std::byte*>(data) + header.lod_offset), header.lod_count };
+
+    }
+
+    std::filesystem::path MeshCache::get_cache_path (const std::filesystem::path& source) {
+
+        return std::filesystem::path(source).replace_extension(".mesh");
+
+    }
+
+    std::optional<MeshCache::Mapping> MeshCache::open (const std::filesystem::path& source) {
+
+        return open(source, get_cache_path(source));
+
+    }
+
+    std::optional<MeshCache::Mapping> MeshCache::open (const std::filesystem::path& source, const std::filesystem::path& cache) {
+
+        SCOPED_PERF_LOG;
+
+        // Populating reads the whole file ahead at disk speed instead of faulting page by page
+        auto file = map_file(cache, MAP_POPULATE);
+
+        if (file.data == MAP_FAILED) {
+            logi("No mesh cache at {}", cache.string());
+            return std::nullopt;
+        }
+
+        auto mapping = Mapping(file.data, file.size);
+
+        if (file.size < sizeof(MeshCacheHeader)) {
+            logw("Mesh cache {} is truncated", cache.string());
+            return std::nullopt;
+        }
+
+        const auto& header = mapping.get_header();
+
+        // Divides instead of multiplying, counts read from a corrupt file must not wrap around
+        auto fits = [&] (uint64_t offset, uint64_t count, uint64_t stride) {
+            return offset % mesh_cache_alignment == 0 && offset <= file.size && count <= (file.size - offset) / stride;
+        };
+
+        auto valid = header.magic == MeshCacheHeader::magic_value && header.version == MeshCacheHeader::current_version
+            && header.vertex_format == static_cast<uint32_t>(MeshVertexFormat::full) && header.vertex_stride == sizeof(Vertex)
+            && (header.index_size == sizeof(uint16_t) || header.index_size == sizeof(uint32_t))
+            && fits(header.vertex_offset, header.vertex_count, header.vertex_stride)
+            && fits(header.index_offset, header.index_count, header.index_size)
+            && fits(header.submesh_offset, header.submesh_count, sizeof(MeshCacheSubmesh))
+            && header.lod_count > 0 && fits(header.lod_offset, header.lod_count, sizeof(MeshCacheLod));
+
+        // The tables are only read once their extents are known to lie in the file
+        valid = valid && std::ranges::all_of(mapping.get_submeshes(), [&header] (const MeshCacheSubmesh& submesh) {
+                return uint64_t(submesh.first_index) + submesh.index_count <= header.index_count
+                    && submesh.vertex_offset >= 0 && uint64_t(submesh.vertex_offset) <= header.vertex_count;
+            })
+            && std::ranges::all_of(mapping.get_lods(), [&header] (const MeshCacheLod& lod) {
+                return lod.submesh_count > 0 && uint64_t(lod.first_submesh) + lod.submesh_count <= header.submesh_count;
+            });
+
+        // Every index has to land on a vertex, the CPU and the GPU both index the vertices without checking
+        valid = valid && std::ranges::all_of(mapping.get_submeshes(), [&header, &mapping] (const MeshCacheSubmesh& submesh) {
+                if (!submesh.index_count) return true;
+                auto maximum = header.index_size == sizeof(uint16_t)
+                    ? get_max_index<uint16_t>(mapping.get_index_data(), submesh.first_index, submesh.index_count)
+                    : get_max_index<uint32_t>(mapping.get_index_data(), submesh.first_index, submesh.index_count);
+                return uint64_t(submesh.vertex_offset) + maximum < header.vertex_count;
+            });
+
+        if (!valid) {
+            logw("Mesh cache {} is invalid or out of date", cache.string());
+            return std::nullopt;
+        }
+
+        // Without the source the cache is all there is, shipped builds may only contain caches
+        if (auto info = get_source_info(source); info && (info->size != header.source_size || info->time != header.source_time)) {
+
+            if (hash_source(source) != header.source_hash) {
+                logi("Mesh cache {} is stale", cache.string());
+                return std::nullopt;
+            }
+
+            refresh_source_info(cache, *info);
+
+        }
+
+        return mapping;
+
+    }
+
+    bool MeshCache::write (const std::filesystem::path& source, const std::filesystem::path& cache, std::span<const Vertex> vertices,
+        std::span<const std::byte> index_data, uint32_t index_size, std::span<const MeshCacheSubmesh> submeshes,
+        std::span<const MeshCacheLod> lods) {
+
+        SCOPED_PERF_LOG;
+
+        auto info = get_source_info(source);
+        auto hash = hash_source(source);
+
+        if (!info || !hash) {
+            loge("Failed to read {} while caching it", source.string());
+            return false;
+        }
+
+        auto header = MeshCacheHeader {
+            .vertex_format = static_cast<uint32_t>(MeshVertexFormat::full),
+            .vertex_stride = sizeof(Vertex),
+            .index_size = index_size,
+            .submesh_count = to_u32(submeshes.size()),
+            .lod_count = to_u32(lods.size()),
+            .vertex_count = vertices.size(),
+            .index_count = index_data.size() / index_size,
+            .source_size = info->size,
+            .source_time = info->time,
+            .source_hash = *hash
+        };
+
+        auto minimum = glm::vec3(std::numeric_limits<float>::max());
+        auto maximum = glm::vec3(std::numeric_limits<float>::lowest());
+
+        for (const auto& vertex : vertices) {
+            minimum = glm::min(minimum, vertex.position);
+            maximum = glm::max(maximum, vertex.position);
+        }
+
+        std::copy_n(&minimum.x, 3, header.bounds_min);
+        std::copy_n(&maximum.x, 3, header.bounds_max);
+
+        header.vertex_offset = align(sizeof(MeshCacheHeader));
+        header.index_offset = align(header.vertex_offset + vertices.size_bytes());
+        header.submesh_offset = align(header.index_offset + index_data.size());
+        header.lod_offset = align(header.submesh_offset + submeshes.size_bytes());
+
+        // Written next to the destination and renamed, so readers never map a partial file
+        auto temporary = std::filesystem::path(cache).concat(".tmp");
+
+        {
+            auto output = std::ofstream(temporary, std::ios::binary | std::ios::trunc);
+
+            auto write_at = [&output] (uint64_t offset, const void* data, std::size_t size) {
+                while (static_cast<uint64_t>(output.tellp()) < offset) output.put(0);
+                output.write(static_cast<const char*>(data), size);
+            };
+
+            write_at(0, &header, sizeof(header));
+            write_at(header.vertex_offset, vertices.data(), vertices.size_bytes());
+            write_at(header.index_offset, index_data.data(), index_data.size());
+            write_at(header.submesh_offset, submeshes.data(), submeshes.size_bytes());
+            write_at(header.lod_offset, lods.data(), lods.size_bytes());
+
+            if (!output) {
+                logw("Failed to write mesh cache {}", cache.string());
+                return false;
+            }
+        }
+
+        auto error = std::error_code();
+        std::filesystem::rename(temporary, cache, error);
+
+        if (error) {
+            logw("Failed to write mesh cache {}: {}", cache.string(), error.message());
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+
+        logi("Cached {} as {}", source.string(), cache.string());
+
+        return true;
+
+    }
+
+    bool MeshCache::convert (const std::filesystem::path& source, const std::filesystem::path& cache) {
+
+        auto mesh = load_obj(source);
+
+        if (mesh.vertices.empty()) return false;
+
+        optimize_mesh(mesh.vertices, mesh.indices);
+
+        auto submeshes = std::vector { Submesh { .first_index = 0, .index_count = to_u32(mesh.indices.size()), .vertex_offset = 0 } };
+        auto lods = append_lods(mesh.vertices, mesh.indices, submeshes);
+
+        auto index_type = pick_index_type(mesh.vertices.size());
+        auto index_data = pack_indices(mesh.indices, index_type);
+
+        auto cached_submeshes = std::vector<MeshCacheSubmesh>();
+        for (const auto& submesh : submeshes) cached_submeshes.push_back({ submesh.first_index, submesh.index_count, submesh.vertex_offset });
+
+        auto cached_lods = std::vector<MeshCacheLod>();
+        for (const auto& lod : lods) cached_lods.push_back({ lod.first_submesh, lod.submesh_count, lod.error });
+
+        return write(source, cache, mesh.vertices, index_data, get_index_size(index_type), cached_submeshes, cached_lods);
+
+    }
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <utility>
+
+#include "mesh_cache_format.hpp"
+
+#include "../utils/primitives.hpp"
+
+namespace engine {
+
+    // Binary copies of meshes next to their sources, like models/viking_room.mesh for models/viking_room.obj.
+    // The first load of a model writes one, later loads map it and upload the streams without parsing.
+    // A cache whose recorded source no longer matches is ignored and rewritten by the next load
+    class MeshCache {
+
+        public:
+
+        // Owns the mapped file, the spans point into it
+        class Mapping {
+
+            void* data = nullptr;
+            std::size_t size = 0;
+
+            public:
+
+            Mapping (void* data, std::size_t size) : data(data), size(size) { }
+            Mapping (Mapping&& other) noexcept : data(std::exchange(other.data, nullptr)), size(other.size) { }
+            ~Mapping ( );
+
+            Mapping (const Mapping&) = delete;
+            Mapping& operator= (const Mapping&) = delete;
+
+            const MeshCacheHeader& get_header ( ) const { return *static_cast<const MeshCacheHeader*>(data); }
+
+            std::span<const Vertex> get_vertices ( ) const;
+            std::span<const std::byte> get_index_data ( ) const;
+            std::span<const MeshCacheSubmesh> get_submeshes ( ) const;
+            std::span<const MeshCacheLod> get_lods ( ) const;
+
+            constexpr std::size_t get_size ( ) const { return size; }
+
+        };
+
+        static std::filesystem::path get_cache_path (const std::filesystem::path& source);
+
+        static std::optional<Mapping> open (const std::filesystem::path& source);
+        static std::optional<Mapping> open (const std::filesystem::path& source, const std::filesystem::path& cache);
+
+        static bool write (const std::filesystem::path& source, const std::filesystem::path& cache, std::span<const Vertex> vertices,
+            std::span<const std::byte> index_data, uint32_t index_size, std::span<const MeshCacheSubmesh> submeshes,
+            std::span<const MeshCacheLod> lods);
+
+        // Offline conversion with the same optimization and LOD chain as a load, but the index width is
+        // chosen from the vertex count alone and the mesh is not split
+        static bool convert (const std::filesystem::path& source, const std::filesystem::path& cache);
+
+    };
+
+}
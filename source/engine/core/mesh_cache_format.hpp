@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace engine {
+
+    // Layout of a cached mesh: the header followed by the vertex stream, the index stream already in
+    // its GPU index width, the submesh table and the LOD table, each aligned to 16 bytes. Offsets are from the start
+    // of the file, so every stream can be copied to a staging buffer straight from the mapped pages
+    struct MeshCacheHeader {
+
+        static constexpr uint32_t magic_value = 0x48534D4C; // "LMSH"
+        static constexpr uint32_t current_version = 3; // 2: meshes are stored optimized, 3: LOD table
+
+        uint32_t magic = magic_value;
+        uint32_t version = current_version;
+
+        uint32_t vertex_format = 0; // MeshVertexFormat
+        uint32_t vertex_stride = 0;
+        uint32_t index_size = 0;    // 2 or 4 bytes
+        uint32_t submesh_count = 0;
+        uint32_t lod_count = 0;
+        uint32_t reserved = 0;
+        uint64_t vertex_count = 0;
+        uint64_t index_count = 0;
+
+        float bounds_min[3] = { };
+        float bounds_max[3] = { };
+
+        // Identifies the source the cache was built from, the hash is only checked when size or time differ
+        uint64_t source_size = 0;
+        int64_t source_time = 0;
+        uint64_t source_hash = 0;
+
+        uint64_t vertex_offset = 0;
+        uint64_t index_offset = 0;
+        uint64_t submesh_offset = 0;
+        uint64_t lod_offset = 0;
+
+    };
+
+    enum class MeshVertexFormat : uint32_t {
+        full = 0 // engine::Vertex as is
+    };
+
+    struct MeshCacheSubmesh {
+        uint32_t first_index;
+        uint32_t index_count;
+        int32_t vertex_offset;
+        uint32_t reserved = 0;
+    };
+
+    // A run of submeshes drawing one level of detail, level 0 is the full mesh
+    struct MeshCacheLod {
+        uint32_t first_submesh;
+        uint32_t submesh_count;
+        float error;
+        uint32_t reserved = 0;
+    };
+
+    static_assert(sizeof(MeshCacheHeader) == 128);
+    static_assert(sizeof(MeshCacheSubmesh) == 16);
+    static_assert(sizeof(MeshCacheLod) == 16);
+
+    constexpr std::size_t mesh_cache_alignment = 16;
+
+    // Multiplicative hash over 8 byte words, fast enough to rehash large sources on every mismatch
+    inline uint64_t hash_mesh_source (const unsigned char* data, std::size_t size) {
+
+        uint64_t hash = 0xcbf29ce484222325 ^ size;
+
+        auto mix = [&hash] (uint64_t word) {
+            hash = (hash ^ word) * 0x9e3779b97f4a7c15;
+            hash ^= hash >> 29;
+        };
+
+        std::size_t i = 0;
+
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            mix(word);
+        }
+
+        uint64_t tail = 0;
+        std::memcpy(&tail, data + i, size - i);
+        mix(tail);
+
+        return hash;
+
+    }
+
+}
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <numeric>
+
+#include "mesh_optimizer.hpp"
+
+#include "../utils/utils.hpp"
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    VertexCacheStatistics analyze_vertex_cache (std::span<const uint32_t> indices, std::size_t vertex_count, std::size_t cache_size) {
+
+        constexpr auto never = std::numeric_limits<std::size_t>::max();
+
+        // A vertex is in the FIFO while fewer than cache_size misses happened since it was inserted
+        auto inserted = std::vector<std::size_t>(vertex_count, never);
+        auto misses = std::size_t(0);
+        auto referenced = std::size_t(0);
+
+        for (auto index : indices) {
+            if (inserted[index] == never) ++referenced;
+            if (inserted[index] == never || misses - inserted[index] >= cache_size) inserted[index] = misses++;
+        }
+
+        auto triangles = indices.size() / 3;
+
+        return {
+            .acmr = triangles ? double(misses) / triangles : 0,
+            .atvr = referenced ? double(misses) / referenced : 0
+        };
+
+    }
+
+    std::vector<std::size_t> optimize_vertex_cache (std::span<uint32_t> indices, std::size_t vertex_count, std::size_t cache_size) {
+
+        auto triangle_count = indices.size() / 3;
+        auto clusters = std::vector<std::size_t>();
+
+        if (!triangle_count) return clusters;
+
+        // Triangles adjacent to every vertex as offsets into one flat array
+        auto live = std::vector<uint32_t>(vertex_count, 0);
+        for (auto index : indices.first(triangle_count * 3)) ++live[index];
+
+        auto offsets = std::vector<std::size_t>(vertex_count + 1, 0);
+        std::inclusive_scan(live.begin(), live.end(), offsets.begin() + 1);
+
+        auto adjacency = std::vector<uint32_t>(offsets.back());
+        auto fill = std::vector<std::size_t>(offsets.begin(), offsets.end() - 1);
+
+        for (std::size_t triangle = 0; triangle < triangle_count; ++triangle)
+            for (std::size_t corner = 0; corner < 3; ++corner)
+                adjacency[fill[indices[triangle * 3 + corner]]++] = to_u32(triangle);
+
+        auto cache_time = std::vector<std::size_t>(vertex_count, 0);
+        auto emitted = std::vector<bool>(triangle_count, false);
+        auto dead_ends = std::vector<uint32_t>();
+        auto candidates = std::vector<uint32_t>();
+
+        auto output = std::vector<uint32_t>();
+        output.reserve(triangle_count * 3);
+
+        auto time = cache_size + 1;
+        auto cursor = std::size_t(0);
+
+        auto skip_dead_end = [&] ( ) -> int64_t {
+
+            while (!dead_ends.empty()) {
+                auto vertex = dead_ends.back();
+                dead_ends.pop_back();
+                if (live[vertex] > 0) return vertex;
+            }
+
+            for (; cursor < vertex_count; ++cursor)
+                if (live[cursor] > 0) return cursor;
+
+            return -1;
+
+        };
+
+        auto fanning = skip_dead_end();
+        auto dead_end = true;
+
+        while (fanning >= 0) {
+
+            if (dead_end) clusters.push_back(output.size() / 3);
+
+            candidates.clear();
+
+            for (auto i = offsets[fanning]; i < offsets[fanning + 1]; ++i) {
+
+                auto triangle = adjacency[i];
+                if (emitted[triangle]) continue;
+
+                for (std::size_t corner = 0; corner < 3; ++corner) {
+
+                    auto vertex = indices[triangle * 3 + corner];
+
+                    output.push_back(vertex);
+                    dead_ends.push_back(vertex);
+                    candidates.push_back(vertex);
+
+                    --live[vertex];
+
+                    if (time - cache_time[vertex] > cache_size) cache_time[vertex] = time++;
+
+                }
+
+                emitted[triangle] = true;
+
+            }
+
+            // Prefer the candidate that stays in the cache while its remaining triangles are emitted
+            auto best = int64_t(-1);
+            auto best_priority = int64_t(-1);
+
+            for (auto vertex : candidates) {
+
+                if (!live[vertex]) continue;
+
+                auto priority = int64_t(0);
+                if (time - cache_time[vertex] + 2 * live[vertex] <= cache_size) priority = time - cache_time[vertex];
+
+                if (priority > best_priority) {
+                    best_priority = priority;
+                    best = vertex;
+                }
+
+            }
+
+            dead_end = best == -1;
+            fanning = dead_end ? skip_dead_end() : best;
+
+        }
+
+        std::copy(output.begin(), output.end(), indices.begin());
+
+        return clusters;
+
+    }
+
+    void optimize_overdraw (std::span<uint32_t> indices, std::span<const Vertex> vertices, std::span<const std::size_t> clusters) {
+
+        auto triangle_count = indices.size() / 3;
+
+        if (clusters.size() < 2) return;
+
+        auto position = [&] (std::size_t triangle, std::size_t corner) { return vertices[indices[triangle * 3 + corner]].position; };
+
+        // Area weighted centroids and normals, the cross product carries the area
+        auto mesh_centroid = glm::vec3(0.f);
+        auto mesh_area = 0.f;
+
+        struct Cluster {
+            std::size_t begin, end;
+            glm::vec3 centroid;
+            glm::vec3 normal;
+            float sort_key;
+        };
+
+        auto sorted = std::vector<Cluster>();
+
+        for (std::size_t i = 0; i < clusters.size(); ++i) {
+
+            auto cluster = Cluster { clusters[i], i + 1 < clusters.size() ? clusters[i + 1] : triangle_count, glm::vec3(0.f), glm::vec3(0.f), 0.f };
+            auto area = 0.f;
+
+            for (auto triangle = cluster.begin; triangle < cluster.end; ++triangle) {
+
+                auto a = position(triangle, 0), b = position(triangle, 1), c = position(triangle, 2);
+                auto normal = glm::cross(b - a, c - a);
+                auto weight = glm::length(normal);
+
+                cluster.centroid += (a + b + c) / 3.f * weight;
+                cluster.normal += normal;
+                area += weight;
+
+            }
+
+            mesh_centroid += cluster.centroid;
+            mesh_area += area;
+
+            if (area > 0) cluster.centroid /= area;
+
+            sorted.push_back(cluster);
+
+        }
+
+        if (mesh_area > 0) mesh_centroid /= mesh_area;
+
+        for (auto& cluster : sorted) {
+            auto length = glm::length(cluster.normal);
+            cluster.sort_key = length > 0 ? glm::dot(cluster.centroid - mesh_centroid, cluster.normal / length) : 0.f;
+        }
+
+        std::stable_sort(sorted.begin(), sorted.end(), [] (const Cluster& a, const Cluster& b) { return a.sort_key > b.sort_key; });
+
+        auto output = std::vector<uint32_t>();
+        output.reserve(triangle_count * 3);
+
+        for (const auto& cluster : sorted)
+            output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+
+        std::copy(output.begin(), output.end(), indices.begin());
+
+    }
+
+    void optimize_vertex_fetch (std::vector<Vertex>& vertices, std::span<uint32_t> indices) {
+
+        constexpr auto unused = std::numeric_limits<uint32_t>::max();
+
+        auto remap = std::vector<uint32_t>(vertices.size(), unused);
+        auto reordered = std::vector<Vertex>();
+        reordered.reserve(vertices.size());
+
+        for (auto& index : indices) {
+
+            if (remap[index] == unused) {
+                remap[index] = to_u32(reordered.size());
+                reordered.push_back(vertices[index]);
+            }
+
+            index = remap[index];
+
+        }
+
+        vertices = std::move(reordered);
+
+    }
+
+    MeshOptimizationStatistics optimize_mesh (std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+
+        SCOPED_PERF_LOG;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        auto statistics = MeshOptimizationStatistics { .before = analyze_vertex_cache(indices, vertices.size()) };
+
+        auto clusters = optimize_vertex_cache(indices, vertices.size());
+        optimize_overdraw(indices, vertices, clusters);
+        optimize_vertex_fetch(vertices, indices);
+
+        statistics.after = analyze_vertex_cache(indices, vertices.size());
+        statistics.clusters = clusters.size();
+        statistics.time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        logi("Optimized mesh in {:.3f}ms, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, {} clusters", statistics.time,
+            statistics.before.acmr, statistics.after.acmr, statistics.before.atvr, statistics.after.atvr, statistics.clusters);
+
+        return statistics;
+
+    }
+
+}
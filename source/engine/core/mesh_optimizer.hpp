@@ -0,0 +1,44 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "../utils/primitives.hpp"
+
+namespace engine {
+
+    // Post transform cache behaviour of an index stream against a simulated FIFO cache.
+    // ACMR is cache misses per triangle, ATVR cache misses per referenced vertex where 1 is optimal
+    struct VertexCacheStatistics {
+        double acmr = 0;
+        double atvr = 0;
+    };
+
+    struct MeshOptimizationStatistics {
+        VertexCacheStatistics before;
+        VertexCacheStatistics after;
+        std::size_t clusters = 0;
+        double time = 0; // milliseconds
+    };
+
+    constexpr std::size_t vertex_cache_size = 16;
+
+    VertexCacheStatistics analyze_vertex_cache (std::span<const uint32_t> indices, std::size_t vertex_count,
+        std::size_t cache_size = vertex_cache_size);
+
+    // Tipsify, reorders triangles for the post transform cache. Returns the first triangle of every cluster,
+    // a new cluster starts wherever the walk hit a dead end and the cache is cold anyway
+    std::vector<std::size_t> optimize_vertex_cache (std::span<uint32_t> indices, std::size_t vertex_count,
+        std::size_t cache_size = vertex_cache_size);
+
+    // Orders clusters front to back from a view independent estimate, outward facing clusters away from
+    // the center are drawn first since they are the likeliest to occlude the rest
+    void optimize_overdraw (std::span<uint32_t> indices, std::span<const Vertex> vertices, std::span<const std::size_t> clusters);
+
+    // Renumbers vertices in order of first use so fetches walk the vertex buffer linearly, unused vertices are dropped
+    void optimize_vertex_fetch (std::vector<Vertex>& vertices, std::span<uint32_t> indices);
+
+    // Runs all of the above in order
+    MeshOptimizationStatistics optimize_mesh (std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+}
@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+#include "mesh_simplifier.hpp"
+
+#include "../utils/utils.hpp"
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    namespace {
+
+        // Sum of squared distances to planes as a symmetric 4x4 matrix, weighted by the area of the triangles
+        // the planes came from. The summed weight turns the sum into a mean
+        struct Quadric {
+
+            double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+            double weight = 0;
+
+            static Quadric from_plane (const glm::dvec3& normal, double distance, double weight) {
+
+                auto [a, b, c] = std::array { normal.x, normal.y, normal.z };
+                auto d = distance;
+
+                return {
+                    a * a * weight, a * b * weight, a * c * weight, a * d * weight,
+                    b * b * weight, b * c * weight, b * d * weight,
+                    c * c * weight, c * d * weight,
+                    d * d * weight,
+                    weight
+                };
+
+            }
+
+            Quadric operator+ (const Quadric& other) const {
+
+                return {
+                    xx + other.xx, xy + other.xy, xz + other.xz, xw + other.xw,
+                    yy + other.yy, yz + other.yz, yw + other.yw,
+                    zz + other.zz, zw + other.zw,
+                    ww + other.ww,
+                    weight + other.weight
+                };
+
+            }
+
+            // Root mean squared distance of the point to the planes
+            double get_error (const glm::dvec3& point) const {
+
+                auto [x, y, z] = std::array { point.x, point.y, point.z };
+
+                auto sum = xx * x * x + yy * y * y + zz * z * z + ww
+                    + 2 * (xy * x * y + xz * x * z + yz * y * z + xw * x + yw * y + zw * z);
+
+                return weight > 0 ? std::sqrt(std::max(sum, 0.0) / weight) : 0;
+
+            }
+
+        };
+
+        struct PositionHash {
+            std::size_t operator() (const glm::vec3& position) const noexcept {
+                auto hash = uint64_t(0);
+                for (auto component : { position.x, position.y, position.z })
+                    hash = (std::rotl(hash, 21) ^ std::bit_cast<uint32_t>(component + 0.f)) * 0x9e3779b97f4a7c15;
+                return static_cast<std::size_t>(hash ^ hash >> 32);
+            }
+        };
+
+        constexpr uint64_t edge_key (uint32_t from, uint32_t to) {
+            return uint64_t(from) << 32 | to;
+        }
+
+        struct Collapse {
+            uint32_t from;
+            uint32_t to;
+            float error;
+        };
+
+    }
+
+    SimplifiedMesh simplify_mesh (std::span<const Vertex> vertices, std::span<const uint32_t> indices, std::size_t target_index_count,
+        float max_error) {
+
+        SCOPED_PERF_LOG;
+
+        auto result = SimplifiedMesh { .indices = std::vector<uint32_t>(indices.begin(), indices.begin() + indices.size() / 3 * 3) };
+        auto& simplified = result.indices;
+
+        // Vertices at the same position form a group, linked in a ring. Groups of several vertices lie on a texture seam
+        auto group = std::vector<uint32_t>(vertices.size());
+        auto next_sibling = std::vector<uint32_t>(vertices.size());
+        auto positions = std::vector<glm::dvec3>();
+
+        {
+            auto first = std::unordered_map<glm::vec3, uint32_t, PositionHash>();
+            first.reserve(vertices.size());
+
+            for (uint32_t vertex = 0; vertex < vertices.size(); ++vertex) {
+
+                auto [head, inserted] = first.try_emplace(vertices[vertex].position, vertex);
+
+                if (inserted) {
+                    group[vertex] = to_u32(positions.size());
+                    next_sibling[vertex] = vertex;
+                    positions.emplace_back(vertices[vertex].position);
+                } else {
+                    group[vertex] = group[head->second];
+                    next_sibling[vertex] = next_sibling[head->second];
+                    next_sibling[head->second] = vertex;
+                }
+
+            }
+        }
+
+        auto group_count = positions.size();
+        auto triangle_groups = [&] (std::size_t triangle) {
+            return std::array { group[simplified[triangle * 3]], group[simplified[triangle * 3 + 1]], group[simplified[triangle * 3 + 2]] };
+        };
+
+        auto quadrics = std::vector<Quadric>(group_count);
+        auto group_edges = std::vector<uint64_t>();
+        group_edges.reserve(simplified.size());
+
+        for (std::size_t triangle = 0; triangle < simplified.size() / 3; ++triangle) {
+
+            auto corners = triangle_groups(triangle);
+
+            auto normal = glm::cross(positions[corners[1]] - positions[corners[0]], positions[corners[2]] - positions[corners[0]]);
+            auto length = glm::length(normal);
+
+            if (length > 0) {
+                auto quadric = Quadric::from_plane(normal / length, -glm::dot(normal / length, positions[corners[0]]), length / 2);
+                for (auto corner : corners) quadrics[corner] = quadrics[corner] + quadric;
+            }
+
+            for (std::size_t i = 0; i < 3; ++i) group_edges.push_back(edge_key(corners[i], corners[(i + 1) % 3]));
+
+        }
+
+        std::sort(group_edges.begin(), group_edges.end());
+
+        // An edge used in one direction only is on an open border, both its ends stay where they are
+        auto locked = std::vector<bool>(group_count, false);
+
+        for (auto edge : group_edges) {
+            auto from = uint32_t(edge >> 32), to = uint32_t(edge);
+            if (from != to && !std::binary_search(group_edges.begin(), group_edges.end(), edge_key(to, from))) locked[from] = locked[to] = true;
+        }
+
+        auto remap = std::vector<uint32_t>(vertices.size());
+        auto touched = std::vector<bool>(group_count);
+        auto collapses = std::vector<Collapse>();
+        auto pairs = std::vector<std::pair<uint32_t, uint32_t>>();
+
+        auto offsets = std::vector<uint32_t>(group_count + 1);
+        auto adjacency = std::vector<uint32_t>();
+
+        // Every pass collapses a set of edges whose neighbourhoods don't overlap, so the checks of one
+        // collapse are never invalidated by another of the same pass
+        while (simplified.size() > target_index_count) {
+
+            auto triangle_count = simplified.size() / 3;
+
+            collapses.clear();
+
+            for (std::size_t triangle = 0; triangle < triangle_count; ++triangle)
+                for (std::size_t i = 0; i < 3; ++i) {
+
+                    auto a = simplified[triangle * 3 + i], b = simplified[triangle * 3 + (i + 1) % 3];
+
+                    // Edges off borders are shared with a triangle that has them the other way around, only one adds them
+                    if (group[a] >= group[b]) continue;
+
+                    for (auto [from, to] : { std::pair(a, b), std::pair(b, a) })
+                        if (!locked[group[from]]) {
+                            auto error = (quadrics[group[from]] + quadrics[group[to]]).get_error(positions[group[to]]);
+                            collapses.push_back({ from, to, static_cast<float>(error) });
+                        }
+
+                }
+
+            std::sort(collapses.begin(), collapses.end(), [] (const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+            // Triangles around every group as offsets into one flat array
+            std::fill(offsets.begin(), offsets.end(), 0);
+            for (std::size_t triangle = 0; triangle < triangle_count; ++triangle)
+                for (auto corner : triangle_groups(triangle)) ++offsets[corner + 1];
+
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            adjacency.resize(offsets.back());
+
+            {
+                auto fill = std::vector<uint32_t>(offsets.begin(), offsets.end() - 1);
+                for (std::size_t triangle = 0; triangle < triangle_count; ++triangle)
+                    for (auto corner : triangle_groups(triangle)) adjacency[fill[corner]++] = to_u32(triangle);
+            }
+
+            std::iota(remap.begin(), remap.end(), 0);
+            std::fill(touched.begin(), touched.end(), false);
+
+            auto goal = triangle_count - target_index_count / 3;
+            auto removed = std::size_t(0);
+            auto applied = std::size_t(0);
+
+            for (const auto& collapse : collapses) {
+
+                if (collapse.error > max_error || removed >= goal) break;
+
+                auto from_group = group[collapse.from], to_group = group[collapse.to];
+                if (touched[from_group] || touched[to_group]) continue;
+
+                auto is_connected = [&] (uint32_t from, uint32_t to) {
+                    return std::any_of(adjacency.begin() + offsets[from_group], adjacency.begin() + offsets[from_group + 1], [&] (uint32_t triangle) {
+                        auto corners = std::span(simplified).subspan(triangle * 3, 3);
+                        return std::ranges::find(corners, from) != corners.end() && std::ranges::find(corners, to) != corners.end();
+                    });
+                };
+
+                // Every vertex of the source group moves to a different neighbour in the target group,
+                // for a vertex off seams that is the target of the collapse itself
+                pairs.clear();
+                auto valid = true;
+
+                for (auto from = collapse.from; valid; ) {
+
+                    auto target = collapse.to;
+                    auto found = false;
+
+                    do {
+                        auto taken = std::ranges::any_of(pairs, [target] (const auto& pair) { return pair.second == target; });
+                        found = !taken && is_connected(from, target);
+                        if (!found) target = next_sibling[target];
+                    } while (!found && target != collapse.to);
+
+                    if (found) pairs.emplace_back(from, target);
+                    valid = found;
+
+                    from = next_sibling[from];
+                    if (from == collapse.from) break;
+
+                }
+
+                if (!valid) continue;
+
+                // Triangles that survive the collapse may not turn over
+                auto collapsed = std::size_t(0);
+                auto flips = false;
+
+                for (auto i = offsets[from_group]; i < offsets[from_group + 1] && !flips; ++i) {
+
+                    auto corners = triangle_groups(adjacency[i]);
+
+                    if (std::ranges::find(corners, to_group) != corners.end()) {
+                        ++collapsed;
+                        continue;
+                    }
+
+                    auto moved = std::array { positions[corners[0]], positions[corners[1]], positions[corners[2]] };
+                    for (std::size_t corner = 0; corner < 3; ++corner)
+                        if (corners[corner] == from_group) moved[corner] = positions[to_group];
+
+                    auto before = glm::cross(positions[corners[1]] - positions[corners[0]], positions[corners[2]] - positions[corners[0]]);
+                    auto after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+
+                    flips = glm::dot(before, after) <= 0 && glm::dot(before, before) > 0;
+
+                }
+
+                if (flips) continue;
+
+                for (auto [from, to] : pairs) remap[from] = to;
+
+                quadrics[to_group] = quadrics[to_group] + quadrics[from_group];
+                result.error = std::max(result.error, collapse.error);
+
+                for (auto i = offsets[from_group]; i < offsets[from_group + 1]; ++i)
+                    for (auto corner : triangle_groups(adjacency[i])) touched[corner] = true;
+
+                removed += collapsed;
+                ++applied;
+
+            }
+
+            if (!applied) break;
+
+            // Triangles that lost a corner to a collapse have two corners at the same position now
+            auto kept = std::size_t(0);
+
+            for (std::size_t triangle = 0; triangle < triangle_count; ++triangle) {
+
+                auto a = remap[simplified[triangle * 3]], b = remap[simplified[triangle * 3 + 1]], c = remap[simplified[triangle * 3 + 2]];
+                if (group[a] == group[b] || group[b] == group[c] || group[a] == group[c]) continue;
+
+                simplified[kept++] = a;
+                simplified[kept++] = b;
+                simplified[kept++] = c;
+
+            }
+
+            simplified.resize(kept);
+
+        }
+
+        return result;
+
+    }
+
+}
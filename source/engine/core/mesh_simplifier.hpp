@@ -0,0 +1,22 @@
+#pragma once
+
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "../utils/primitives.hpp"
+
+namespace engine {
+
+    struct SimplifiedMesh {
+        std::vector<uint32_t> indices;
+        float error = 0; // in model units, the largest RMS distance of a collapsed vertex to the planes it replaced
+    };
+
+    // Quadric error edge collapse. Vertices only ever move onto one of their neighbours, so the result indexes
+    // the same vertices and can share their buffer. Vertices on open borders stay in place and vertices on
+    // texture seams only collapse along the seam, which keeps the outline and texture mapping intact
+    SimplifiedMesh simplify_mesh (std::span<const Vertex> vertices, std::span<const uint32_t> indices, std::size_t target_index_count,
+        float max_error = std::numeric_limits<float>::max());
+
+}
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "meshlet.hpp"
+
+#include "../utils/utils.hpp"
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    namespace {
+
+        void compute_bounds (Meshlet& meshlet, std::span<const Vertex> vertices, std::span<const uint32_t> indices) {
+
+            auto minimum = glm::vec3(std::numeric_limits<float>::max());
+            auto maximum = glm::vec3(std::numeric_limits<float>::lowest());
+
+            for (auto index : indices) {
+                minimum = glm::min(minimum, vertices[index].position);
+                maximum = glm::max(maximum, vertices[index].position);
+            }
+
+            meshlet.center = (minimum + maximum) * .5f;
+            meshlet.radius = 0;
+
+            for (auto index : indices) meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.center, vertices[index].position));
+
+            // Faces with counter clockwise winding, degenerate triangles face nowhere and are left out
+            auto normals = std::vector<glm::vec3>();
+            auto sum = glm::vec3(0.f);
+
+            for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+
+                auto& a = vertices[indices[i]].position;
+                auto& b = vertices[indices[i + 1]].position;
+                auto& c = vertices[indices[i + 2]].position;
+
+                auto normal = glm::cross(b - a, c - a);
+                auto length = glm::length(normal);
+
+                if (length > 0) {
+                    normals.push_back(normal / length);
+                    sum += normals.back();
+                }
+
+            }
+
+            meshlet.cone_axis = glm::vec3(0.f, 0.f, 1.f);
+            meshlet.cone_cutoff = 1;
+
+            if (normals.empty() || glm::length(sum) == 0) return;
+
+            meshlet.cone_axis = glm::normalize(sum);
+
+            auto min_dot = 1.f;
+            for (const auto& normal : normals) min_dot = std::min(min_dot, glm::dot(normal, meshlet.cone_axis));
+
+            // Triangles facing more than 90 degrees apart are visible from everywhere around the cone
+            if (min_dot > 0) meshlet.cone_cutoff = std::sqrt(1 - min_dot * min_dot);
+
+        }
+
+    }
+
+    void build_meshlets (std::span<const Vertex> vertices, std::span<const uint32_t> indices, std::vector<Meshlet>& meshlets,
+        std::vector<uint32_t>& meshlet_indices) {
+
+        SCOPED_PERF_LOG;
+
+        constexpr auto unused = std::numeric_limits<uint32_t>::max();
+
+        // Meshlet a vertex was last counted in, spares clearing a set whenever a meshlet closes
+        auto seen_by = std::vector<uint32_t>(vertices.size(), unused);
+
+        auto meshlet = Meshlet { .first_index = to_u32(meshlet_indices.size()) };
+
+        auto close_meshlet = [&] {
+            if (!meshlet.triangle_count) return;
+            compute_bounds(meshlet, vertices, std::span(meshlet_indices).subspan(meshlet.first_index, meshlet.triangle_count * 3));
+            meshlets.push_back(meshlet);
+            meshlet = Meshlet { .first_index = to_u32(meshlet_indices.size()) };
+        };
+
+        for (std::size_t triangle = 0; triangle + 2 < indices.size(); triangle += 3) {
+
+            auto corners = indices.subspan(triangle, 3);
+            auto id = to_u32(meshlets.size());
+
+            auto added = uint32_t(0);
+            for (std::size_t i = 0; i < 3; ++i)
+                if (seen_by[corners[i]] != id && std::find(corners.begin(), corners.begin() + i, corners[i]) == corners.begin() + i)
+                    ++added;
+
+            if (meshlet.vertex_count + added > max_meshlet_vertices || meshlet.triangle_count == max_meshlet_triangles) {
+                close_meshlet();
+                id = to_u32(meshlets.size());
+            }
+
+            for (auto vertex : corners) {
+                if (seen_by[vertex] != id) {
+                    seen_by[vertex] = id;
+                    ++meshlet.vertex_count;
+                }
+                meshlet_indices.push_back(vertex);
+            }
+
+            ++meshlet.triangle_count;
+
+        }
+
+        close_meshlet();
+
+    }
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "../utils/primitives.hpp"
+
+namespace engine {
+
+    // Limits of the meshlets mesh shading hardware is built around, small enough to cull at a useful granularity
+    constexpr std::size_t max_meshlet_vertices = 64;
+    constexpr std::size_t max_meshlet_triangles = 124;
+
+    // A run of triangles culled as a whole. Layout matches the std430 struct in shaders/cluster_cull.comp
+    struct Meshlet {
+        glm::vec3 center;      // bounding sphere in model space
+        float radius;
+        glm::vec3 cone_axis;   // average facing of the triangles
+        float cone_cutoff;     // sine of the normal cone's half angle, 1 when the triangles face too many ways to ever cull
+        uint32_t first_index;  // into the meshlet index stream
+        uint32_t triangle_count;
+        uint32_t vertex_count;
+        uint32_t padding = 0;
+    };
+
+    static_assert(sizeof(Meshlet) == 48);
+
+    // Splits triangles into meshlets in index order, which the vertex cache optimization already made spatially coherent.
+    // Meshlets and their indices are appended to the outputs, the indices themselves are copied unchanged
+    void build_meshlets (std::span<const Vertex> vertices, std::span<const uint32_t> indices, std::vector<Meshlet>& meshlets,
+        std::vector<uint32_t>& meshlet_indices);
+
+}
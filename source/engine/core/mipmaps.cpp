@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+#include <glm/gtc/constants.hpp>
+
+#include "mipmaps.hpp"
+
+namespace engine {
+
+    namespace {
+
+        constexpr auto filter_names = std::array<std::string_view, 4> { "blit", "box", "kaiser", "lanczos" };
+
+        constexpr float kernel_radius = 3.f;
+        constexpr float kaiser_alpha = 4.f;
+
+        float sinc (float x) {
+
+            x *= glm::pi<float>();
+            return x == 0 ? 1.f : std::sin(x) / x;
+
+        }
+
+        // Modified Bessel function of the first kind and order zero, its series converges quickly for the alphas used
+        float bessel_i0 (float x) {
+
+            auto sum = 1.f, term = 1.f;
+
+            for (auto k = 1; k < 16; ++k) {
+                term *= (x / (2 * k)) * (x / (2 * k));
+                sum += term;
+            }
+
+            return sum;
+
+        }
+
+        // Windowed sinc in texels of the smaller level
+        float evaluate (MipFilter filter, float x) {
+
+            x = std::abs(x);
+
+            if (x >= kernel_radius) return 0.f;
+
+            if (filter == MipFilter::kaiser) {
+                auto window = x / kernel_radius;
+                return sinc(x) * bessel_i0(kaiser_alpha * std::sqrt(1 - window * window)) / bessel_i0(kaiser_alpha);
+            }
+
+            return sinc(x) * sinc(x / kernel_radius);
+
+        }
+
+        // Texels of the larger level every texel of the smaller one sums along an axis, indices past the edges are clamped
+        struct Axis {
+
+            std::size_t tap_count;
+            std::vector<uint32_t> indices;
+            std::vector<float> weights;
+
+            Axis (std::size_t source, std::size_t target, MipFilter filter) {
+
+                auto scale = float(source) / target;
+                auto support = kernel_radius * scale;
+
+                tap_count = static_cast<std::size_t>(std::ceil(support * 2)) + 1;
+                indices.resize(target * tap_count);
+                weights.resize(target * tap_count);
+
+                for (std::size_t i = 0; i < target; ++i) {
+
+                    auto center = (i + 0.5f) * scale;
+                    auto first = static_cast<int64_t>(std::floor(center - support));
+                    auto sum = 0.f;
+
+                    for (std::size_t tap = 0; tap < tap_count; ++tap) {
+                        auto position = first + static_cast<int64_t>(tap);
+                        auto weight = evaluate(filter, (position + 0.5f - center) / scale);
+                        indices[i * tap_count + tap] = static_cast<uint32_t>(std::clamp<int64_t>(position, 0, source - 1));
+                        weights[i * tap_count + tap] = weight;
+                        sum += weight;
+                    }
+
+                    for (std::size_t tap = 0; tap < tap_count; ++tap) weights[i * tap_count + tap] /= sum;
+
+                }
+
+            }
+
+        };
+
+        // One plane per channel so the vertical pass runs over contiguous rows the compiler vectorizes.
+        // Color is linear and multiplied by alpha
+        struct Planes {
+
+            std::size_t width;
+            std::size_t height;
+            std::array<std::vector<float>, 4> channels;
+
+            Planes (std::size_t width, std::size_t height) : width(width), height(height) {
+                for (auto& channel : channels) channel.resize(width * height);
+            }
+
+        };
+
+        const std::array<float, 256>& get_linear_table ( ) {
+
+            static const auto table = [] {
+                auto table = std::array<float, 256>();
+                for (std::size_t i = 0; i < table.size(); ++i) {
+                    auto value = i / 255.f;
+                    table[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+                }
+                return table;
+            }();
+
+            return table;
+
+        }
+
+        std::byte to_srgb (float value) {
+
+            value = std::clamp(value, 0.f, 1.f);
+            value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1 / 2.4f) - 0.055f;
+            return std::byte(static_cast<uint8_t>(std::round(value * 255.f)));
+
+        }
+
+        Planes to_planes (std::span<const std::byte> pixels, std::size_t width, std::size_t height) {
+
+            const auto& linear = get_linear_table();
+            auto planes = Planes(width, height);
+
+            for (std::size_t i = 0; i < width * height; ++i) {
+                auto alpha = std::to_integer<uint8_t>(pixels[i * 4 + 3]) / 255.f;
+                for (auto channel = 0; channel < 3; ++channel) planes.channels[channel][i] = linear[std::to_integer<uint8_t>(pixels[i * 4 + channel])] * alpha;
+                planes.channels[3][i] = alpha;
+            }
+
+            return planes;
+
+        }
+
+        std::vector<std::byte> to_pixels (const Planes& planes) {
+
+            auto pixels = std::vector<std::byte>(planes.width * planes.height * 4);
+
+            for (std::size_t i = 0; i < planes.width * planes.height; ++i) {
+                auto alpha = std::clamp(planes.channels[3][i], 0.f, 1.f);
+                for (auto channel = 0; channel < 3; ++channel) pixels[i * 4 + channel] = alpha > 0 ? to_srgb(planes.channels[channel][i] / alpha) : std::byte(0);
+                pixels[i * 4 + 3] = std::byte(static_cast<uint8_t>(std::round(alpha * 255.f)));
+            }
+
+            return pixels;
+
+        }
+
+        // Averages every 2x2 texels, in linear light so dark and bright texels mix as they would on screen. Odd
+        // edges repeat their last row or column
+        std::vector<std::byte> downsample (std::span<const std::byte> pixels, std::size_t width, std::size_t height) {
+
+            const auto& linear = get_linear_table();
+
+            auto result_width = get_mip_extent(width, 1), result_height = get_mip_extent(height, 1);
+            auto result = std::vector<std::byte>(result_width * result_height * 4);
+
+            for (std::size_t y = 0; y < result_height; ++y) for (std::size_t x = 0; x < result_width; ++x) {
+
+                auto sum = std::array<float, 4>();
+
+                for (auto source_y : { std::min(y * 2, height - 1), std::min(y * 2 + 1, height - 1) })
+                    for (auto source_x : { std::min(x * 2, width - 1), std::min(x * 2 + 1, width - 1) }) {
+                        auto texel = pixels.data() + (source_y * width + source_x) * 4;
+                        for (auto channel = 0; channel < 3; ++channel) sum[channel] += linear[std::to_integer<uint8_t>(texel[channel])];
+                        sum[3] += std::to_integer<uint8_t>(texel[3]);
+                    }
+
+                auto output = result.data() + (y * result_width + x) * 4;
+
+                for (auto channel = 0; channel < 3; ++channel) output[channel] = to_srgb(sum[channel] / 4);
+                output[3] = std::byte(static_cast<uint8_t>(std::round(sum[3] / 4)));
+
+            }
+
+            return result;
+
+        }
+
+        Planes resample (const Planes& source, std::size_t width, std::size_t height, MipFilter filter) {
+
+            auto vertical = Axis(source.height, height, filter);
+            auto horizontal = Axis(source.width, width, filter);
+
+            auto result = Planes(width, height);
+
+            auto rows = std::vector<std::size_t>(height);
+            std::iota(rows.begin(), rows.end(), 0);
+
+            std::for_each(std::execution::par, rows.begin(), rows.end(), [&] (std::size_t y) {
+
+                auto row = std::vector<float>(source.width);
+
+                for (std::size_t channel = 0; channel < source.channels.size(); ++channel) {
+
+                    std::ranges::fill(row, 0.f);
+
+                    for (std::size_t tap = 0; tap < vertical.tap_count; ++tap) {
+                        auto weight = vertical.weights[y * vertical.tap_count + tap];
+                        auto input = source.channels[channel].data() + vertical.indices[y * vertical.tap_count + tap] * source.width;
+                        for (std::size_t x = 0; x < source.width; ++x) row[x] += weight * input[x];
+                    }
+
+                    auto output = result.channels[channel].data() + y * width;
+
+                    for (std::size_t x = 0; x < width; ++x) {
+                        auto sum = 0.f;
+                        for (std::size_t tap = 0; tap < horizontal.tap_count; ++tap)
+                            sum += horizontal.weights[x * horizontal.tap_count + tap] * row[horizontal.indices[x * horizontal.tap_count + tap]];
+                        output[x] = sum;
+                    }
+
+                }
+
+            });
+
+            return result;
+
+        }
+
+    }
+
+    std::string_view to_string (MipFilter filter) {
+
+        return filter_names.at(static_cast<std::size_t>(filter));
+
+    }
+
+    std::optional<MipFilter> parse_mip_filter (std::string_view name) {
+
+        auto found = std::ranges::find(filter_names, name);
+        if (found == filter_names.end()) return std::nullopt;
+
+        return static_cast<MipFilter>(found - filter_names.begin());
+
+    }
+
+    uint32_t get_mip_count (std::size_t width, std::size_t height) {
+
+        return static_cast<uint32_t>(std::bit_width(std::max(width, height)));
+
+    }
+
+    std::vector<std::vector<std::byte>> generate_mipmaps (std::span<const std::byte> pixels, std::size_t width, std::size_t height, MipFilter filter) {
+
+        auto levels = std::vector<std::vector<std::byte>>();
+
+        if (filter == MipFilter::blit || filter == MipFilter::box) {
+
+            for (uint32_t level = 1; level < get_mip_count(width, height); ++level) {
+                auto previous = level == 1 ? pixels : std::span<const std::byte>(levels.back());
+                levels.push_back(downsample(previous, get_mip_extent(width, level - 1), get_mip_extent(height, level - 1)));
+            }
+
+            return levels;
+
+        }
+
+        auto planes = to_planes(pixels, width, height);
+
+        for (uint32_t level = 1; level < get_mip_count(width, height); ++level) {
+            planes = resample(planes, get_mip_extent(width, level), get_mip_extent(height, level), filter);
+            levels.push_back(to_pixels(planes));
+        }
+
+        return levels;
+
+    }
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace engine {
+
+    // How the levels below the first are made. Blits run on the device at upload, the others on the CPU
+    // in linear light, so they can also run offline and be stored with the image
+    enum class MipFilter : uint32_t {
+        blit,    // linear blits of the device, the CPU falls back to box for it
+        box,     // 2x2 average
+        kaiser,  // Kaiser windowed sinc over three texels of the smaller level on each side, six of the larger
+        lanczos  // Lanczos windowed sinc over the same radius, a little sharper with more ringing
+    };
+
+    std::string_view to_string (MipFilter filter);
+    std::optional<MipFilter> parse_mip_filter (std::string_view name);
+
+    // Levels of a full chain, every level halves the larger extent and the last one is 1x1
+    uint32_t get_mip_count (std::size_t width, std::size_t height);
+
+    constexpr std::size_t get_mip_extent (std::size_t extent, uint32_t level) { return std::max<std::size_t>(1, extent >> level); }
+
+    // Every level below the first of sRGB RGBA8 pixels. Box filtering averages the previous level in linear light,
+    // the windowed filters keep it as float with color weighted by alpha so transparent texels don't bleed into
+    // their neighbours
+    std::vector<std::vector<std::byte>> generate_mipmaps (std::span<const std::byte> pixels, std::size_t width, std::size_t height, MipFilter filter);
+
+}
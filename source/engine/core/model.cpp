@@ -1,70 +1,392 @@
-#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
 
-#include <tiny_obj_loader.h>
+#include <glm/gtc/type_ptr.hpp>
 
 #include "model.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "obj_loader.hpp"
 
 #include "../utils/logging.hpp"
 
 namespace engine {
 
-    Model::Model (std::span<Vertex> vertices, std::span<index_type> indices) {
+    Model::Model (std::span<const Vertex> vertices, std::span<const uint32_t> indices, VertexLayout layout) {
 
         this->vertices.assign(vertices.begin(), vertices.end());
         this->indices.assign(indices.begin(), indices.end());
 
+        select_layout(layout);
+        select_index_type();
+        generate_lods();
         update_buffers();
 
     }
 
-    Model::Model (std::string_view path) {
+    Model::Model (std::string_view path, VertexLayout layout) {
 
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string error;
+        auto source = std::filesystem::path(path);
 
-        auto result = tinyobj::LoadObj(&attrib, &shapes, &materials, nullptr, &error, path.data());
-        if (!result) log(error, log_level::error);
+        if (load_cache(source, layout)) return;
 
-        auto unique_vertices = std::unordered_map<Vertex, index_type>();
+        auto mesh = load_obj(source);
 
-        for (const auto& shape : shapes) for (const auto& index : shape.mesh.indices) {
+        vertices = std::move(mesh.vertices);
+        indices = std::move(mesh.indices);
 
-            auto vertex = Vertex {
-                .position = {
-                    attrib.vertices.at(3 * index.vertex_index + 0),
-                    attrib.vertices.at(3 * index.vertex_index + 1),
-                    attrib.vertices.at(3 * index.vertex_index + 2),
-                },
-                .color = {1.f, 1.f, 1.f},
-                .texture_coordinates = {
-                    attrib.texcoords.at(2 * index.texcoord_index + 0),
-                    1.f - attrib.texcoords.at(2 * index.texcoord_index + 1)
+        // Optimized once here, the mesh cache keeps the result for later runs
+        optimize_mesh(vertices, indices);
+
+        select_layout(layout);
+        select_index_type();
+        generate_lods();
+        update_buffers();
+
+        auto cached_submeshes = std::vector<MeshCacheSubmesh>();
+        for (const auto& submesh : submeshes)
+            cached_submeshes.push_back({ submesh.first_index, submesh.index_count, submesh.vertex_offset });
+
+        auto cached_lods = std::vector<MeshCacheLod>();
+        for (const auto& lod : lods) cached_lods.push_back({ lod.first_submesh, lod.submesh_count, lod.error });
+
+        if (!vertices.empty())
+            MeshCache::write(source, MeshCache::get_cache_path(source), vertices, pack_indices(indices, index_type),
+                get_index_size(index_type), cached_submeshes, cached_lods);
+
+    }
+
+    std::vector<std::byte> pack_indices (std::span<const uint32_t> indices, vk::IndexType index_type) {
+
+        if (index_type == vk::IndexType::eUint32) {
+            auto bytes = std::as_bytes(indices);
+            return { bytes.begin(), bytes.end() };
+        }
+
+        auto short_indices = std::vector<uint16_t>(indices.begin(), indices.end());
+        auto bytes = std::as_bytes(std::span(short_indices));
+
+        return { bytes.begin(), bytes.end() };
+
+    }
+
+    std::vector<uint32_t> unpack_indices (std::span<const std::byte> index_data, vk::IndexType index_type) {
+
+        auto indices = std::vector<uint32_t>(index_data.size() / get_index_size(index_type));
+
+        if (index_type == vk::IndexType::eUint32) std::memcpy(indices.data(), index_data.data(), indices.size() * sizeof(uint32_t));
+        else for (std::size_t i = 0; i < indices.size(); ++i) {
+            uint16_t index;
+            std::memcpy(&index, index_data.data() + i * sizeof(index), sizeof(index));
+            indices[i] = index;
+        }
+
+        return indices;
+
+    }
+
+    static std::size_t get_max_vertices ( ) {
+
+        auto limits = Device::get()->get_gpu().getProperties().limits;
+        return std::size_t(limits.maxDrawIndexedIndexValue) + 1;
+
+    }
+
+    bool Model::load_cache (const std::filesystem::path& path, VertexLayout requested) {
+
+        auto cache = MeshCache::open(path);
+        if (!cache) return false;
+
+        const auto& header = cache->get_header();
+
+        // Caches converted offline are never split, they only fit devices that can index every vertex
+        if (cache->get_lods().front().submesh_count == 1 && header.vertex_count > get_max_vertices()) return false;
+
+        auto cached_vertices = cache->get_vertices();
+        auto index_data = cache->get_index_data();
+
+        vertices.assign(cached_vertices.begin(), cached_vertices.end());
+        index_type = header.index_size == sizeof(uint16_t) ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+
+        packed_indices.assign(index_data.begin(), index_data.end());
+
+        for (const auto& submesh : cache->get_submeshes())
+            submeshes.push_back({ submesh.first_index, submesh.index_count, submesh.vertex_offset });
+
+        for (const auto& lod : cache->get_lods())
+            lods.push_back({ lod.first_submesh, lod.submesh_count, lod.error });
+
+        bounds = VertexBounds { glm::make_vec3(header.bounds_min), glm::make_vec3(header.bounds_max) };
+        layout = resolve_layout(requested, vertices);
+        dequantization = get_dequantization(layout, bounds);
+
+        // In the full layout both streams go from the mapped pages to the staging buffers as they are
+        if (layout == VertexLayout::full) upload(std::as_bytes(cached_vertices), index_data);
+        else upload(encode_vertices(vertices, layout, bounds), index_data);
+
+        return true;
+
+    }
+
+    void Model::select_layout (VertexLayout requested) {
+
+        bounds = get_bounds(vertices);
+        layout = resolve_layout(requested, vertices);
+        dequantization = get_dequantization(layout, bounds);
+
+    }
+
+    void Model::select_index_type ( ) {
+
+        auto max_vertices = get_max_vertices();
+
+        index_type = pick_index_type(vertices.size());
+
+        if (vertices.size() > max_vertices) split(max_vertices);
+        else submeshes = { Submesh { .first_index = 0, .index_count = to_u32(indices.size()), .vertex_offset = 0 } };
+
+    }
+
+    // Greedily packs triangles into submeshes that reference at most max_vertices vertices each,
+    // vertices shared across a submesh boundary are duplicated
+    void Model::split (std::size_t max_vertices) {
+
+        SCOPED_PERF_LOG;
+
+        constexpr auto unassigned = std::numeric_limits<uint32_t>::max();
+
+        auto remap = std::vector<uint32_t>(vertices.size(), unassigned);
+        auto used = std::vector<uint32_t>();
+
+        auto split_vertices = std::vector<Vertex>();
+        auto split_indices = std::vector<uint32_t>();
+        split_indices.reserve(indices.size());
+
+        submeshes.clear();
+
+        auto close_submesh = [&] {
+            auto first_index = submeshes.empty() ? 0 : submeshes.back().first_index + submeshes.back().index_count;
+            submeshes.push_back({
+                .first_index = first_index,
+                .index_count = to_u32(split_indices.size() - first_index),
+                .vertex_offset = static_cast<int32_t>(split_vertices.size() - used.size())
+            });
+            for (auto vertex : used) remap[vertex] = unassigned;
+            used.clear();
+        };
+
+        for (std::size_t triangle = 0; triangle + 2 < indices.size(); triangle += 3) {
+
+            auto corners = std::span(indices).subspan(triangle, 3);
+
+            auto added = std::size_t(0);
+            for (std::size_t i = 0; i < 3; ++i)
+                if (remap[corners[i]] == unassigned && std::find(corners.begin(), corners.begin() + i, corners[i]) == corners.begin() + i)
+                    ++added;
+
+            if (used.size() + added > max_vertices) close_submesh();
+
+            for (auto vertex : corners) {
+                if (remap[vertex] == unassigned) {
+                    remap[vertex] = to_u32(used.size());
+                    used.push_back(vertex);
+                    split_vertices.push_back(vertices[vertex]);
                 }
-            };
+                split_indices.push_back(remap[vertex]);
+            }
+
+        }
+
+        if (!used.empty()) close_submesh();
+
+        logi("Split mesh with {} vertices into {} submeshes, {} vertices after duplication",
+            vertices.size(), submeshes.size(), split_vertices.size());
+
+        vertices = std::move(split_vertices);
+        indices = std::move(split_indices);
+
+        if (vertices.size() > std::numeric_limits<uint32_t>::max())
+            loge("Mesh has {} vertices, more than 32 bit vertex offsets can address", vertices.size());
+
+    }
+
+    std::vector<Lod> append_lods (std::span<const Vertex> vertices, std::vector<uint32_t>& indices, std::vector<Submesh>& submeshes) {
+
+        SCOPED_PERF_LOG;
 
-            if (!unique_vertices.contains(vertex)) {
-                unique_vertices[vertex] = vertices.size();
-                vertices.push_back(vertex);
-            } 
-            
-            indices.push_back(unique_vertices.at(vertex));
+        // Levels that keep more than this share of the triangles before them aren't worth a switch
+        constexpr auto stalled = 0.85;
+        constexpr std::size_t min_triangles = 32;
+
+        auto lods = std::vector { Lod { .first_submesh = 0, .submesh_count = to_u32(submeshes.size()), .error = 0 } };
+        auto full_detail = lods.front();
+
+        // Submeshes of a split mesh own consecutive vertex ranges
+        auto get_vertex_count = [&] (uint32_t submesh) {
+            auto end = submesh + 1 < full_detail.submesh_count ? submeshes[submesh + 1].vertex_offset : vertices.size();
+            return end - submeshes[submesh].vertex_offset;
+        };
+
+        while (lods.size() < max_lod_count) {
+
+            auto previous = lods.back();
+            auto level = Lod { .first_submesh = to_u32(submeshes.size()), .submesh_count = previous.submesh_count, .error = previous.error };
+
+            auto first_index = indices.size();
+            auto previous_triangles = std::size_t(0), triangles = std::size_t(0);
+
+            for (uint32_t i = 0; i < previous.submesh_count; ++i) {
+
+                auto submesh = submeshes[previous.first_submesh + i];
+                auto submesh_vertices = vertices.subspan(submesh.vertex_offset, get_vertex_count(i));
+
+                // Each level simplifies the one before, its error adds to theirs
+                auto source = std::span(indices).subspan(submesh.first_index, submesh.index_count);
+                auto simplified = simplify_mesh(submesh_vertices, source, source.size() / 6 * 3);
+
+                optimize_vertex_cache(simplified.indices, submesh_vertices.size());
+
+                level.error = std::max(level.error, previous.error + simplified.error);
+                previous_triangles += submesh.index_count / 3;
+                triangles += simplified.indices.size() / 3;
+
+                submeshes.push_back({ to_u32(indices.size()), to_u32(simplified.indices.size()), submesh.vertex_offset });
+                indices.insert(indices.end(), simplified.indices.begin(), simplified.indices.end());
+
+            }
+
+            if (!triangles || triangles > previous_triangles * stalled) {
+                submeshes.resize(level.first_submesh);
+                indices.resize(first_index);
+                break;
+            }
+
+            lods.push_back(level);
+
+            if (triangles < min_triangles) break;
 
         }
 
-        update_buffers();
+        if (lods.size() > 1)
+            logi("Generated {} levels of detail down to {} triangles with an error of {:.5f}", lods.size(),
+                std::accumulate(submeshes.end() - lods.back().submesh_count, submeshes.end(), std::size_t(0),
+                    [] (std::size_t sum, const Submesh& submesh) { return sum + submesh.index_count / 3; }), lods.back().error);
+
+        return lods;
+
+    }
+
+    uint32_t LodSelector::select (std::span<const Lod> lods, float scale, float distance, uint32_t current) const {
+
+        if (pixels_per_unit <= 0 || lods.size() < 2) return 0;
+
+        auto last = to_u32(lods.size() - 1);
+        auto projected = [&] (uint32_t level) { return lods[level].error * scale * pixels_per_unit / distance; };
+
+        current = std::min(current, last);
+
+        while (current < last && projected(current + 1) <= threshold * (1 - hysteresis)) ++current;
+        while (current > 0 && projected(current) > threshold * (1 + hysteresis)) --current;
+
+        return current;
+
+    }
+
+    void Model::generate_lods ( ) {
+
+        lods = append_lods(vertices, indices, submeshes);
+
+    }
+
+    std::span<const uint32_t> Model::get_indices ( ) const {
+
+        if (indices.empty() && !packed_indices.empty()) indices = unpack_indices(packed_indices, index_type);
+
+        return indices;
+
+    }
+
+    std::size_t Model::get_triangle_count (std::size_t lod) const {
+
+        auto level = get_submeshes(lod);
+
+        return std::accumulate(level.begin(), level.end(), std::size_t(0),
+            [] (std::size_t sum, const Submesh& submesh) { return sum + submesh.index_count / 3; });
+
+    }
+
+    void Model::build_meshlets ( ) {
+
+        if (!meshlets.empty()) return;
+
+        for (const auto& submesh : get_submeshes()) {
+
+            auto absolute = std::vector<uint32_t>();
+            absolute.reserve(submesh.index_count);
+
+            for (auto index : get_indices().subspan(submesh.first_index, submesh.index_count))
+                absolute.push_back(index + submesh.vertex_offset);
+
+            engine::build_meshlets(vertices, absolute, meshlets, meshlet_indices);
+
+        }
+
+        logi("Built {} meshlets from {} triangles, {:.1f} triangles per meshlet", meshlets.size(), get_triangle_count(),
+            meshlets.empty() ? 0.0 : double(get_triangle_count()) / meshlets.size());
+
+    }
+
+    glm::vec4 Model::get_bounding_sphere ( ) const {
+
+        return glm::vec4((bounds.minimum + bounds.maximum) * .5f, glm::distance(bounds.minimum, bounds.maximum) * .5f);
 
     }
 
     void Model::update_buffers ( ) {
 
-        vertex_buffer = std::make_unique<Buffer>(vertices.size() * sizeof(Vertex), vk::BufferUsageFlagBits::eVertexBuffer, false, true);
-        vertex_buffer->write(vertices.data());
+        upload(encode_vertices(vertices, layout, bounds), pack_indices(indices, index_type));
+
+    }
+
+    void Model::upload (std::span<const std::byte> vertex_data, std::span<const std::byte> index_data) {
+
+        auto index_size = get_index_size(index_type);
+
+        vertex_buffer = std::make_unique<Buffer>(vertex_data.size(), vk::BufferUsageFlagBits::eVertexBuffer, false, true);
+        vertex_buffer->write(vertex_data.data());
+
+        index_buffer = std::make_unique<Buffer>(index_data.size(), vk::BufferUsageFlagBits::eIndexBuffer, false, true);
+        index_buffer->write(index_data.data());
+
+        perf_statistics["Vertex buffer bytes"] += vertex_data.size();
+        perf_statistics["Vertex bytes saved by layout"] += vertices.size() * sizeof(Vertex) - vertex_data.size();
+        auto index_count = get_indices_count();
+
+        perf_statistics["Index buffer bytes"] += index_count * index_size;
+        perf_statistics["Index bytes saved by 16 bit"] += index_count * (sizeof(uint32_t) - index_size);
+
+        logi("Model uses {} {} vertices ({} KiB) and {} bit indices ({} KiB) in {} submeshes and {} levels of detail", vertices.size(),
+            to_string(layout), vertex_data.size() / 1024, index_size * 8, index_count * index_size / 1024, get_submeshes().size(), lods.size());
+
+    }
+
+    void Model::bind (const vk::CommandBuffer& commands) const {
+
+        auto offset = vk::DeviceSize(0);
+
+        commands.bindVertexBuffers(0, 1, &vertex_buffer->get_handle(), &offset);
+        commands.bindIndexBuffer(index_buffer->get_handle(), 0, index_type);
+
+    }
+
+    void Model::draw (const vk::CommandBuffer& commands, uint32_t instance_count, uint32_t first_instance, uint32_t lod) const {
 
-        index_buffer = std::make_unique<Buffer>(indices.size() * sizeof(index_type), vk::BufferUsageFlagBits::eIndexBuffer, false, true);
-        index_buffer->write(indices.data());
+        for (const auto& submesh : get_submeshes(lod))
+            commands.drawIndexed(submesh.index_count, instance_count, submesh.first_index, submesh.vertex_offset, first_instance);
 
     }
 
-}
\ No newline at end of file
+}
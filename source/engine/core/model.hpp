@@ -1,37 +1,137 @@
 #pragma once
 
+#include <filesystem>
+#include <limits>
 #include <span>
 #include <memory>
 #include <string_view>
 
 #include "memory.hpp"
+#include "meshlet.hpp"
+#include "vertex_layout.hpp"
 
 #include "../utils/primitives.hpp"
 
 
 namespace engine {
 
-    class Model {
+    // Range of the index buffer drawn with its own vertex offset, meshes only have several
+    // when their vertex count exceeds what the device can index in one draw
+    struct Submesh {
+        uint32_t first_index;
+        uint32_t index_count;
+        int32_t vertex_offset;
+    };
+
+    // A level of detail is a run of submeshes drawing a simplified index range over the shared vertices
+    struct Lod {
+        uint32_t first_submesh;
+        uint32_t submesh_count;
+        float error; // in model units, how far the level may deviate from the full detail mesh
+    };
+
+    constexpr std::size_t max_lod_count = 8;
+
+    // Picks the coarsest level whose error covers at most threshold pixels on screen. A level only changes once
+    // the error is past the threshold by the hysteresis fraction, so objects near a switching distance don't pop
+    struct LodSelector {
+
+        float pixels_per_unit = 0; // at a distance of one, 0 keeps everything at full detail
+        float threshold = 1;       // pixels
+        float hysteresis = .25f;
 
-        using index_type = uint16_t;
+        uint32_t select (std::span<const Lod> lods, float scale, float distance, uint32_t current) const;
+
+    };
+
+    // 16 bit indices halve index bandwidth and memory whenever the vertex count allows them
+    constexpr vk::IndexType pick_index_type (std::size_t vertex_count) {
+        return vertex_count <= std::size_t(std::numeric_limits<uint16_t>::max()) + 1 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+    }
+
+    constexpr uint32_t get_index_size (vk::IndexType index_type) {
+        return index_type == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    // Index data as laid out in an index buffer of the given type, and back
+    std::vector<std::byte> pack_indices (std::span<const uint32_t> indices, vk::IndexType index_type);
+    std::vector<uint32_t> unpack_indices (std::span<const std::byte> index_data, vk::IndexType index_type);
+
+    // Appends simplified copies of the submeshes, every level halving the triangles of the one before until
+    // simplification stalls. Returns the LOD table whose first level is the submeshes passed in
+    std::vector<Lod> append_lods (std::span<const Vertex> vertices, std::vector<uint32_t>& indices, std::vector<Submesh>& submeshes);
+
+    class Model {
 
         std::vector<Vertex> vertices;
-        std::vector<index_type> indices;
+
+        // Models loaded from a mesh cache keep their indices as they were mapped, in the width of the index buffer,
+        // and only widen them the first time something asks for them
+        mutable std::vector<uint32_t> indices;
+        std::vector<std::byte> packed_indices;
+        std::vector<Submesh> submeshes;
+        std::vector<Lod> lods;
+
+        std::vector<Meshlet> meshlets;
+        std::vector<uint32_t> meshlet_indices;
+
+        vk::IndexType index_type = vk::IndexType::eUint16;
+
+        VertexLayout layout = VertexLayout::full;
+        VertexBounds bounds;
+        glm::mat4x4 dequantization = glm::mat4x4(1.f);
 
         std::unique_ptr<Buffer> vertex_buffer;
         std::unique_ptr<Buffer> index_buffer;
 
+        void select_layout (VertexLayout requested);
+        void select_index_type ( );
+        void split (std::size_t max_vertices);
+        void generate_lods ( );
         void update_buffers ( );
+        void upload (std::span<const std::byte> vertex_data, std::span<const std::byte> index_data);
+
+        bool load_cache (const std::filesystem::path& path, VertexLayout requested);
 
         public:
 
-        Model (std::span<Vertex> vertices, std::span<index_type> indices);
-        Model (std::string_view path);
+        Model (std::span<const Vertex> vertices, std::span<const uint32_t> indices, VertexLayout layout = VertexLayout::automatic);
+        Model (std::string_view path, VertexLayout layout = VertexLayout::automatic);
 
         constexpr const vk::Buffer& get_vertex ( ) const { return vertex_buffer->get_handle(); }
         constexpr const vk::Buffer& get_index ( ) const { return index_buffer->get_handle(); }
-        constexpr const std::size_t get_indices_count ( ) const { return indices.size(); }
+        constexpr const std::size_t get_indices_count ( ) const {
+            return packed_indices.empty() ? indices.size() : packed_indices.size() / get_index_size(index_type);
+        }
+        constexpr vk::IndexType get_index_type ( ) const { return index_type; }
+        constexpr VertexLayout get_layout ( ) const { return layout; }
+
+        // Has to be applied after the model matrix, see get_dequantization in vertex_layout.hpp
+        constexpr const glm::mat4x4& get_dequantization ( ) const { return dequantization; }
+
+        // Indices of every level are relative to the vertex offset of the submesh they belong to
+        constexpr std::span<const Vertex> get_vertices ( ) const { return vertices; }
+        std::span<const uint32_t> get_indices ( ) const;
+        constexpr std::span<const Lod> get_lods ( ) const { return lods; }
+
+        constexpr std::span<const Submesh> get_submeshes (std::size_t lod = 0) const {
+            return std::span(submeshes).subspan(lods.at(lod).first_submesh, lods.at(lod).submesh_count);
+        }
+
+        std::size_t get_triangle_count (std::size_t lod = 0) const;
+
+        // Meshlets are only built on request, they cover the full detail level. Their indices address the whole
+        // vertex buffer with submesh vertex offsets already applied
+        void build_meshlets ( );
+        constexpr std::span<const Meshlet> get_meshlets ( ) const { return meshlets; }
+        constexpr std::span<const uint32_t> get_meshlet_indices ( ) const { return meshlet_indices; }
+
+        // Sphere around the bounds of the model, xyz is the center
+        glm::vec4 get_bounding_sphere ( ) const;
+
+        void bind (const vk::CommandBuffer& commands) const;
+        void draw (const vk::CommandBuffer& commands, uint32_t instance_count = 1, uint32_t first_instance = 0, uint32_t lod = 0) const;
 
     };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <execution>
+#include <limits>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "obj_loader.hpp"
+
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    namespace {
+
+        constexpr auto missing = std::numeric_limits<int32_t>::min();
+        constexpr std::size_t min_chunk_size = 1 << 16;
+
+        struct ObjCorner {
+            int32_t position;
+            int32_t texture_coordinates;
+        };
+
+        // Negative OBJ indices count back from the data read so far, chunks resolve them against their own
+        // arrays and remember which corners still need the offset of all preceding chunks
+        struct ObjChunk {
+            const char* begin;
+            const char* end;
+            std::vector<glm::vec3> positions;
+            std::vector<glm::vec2> texture_coordinates;
+            std::vector<ObjCorner> corners;
+            std::vector<std::size_t> relative_positions;
+            std::vector<std::size_t> relative_texture_coordinates;
+        };
+
+        const char* skip_spaces (const char* begin, const char* end) {
+
+            while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '\r')) ++begin;
+            return begin;
+
+        }
+
+        const char* parse_float (const char* begin, const char* end, float& value) {
+
+            begin = skip_spaces(begin, end);
+            if (begin < end && *begin == '+') ++begin;
+
+            auto [next, error] = std::from_chars(begin, end, value);
+            if (error != std::errc()) value = 0;
+
+            return next;
+
+        }
+
+        const char* parse_index (const char* begin, const char* end, int32_t& value) {
+
+            auto [next, error] = std::from_chars(begin, end, value);
+            if (error != std::errc() || value == 0) value = missing;
+
+            return next;
+
+        }
+
+        // Turns a one based or negative OBJ index into a zero based one, relative to the chunk for negative values
+        int32_t resolve (int32_t index, std::size_t count, std::vector<std::size_t>& relative, std::size_t corner) {
+
+            if (index == missing) return missing;
+            if (index > 0) return index - 1;
+
+            relative.push_back(corner);
+            return static_cast<int32_t>(count) + index;
+
+        }
+
+        void parse_face (ObjChunk& chunk, const char* begin, const char* end, std::vector<ObjCorner>& polygon) {
+
+            polygon.clear();
+
+            while ((begin = skip_spaces(begin, end)) < end) {
+
+                auto corner = ObjCorner { missing, missing };
+                auto normal = int32_t();
+
+                begin = parse_index(begin, end, corner.position);
+                if (begin < end && *begin == '/') {
+                    if (++begin < end && *begin != '/') begin = parse_index(begin, end, corner.texture_coordinates);
+                    if (begin < end && *begin == '/') begin = parse_index(begin + 1, end, normal);
+                }
+
+                // Skip whatever could not be parsed instead of looping on it
+                while (begin < end && *begin != ' ' && *begin != '\t') ++begin;
+
+                polygon.push_back(corner);
+
+            }
+
+            for (std::size_t i = 1; i + 1 < polygon.size(); ++i) for (auto index : { std::size_t(0), i, i + 1 }) {
+
+                auto corner = chunk.corners.size();
+
+                chunk.corners.push_back({
+                    resolve(polygon[index].position, chunk.positions.size(), chunk.relative_positions, corner),
+                    resolve(polygon[index].texture_coordinates, chunk.texture_coordinates.size(), chunk.relative_texture_coordinates, corner)
+                });
+
+            }
+
+        }
+
+        void parse_chunk (ObjChunk& chunk) {
+
+            auto polygon = std::vector<ObjCorner>();
+
+            for (auto line = chunk.begin; line < chunk.end; ) {
+
+                auto line_end = static_cast<const char*>(std::memchr(line, '\n', chunk.end - line));
+                if (!line_end) line_end = chunk.end;
+
+                auto begin = skip_spaces(line, line_end);
+                auto keyword_end = begin;
+                while (keyword_end < line_end && *keyword_end != ' ' && *keyword_end != '\t') ++keyword_end;
+
+                auto keyword = std::string_view(begin, keyword_end);
+
+                if (keyword == "v") {
+                    auto& position = chunk.positions.emplace_back();
+                    auto next = parse_float(keyword_end, line_end, position.x);
+                    next = parse_float(next, line_end, position.y);
+                    parse_float(next, line_end, position.z);
+                }
+                else if (keyword == "vt") {
+                    auto& coordinates = chunk.texture_coordinates.emplace_back();
+                    auto next = parse_float(keyword_end, line_end, coordinates.x);
+                    parse_float(next, line_end, coordinates.y);
+                }
+                else if (keyword == "f") parse_face(chunk, keyword_end, line_end, polygon);
+
+                line = line_end + 1;
+
+            }
+
+        }
+
+    }
+
+    VertexWelder::VertexWelder (std::vector<Vertex>& vertices, std::size_t expected_count) : vertices(vertices) {
+
+        rehash(std::bit_ceil(std::max<std::size_t>((std::max(expected_count, vertices.size()) + 1) * 2, 16)));
+
+    }
+
+    void VertexWelder::rehash (std::size_t capacity) {
+
+        slots.assign(capacity, empty);
+
+        for (uint32_t i = 0; i < vertices.size(); ++i) {
+            auto slot = std::hash<Vertex>{}(vertices[i]) & (slots.size() - 1);
+            while (slots[slot] != empty) slot = (slot + 1) & (slots.size() - 1);
+            slots[slot] = i;
+        }
+
+    }
+
+    uint32_t VertexWelder::weld (const Vertex& vertex) {
+
+        // Keep the load factor at or below one half so probe sequences stay short
+        if ((vertices.size() + 1) * 2 > slots.size()) rehash(slots.size() * 2);
+
+        auto mask = slots.size() - 1;
+
+        for (auto slot = std::hash<Vertex>{}(vertex) & mask; ; slot = (slot + 1) & mask) {
+
+            auto& entry = slots[slot];
+
+            if (entry == empty) {
+                entry = static_cast<uint32_t>(vertices.size());
+                vertices.push_back(vertex);
+                return entry;
+            }
+
+            if (vertices[entry] == vertex) return entry;
+
+        }
+
+    }
+
+    ObjMesh load_obj (const std::filesystem::path& path) {
+
+        SCOPED_PERF_LOG;
+
+        using hrc = std::chrono::high_resolution_clock;
+
+        auto mesh = ObjMesh();
+        auto start = hrc::now();
+
+        auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0) {
+            loge("Failed to open model {}", path.string());
+            return mesh;
+        }
+
+        struct stat status;
+        auto size = fstat(fd, &status) == 0 ? static_cast<std::size_t>(status.st_size) : 0;
+        auto data = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+
+        ::close(fd);
+
+        if (data == MAP_FAILED) {
+            loge("Failed to map model {}", path.string());
+            return mesh;
+        }
+
+        madvise(data, size, MADV_SEQUENTIAL);
+
+        auto text = static_cast<const char*>(data);
+        auto end = text + size;
+
+        // One chunk per hardware thread, each ends on a line break so no line is split
+        auto chunk_count = std::clamp<std::size_t>(size / min_chunk_size, 1, std::max(1u, std::thread::hardware_concurrency()));
+        auto chunks = std::vector<ObjChunk>(chunk_count);
+
+        for (std::size_t i = 0, offset = 0; i < chunk_count; ++i) {
+
+            auto chunk_end = i + 1 == chunk_count ? end : text + std::max(offset, size / chunk_count * (i + 1));
+            while (chunk_end < end && *chunk_end != '\n') ++chunk_end;
+            if (chunk_end < end) ++chunk_end;
+
+            chunks[i].begin = text + offset;
+            chunks[i].end = chunk_end;
+            offset = chunk_end - text;
+
+        }
+
+        std::for_each(std::execution::par, chunks.begin(), chunks.end(), parse_chunk);
+
+        munmap(data, size);
+
+        // Stitch chunks together, indices of later chunks only need offsets for their relative corners
+        auto positions = std::vector<glm::vec3>();
+        auto texture_coordinates = std::vector<glm::vec2>();
+        auto corners = std::vector<ObjCorner>();
+
+        for (auto& chunk : chunks) {
+
+            for (auto corner : chunk.relative_positions)
+                chunk.corners[corner].position += static_cast<int32_t>(positions.size());
+            for (auto corner : chunk.relative_texture_coordinates)
+                chunk.corners[corner].texture_coordinates += static_cast<int32_t>(texture_coordinates.size());
+
+            positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+            texture_coordinates.insert(texture_coordinates.end(), chunk.texture_coordinates.begin(), chunk.texture_coordinates.end());
+            corners.insert(corners.end(), chunk.corners.begin(), chunk.corners.end());
+
+        }
+
+        chunks.clear();
+
+        auto welding = hrc::now();
+
+        // Each position usually appears with a handful of texture coordinates, a fair guess to size the table
+        auto welder = VertexWelder(mesh.vertices, std::max(positions.size(), texture_coordinates.size()));
+        auto skipped = std::size_t(0);
+
+        mesh.indices.reserve(corners.size());
+
+        for (std::size_t triangle = 0; triangle + 2 < corners.size(); triangle += 3) {
+
+            auto valid = std::all_of(corners.begin() + triangle, corners.begin() + triangle + 3, [&] (const ObjCorner& corner) {
+                auto texture_valid = corner.texture_coordinates == missing
+                    || (corner.texture_coordinates >= 0 && static_cast<std::size_t>(corner.texture_coordinates) < texture_coordinates.size());
+                return corner.position >= 0 && static_cast<std::size_t>(corner.position) < positions.size() && texture_valid;
+            });
+
+            if (!valid) {
+                ++skipped;
+                continue;
+            }
+
+            for (std::size_t i = triangle; i < triangle + 3; ++i) {
+
+                auto coordinates = corners[i].texture_coordinates == missing ? glm::vec2(0.f) : texture_coordinates[corners[i].texture_coordinates];
+
+                mesh.indices.push_back(welder.weld({
+                    .position = positions[corners[i].position],
+                    .color = {1.f, 1.f, 1.f},
+                    .texture_coordinates = {coordinates.x, 1.f - coordinates.y}
+                }));
+
+            }
+
+        }
+
+        if (skipped) loge("Skipped {} triangles of {} referencing missing vertex data", skipped, path.string());
+
+        auto finished = hrc::now();
+
+        mesh.statistics = {
+            .bytes = size,
+            .triangles = mesh.indices.size() / 3,
+            .corners = corners.size(),
+            .vertices = mesh.vertices.size(),
+            .parse_time = std::chrono::duration<double, std::milli>(welding - start).count(),
+            .weld_time = std::chrono::duration<double, std::milli>(finished - welding).count()
+        };
+
+        logi("Loaded {} with {} triangles and {} vertices in {:.3f}ms", path.string(), mesh.statistics.triangles,
+            mesh.statistics.vertices, mesh.statistics.parse_time + mesh.statistics.weld_time);
+
+        return mesh;
+
+    }
+
+}
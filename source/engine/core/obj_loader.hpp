@@ -0,0 +1,48 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include "../utils/primitives.hpp"
+
+namespace engine {
+
+    struct ObjStatistics {
+        std::size_t bytes = 0;
+        std::size_t triangles = 0;
+        std::size_t corners = 0;
+        std::size_t vertices = 0;
+        double parse_time = 0; // milliseconds, reading and parsing the file
+        double weld_time = 0;  // milliseconds, merging identical corners
+    };
+
+    struct ObjMesh {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        ObjStatistics statistics;
+    };
+
+    // Wavefront OBJ reader for positions and texture coordinates. The mapped file is split at line boundaries
+    // into chunks parsed in parallel, polygons are fan triangulated and identical vertices welded afterwards
+    ObjMesh load_obj (const std::filesystem::path& path);
+
+    // Open addressing table from vertex to its index, linear probing over a power of two capacity
+    class VertexWelder {
+
+        static constexpr uint32_t empty = ~0u;
+
+        std::vector<uint32_t> slots;
+        std::vector<Vertex>& vertices;
+
+        void rehash (std::size_t capacity);
+
+        public:
+
+        VertexWelder (std::vector<Vertex>& vertices, std::size_t expected_count);
+
+        // Returns the index of an equal vertex, appending the vertex if there is none yet
+        uint32_t weld (const Vertex& vertex);
+
+    };
+
+}
@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
 #include "pipeline.hpp"
 
 #include "device.hpp"
@@ -91,13 +96,19 @@ namespace engine {
 
         auto device = Device::get();
 
-        auto binding_description = create_info.binding_description;
+        auto binding_descriptions = std::vector { create_info.binding_description };
         auto attribute_descriptions = create_info.attribute_descriptions; 
 
+        if (create_info.instance_binding_description) {
+            binding_descriptions.push_back(*create_info.instance_binding_description);
+            attribute_descriptions.insert(attribute_descriptions.end(),
+                create_info.instance_attribute_descriptions.begin(), create_info.instance_attribute_descriptions.end());
+        }
+
         auto vertex_input_info = vk::PipelineVertexInputStateCreateInfo {
             .flags = vk::PipelineVertexInputStateCreateFlags(),
-            .vertexBindingDescriptionCount = 1,
-            .pVertexBindingDescriptions = &binding_description,
+            .vertexBindingDescriptionCount = to_u32(binding_descriptions.size()),
+            .pVertexBindingDescriptions = binding_descriptions.data(),
             .vertexAttributeDescriptionCount = to_u32(attribute_descriptions.size()),
             .pVertexAttributeDescriptions = attribute_descriptions.data()
         };
@@ -121,7 +132,8 @@ namespace engine {
         auto color_blend_info = vk::PipelineColorBlendStateCreateInfo {
             .flags = vk::PipelineColorBlendStateCreateFlags(),
             .attachmentCount = 1,
-            .pAttachments = &create_info.color_blend_attachment
+            .pAttachments = &create_info.color_blend_attachment,
+            .blendConstants = create_info.blend_constants
         };
 
         auto color_attachment_format = device->get_format().format;
@@ -131,9 +143,15 @@ namespace engine {
             .depthAttachmentFormat = Image::get_depth_format()
         };
 
-        auto shader = Shader(create_info.shader_path);
+        auto shader = Shader(create_info.shader_path, create_info.specialization);
         auto stages = shader.get_stage_info(); 
 
+        for (const auto& input : shader.get_reflection().vertex_inputs) {
+            auto location = std::ranges::find(attribute_descriptions, input.location, &vk::VertexInputAttributeDescription::location);
+            if (location == attribute_descriptions.end())
+                throw std::runtime_error(fmt::format("{} reads vertex input {} which is not provided", create_info.shader_path, input.location));
+        }
+
         auto pipeline_create_info = vk::GraphicsPipelineCreateInfo {
             .pNext = create_info.render_pass ? nullptr : &rendering_info,
             .flags = vk::PipelineCreateFlags(),
@@ -156,8 +174,10 @@ namespace engine {
         };
 
         try {
-            auto result = device->get_handle().createGraphicsPipeline(nullptr, pipeline_create_info);
-            logi("Successfully created Graphics PipeLine");
+            auto start = std::chrono::high_resolution_clock::now();
+            auto result = device->get_handle().createGraphicsPipeline(device->get_pipeline_cache(), pipeline_create_info);
+            auto duration = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start);
+            logi("Successfully created Graphics PipeLine {} in {:.3f}ms", create_info.shader_path, duration.count());
             return result.value;
         } catch (vk::SystemError err) {
             loge("Failed to create Graphics Pipeline");
@@ -166,9 +186,9 @@ namespace engine {
 
     }
 
-    vk::Pipeline create_compute_pipeline (const vk::PipelineLayout& layout, std::string shader_path) {
+    vk::Pipeline create_compute_pipeline (const vk::PipelineLayout& layout, std::string shader_path, const Specialization& specialization) {
 
-        auto shader = Shader(shader_path);
+        auto shader = Shader(shader_path, specialization);
         auto stages = shader.get_stage_info();
 
         auto create_info = vk::ComputePipelineCreateInfo {
@@ -177,17 +197,98 @@ namespace engine {
             .layout = layout
         };
         
+        auto device = Device::get();
+        
         try {
-            auto result = Device::get()->get_handle().createComputePipeline(nullptr, create_info);
-            logi("Successfully created Graphics PipeLine");
+            auto start = std::chrono::high_resolution_clock::now();
+            auto result = device->get_handle().createComputePipeline(device->get_pipeline_cache(), create_info);
+            auto duration = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start);
+            logi("Successfully created Compute PipeLine {} in {:.3f}ms", shader_path, duration.count());
             return result.value;
         } catch (vk::SystemError err) {
-            loge("Failed to create Graphics Pipeline");
+            loge("Failed to create Compute Pipeline");
             return nullptr;
         }
         
     }
 
+    PipelineHandle::PipelineHandle (std::function<vk::Pipeline()> build) : build(build) {
+
+        future = std::async(std::launch::async, build).share();
+
+    }
+
+    PipelineHandle::~PipelineHandle ( ) {
+
+        for (auto& result : { future, pending }) {
+
+            if (!result.valid()) continue;
+
+            try {
+                if (auto pipeline = result.get()) Device::get()->get_handle().destroyPipeline(pipeline);
+            } catch (std::exception& error) {
+                loge("Pipeline build has failed: {}", error.what());
+            }
+
+        }
+
+    }
+
+    void PipelineHandle::rebuild ( ) {
+
+        // A previous rebuild that was never swapped in is not referenced by any command buffer yet
+        if (pending.valid()) try {
+            if (auto pipeline = pending.get()) Device::get()->get_handle().destroyPipeline(pipeline);
+        } catch (std::exception&) { }
+
+        pending = std::async(std::launch::async, build).share();
+
+    }
+
+    bool PipelineHandle::is_rebuilt ( ) const {
+
+        return pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+
+    }
+
+    vk::Pipeline PipelineHandle::swap ( ) {
+
+        if (!pending.valid()) return nullptr;
+
+        auto result = std::exchange(pending, { });
+
+        try {
+            if (!result.get()) return nullptr;
+        } catch (std::exception& error) {
+            loge("Pipeline rebuild has failed, keeping the previous one: {}", error.what());
+            return nullptr;
+        }
+
+        auto previous = std::exchange(future, result);
+
+        try {
+            return previous.get();
+        } catch (std::exception&) {
+            return nullptr;
+        }
+
+    }
+
+    std::unique_ptr<PipelineHandle> create_pipeline_async (const PipeLineCreateInfo& create_info) {
+
+        return std::make_unique<PipelineHandle>([create_info] { return create_pipeline(create_info); });
+
+    }
+
+    std::unique_ptr<PipelineHandle> create_compute_pipeline_async (const vk::PipelineLayout& layout, std::string shader_path,
+        const Specialization& specialization) {
+
+        return std::make_unique<PipelineHandle>([layout, shader_path, specialization] {
+            return create_compute_pipeline(layout, shader_path, specialization);
+        });
+
+    }
+
     vk::RenderPass create_render_pass ( ) {
 
         auto device = Device::get();
@@ -292,59 +393,4 @@ namespace engine {
 
     }
 
-    vk::PipelineLayout create_pipeline_layout (const vk::DescriptorSetLayout* layout, vk::PushConstantRange* range) {
-
-        auto create_info = vk::PipelineLayoutCreateInfo {
-            .flags = vk::PipelineLayoutCreateFlags()
-        };
-
-        if (layout != nullptr) {
-            create_info.setLayoutCount = 1;
-            create_info.pSetLayouts = layout;
-        }
-
-        if (range != nullptr) {
-            create_info.pushConstantRangeCount = 1;
-            create_info.pPushConstantRanges = range;
-        }
-
-        try {
-            auto result = Device::get()->get_handle().createPipelineLayout(create_info);
-            logi("Created PipeLine Layout");
-            return result;
-        } catch (vk::SystemError) {
-            loge("Failed to create PipeLine Layout");
-            return nullptr;
-        }
-
-    }
-
-    vk::DescriptorSetLayout create_descriptor_set_layout ( ) {
-
-        auto bindings = std::array {
-            vk::DescriptorSetLayoutBinding {
-                .binding = 0,
-                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-                .descriptorCount = 1,
-                .stageFlags = vk::ShaderStageFlagBits::eFragment,
-            }
-        };
-
-        auto create_info = vk::DescriptorSetLayoutCreateInfo {
-            .flags = vk::DescriptorSetLayoutCreateFlags(),
-            .bindingCount = to_u32(bindings.size()),
-            .pBindings = bindings.data()
-        };
-
-        try {
-            auto result = Device::get()->get_handle().createDescriptorSetLayout(create_info);
-            logi("Created DescriptorSet Pipeline layout");
-            return result;
-        } catch (vk::SystemError error) {
-            loge("Failed to create DescriptorSet Pipeline layout");
-            return nullptr;
-        }
-
-    }
-
 }
\ No newline at end of file
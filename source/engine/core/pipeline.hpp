@@ -1,6 +1,10 @@
 #pragma once
 
+#include <array>
+#include <functional>
+#include <future>
 #include <memory>
+#include <optional>
 #include <vector>
 
 #include "device.hpp"
@@ -10,8 +14,6 @@
 
 namespace engine {
 
-    vk::PipelineLayout create_pipeline_layout (const vk::DescriptorSetLayout* layout = nullptr, vk::PushConstantRange* range = nullptr);
-
     vk::PipelineInputAssemblyStateCreateInfo create_input_assembly_info (vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList);
     vk::PipelineRasterizationStateCreateInfo create_rasterization_info (vk::CullModeFlags cull_mode = vk::CullModeFlagBits::eBack);
 
@@ -33,21 +35,58 @@ namespace engine {
         const vk::VertexInputBindingDescription binding_description = Vertex::get_binding_description();
         const std::vector<vk::VertexInputAttributeDescription> attribute_descriptions = Vertex::get_attribute_descriptions();
 
+        // Optional second stream that advances per instance, see InstanceData
+        const std::optional<vk::VertexInputBindingDescription> instance_binding_description = std::nullopt;
+        const std::vector<vk::VertexInputAttributeDescription> instance_attribute_descriptions = { };
+
         const vk::PipelineInputAssemblyStateCreateInfo input_assembly_info = create_input_assembly_info();
         const vk::PipelineRasterizationStateCreateInfo rasterization_info = create_rasterization_info();
         const vk::PipelineMultisampleStateCreateInfo multisampling_info = create_multisampling_info();
         const vk::PipelineDepthStencilStateCreateInfo depth_stencil_info = create_depth_stencil_info();
         const vk::PipelineColorBlendAttachmentState color_blend_attachment = create_color_blend_attachment();
+        const std::array<float, 4> blend_constants = { };
 
-        const vk::PipelineLayout& layout; 
-        const vk::RenderPass& render_pass = nullptr;
+        // Handles are held by value, the create info is copied to the worker thread and kept for rebuilds
+        const vk::PipelineLayout layout;
+        const vk::RenderPass render_pass = nullptr; // pipelines without a render pass are built for dynamic rendering
         const std::string shader_path;
+        const Specialization specialization = { };
+
+        bool operator== (const PipeLineCreateInfo&) const = default;
+
+    };
+
+    // Owns a pipeline that is being built on a worker thread, get() blocks until it is ready.
+    // rebuild() starts a replacement in the background which is put in place by swap()
+    class PipelineHandle {
+
+        std::function<vk::Pipeline()> build;
+        std::shared_future<vk::Pipeline> future;
+        std::shared_future<vk::Pipeline> pending;
+
+        public:
+
+        PipelineHandle (std::function<vk::Pipeline()> build);
+        ~PipelineHandle ( );
+
+        PipelineHandle (const PipelineHandle&) = delete;
+        PipelineHandle& operator= (const PipelineHandle&) = delete;
+
+        const vk::Pipeline get ( ) const { return future.get(); }
+        bool is_ready ( ) const { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+
+        void rebuild ( );
+        bool is_rebuilt ( ) const;
+        vk::Pipeline swap ( );
 
     };
 
     vk::RenderPass create_render_pass ( );
     vk::Pipeline create_pipeline (const PipeLineCreateInfo& create_info);
-    vk::Pipeline create_compute_pipeline (const vk::PipelineLayout& layout, std::string shader_path);
-    vk::DescriptorSetLayout create_descriptor_set_layout ( );
+    vk::Pipeline create_compute_pipeline (const vk::PipelineLayout& layout, std::string shader_path, const Specialization& specialization = { });
+
+    std::unique_ptr<PipelineHandle> create_pipeline_async (const PipeLineCreateInfo& create_info);
+    std::unique_ptr<PipelineHandle> create_compute_pipeline_async (const vk::PipelineLayout& layout, std::string shader_path,
+        const Specialization& specialization = { });
 
 }
\ No newline at end of file
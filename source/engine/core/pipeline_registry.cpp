@@ -0,0 +1,145 @@
+#include <vector>
+
+#include "pipeline_registry.hpp"
+
+#include "../utils/utils.hpp"
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    std::size_t PipelineRegistry::hash (const PipeLineCreateInfo& create_info) {
+
+        std::size_t seed = 0;
+
+        const auto& binding = create_info.binding_description;
+        hash_combine(seed, binding.binding, binding.stride, binding.inputRate);
+
+        for (const auto& attribute : create_info.attribute_descriptions)
+            hash_combine(seed, attribute.location, attribute.binding, attribute.format, attribute.offset);
+
+        if (const auto& instance_binding = create_info.instance_binding_description)
+            hash_combine(seed, instance_binding->binding, instance_binding->stride, instance_binding->inputRate);
+
+        for (const auto& attribute : create_info.instance_attribute_descriptions)
+            hash_combine(seed, attribute.location, attribute.binding, attribute.format, attribute.offset);
+
+        const auto& input_assembly = create_info.input_assembly_info;
+        hash_combine(seed, input_assembly.topology, input_assembly.primitiveRestartEnable);
+
+        const auto& rasterization = create_info.rasterization_info;
+        hash_combine(seed, rasterization.depthClampEnable, rasterization.rasterizerDiscardEnable, rasterization.polygonMode,
+            static_cast<VkCullModeFlags>(rasterization.cullMode), rasterization.frontFace, rasterization.depthBiasEnable,
+            rasterization.depthBiasConstantFactor, rasterization.depthBiasClamp, rasterization.depthBiasSlopeFactor, rasterization.lineWidth);
+
+        const auto& multisampling = create_info.multisampling_info;
+        hash_combine(seed, multisampling.rasterizationSamples, multisampling.sampleShadingEnable, multisampling.minSampleShading,
+            multisampling.alphaToCoverageEnable, multisampling.alphaToOneEnable, static_cast<const void*>(multisampling.pSampleMask));
+
+        const auto& depth_stencil = create_info.depth_stencil_info;
+        hash_combine(seed, depth_stencil.depthTestEnable, depth_stencil.depthWriteEnable, depth_stencil.depthCompareOp,
+            depth_stencil.depthBoundsTestEnable, depth_stencil.stencilTestEnable, depth_stencil.minDepthBounds, depth_stencil.maxDepthBounds);
+
+        for (const auto& stencil : { depth_stencil.front, depth_stencil.back })
+            hash_combine(seed, stencil.failOp, stencil.passOp, stencil.depthFailOp, stencil.compareOp,
+                stencil.compareMask, stencil.writeMask, stencil.reference);
+
+        const auto& blend = create_info.color_blend_attachment;
+        hash_combine(seed, blend.blendEnable, blend.srcColorBlendFactor, blend.dstColorBlendFactor, blend.colorBlendOp,
+            blend.srcAlphaBlendFactor, blend.dstAlphaBlendFactor, blend.alphaBlendOp, static_cast<VkColorComponentFlags>(blend.colorWriteMask));
+
+        for (auto constant : create_info.blend_constants) hash_combine(seed, constant);
+
+        hash_combine(seed, static_cast<VkPipelineLayout>(create_info.layout), static_cast<VkRenderPass>(create_info.render_pass));
+        hash_combine(seed, create_info.shader_path, create_info.specialization.hash());
+
+        return seed;
+
+    }
+
+    std::size_t PipelineRegistry::hash (const ComputeKey& key) {
+
+        std::size_t seed = 0;
+        hash_combine(seed, static_cast<VkPipelineLayout>(key.layout), key.shader_path, key.specialization.hash());
+
+        return seed;
+
+    }
+
+    std::shared_ptr<PipelineHandle> PipelineRegistry::acquire (std::size_t hash, Key key,
+        std::function<std::unique_ptr<PipelineHandle>()> create) {
+
+        auto lock = std::scoped_lock(mutex);
+
+        for (auto [entry, end] = pipelines.equal_range(hash); entry != end; ++entry)
+            if (entry->second.key == key)
+                if (auto pipeline = entry->second.handle.lock()) {
+                    hits++; update_statistics();
+                    return pipeline;
+                }
+
+        std::erase_if(pipelines, [] (const auto& entry) { return entry.second.handle.expired(); });
+
+        auto pipeline = std::shared_ptr<PipelineHandle>(create());
+        pipelines.emplace(hash, Entry { std::move(key), pipeline });
+
+        misses++; update_statistics();
+
+        return pipeline;
+
+    }
+
+    std::shared_ptr<PipelineHandle> PipelineRegistry::acquire (const PipeLineCreateInfo& create_info) {
+
+        return acquire(hash(create_info), create_info, [&create_info] { return create_pipeline_async(create_info); });
+
+    }
+
+    std::shared_ptr<PipelineHandle> PipelineRegistry::acquire_compute (const vk::PipelineLayout& layout, std::string shader_path,
+        const Specialization& specialization) {
+
+        auto key = ComputeKey { layout, shader_path, specialization };
+
+        return acquire(hash(key), key, [&] { return create_compute_pipeline_async(layout, shader_path, specialization); });
+
+    }
+
+    void PipelineRegistry::reload (std::string_view shader_path) {
+
+        auto lock = std::scoped_lock(mutex);
+
+        for (auto& [key, entry] : pipelines)
+            if (auto pipeline = entry.handle.lock(); pipeline && entry.get_shader_path() == shader_path) {
+                logi("Rebuilding pipeline for {}", shader_path);
+                pipeline->rebuild();
+            }
+
+    }
+
+    void PipelineRegistry::update ( ) {
+
+        auto lock = std::scoped_lock(mutex);
+        auto rebuilt = std::vector<std::shared_ptr<PipelineHandle>>();
+
+        for (auto& [key, entry] : pipelines)
+            if (auto pipeline = entry.handle.lock(); pipeline && pipeline->is_rebuilt())
+                rebuilt.push_back(pipeline);
+
+        if (rebuilt.empty()) return;
+
+        // Previous pipelines may still be referenced by frames in flight
+        auto device = Device::get();
+        device->get_handle().waitIdle();
+
+        for (auto& pipeline : rebuilt)
+            if (auto previous = pipeline->swap()) device->get_handle().destroyPipeline(previous);
+
+    }
+
+    void PipelineRegistry::update_statistics ( ) {
+
+        perf_statistics["Pipeline registry hits"] = hits;
+        perf_statistics["Pipeline registry misses"] = misses;
+
+    }
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+
+#include "pipeline.hpp"
+
+namespace engine {
+
+    // Shares pipelines between callers that ask for identical state, pipelines are
+    // destroyed once the last handle referencing them goes away
+    class PipelineRegistry {
+
+        struct ComputeKey {
+            vk::PipelineLayout layout;
+            std::string shader_path;
+            Specialization specialization;
+
+            bool operator== (const ComputeKey&) const = default;
+        };
+
+        // Everything a pipeline was made from, compared on lookup so pipelines whose hashes collide aren't shared
+        using Key = std::variant<PipeLineCreateInfo, ComputeKey>;
+
+        struct Entry {
+            Key key;
+            std::weak_ptr<PipelineHandle> handle;
+
+            const std::string& get_shader_path ( ) const {
+                return std::visit([] (const auto& key) -> const std::string& { return key.shader_path; }, key);
+            }
+        };
+
+        static inline std::mutex mutex;
+        static inline std::unordered_multimap<std::size_t, Entry> pipelines;
+
+        static inline std::size_t hits = 0, misses = 0;
+
+        static std::shared_ptr<PipelineHandle> acquire (std::size_t hash, Key key,
+            std::function<std::unique_ptr<PipelineHandle>()> create);
+        static void update_statistics ( );
+
+        static std::size_t hash (const ComputeKey& key);
+
+        public:
+
+        static std::size_t hash (const PipeLineCreateInfo& create_info);
+
+        static std::shared_ptr<PipelineHandle> acquire (const PipeLineCreateInfo& create_info);
+        static std::shared_ptr<PipelineHandle> acquire_compute (const vk::PipelineLayout& layout, std::string shader_path,
+            const Specialization& specialization = { });
+
+        // Rebuilds every pipeline using the shader in the background
+        static void reload (std::string_view shader_path);
+        // Swaps in finished rebuilds, must be called at a frame boundary
+        static void update ( );
+
+    };
+
+}
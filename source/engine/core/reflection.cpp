@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "reflection.hpp"
+
+namespace engine {
+
+    namespace {
+
+        constexpr uint32_t spirv_magic = 0x07230203;
+
+        namespace op {
+            constexpr uint32_t entry_point = 15, execution_mode = 16;
+            constexpr uint32_t type_int = 21, type_float = 22, type_vector = 23, type_matrix = 24, type_image = 25;
+            constexpr uint32_t type_sampler = 26, type_sampled_image = 27, type_array = 28, type_runtime_array = 29;
+            constexpr uint32_t type_struct = 30, type_pointer = 32;
+            constexpr uint32_t constant = 43, spec_constant = 50, variable = 59;
+            constexpr uint32_t decorate = 71, member_decorate = 72;
+        }
+
+        namespace storage {
+            constexpr uint32_t uniform_constant = 0, input = 1, uniform = 2, push_constant = 9, storage_buffer = 12;
+        }
+
+        struct Type {
+            uint32_t opcode;
+            std::vector<uint32_t> operands;
+        };
+
+        struct Decorations {
+            std::optional<uint32_t> set, binding, location, offset, array_stride, matrix_stride;
+            bool block = false, buffer_block = false, builtin = false;
+        };
+
+        void decorate (Decorations& decorations, std::span<const uint32_t> operands) {
+
+            auto value = operands.size() > 1 ? std::optional(operands[1]) : std::nullopt;
+
+            switch (operands[0]) {
+                case 2: decorations.block = true; break;
+                case 3: decorations.buffer_block = true; break;
+                case 6: decorations.array_stride = value; break;
+                case 7: decorations.matrix_stride = value; break;
+                case 11: decorations.builtin = true; break;
+                case 30: decorations.location = value; break;
+                case 33: decorations.binding = value; break;
+                case 34: decorations.set = value; break;
+                case 35: decorations.offset = value; break;
+                default: break;
+            }
+
+        }
+
+        vk::ShaderStageFlagBits to_stage (uint32_t execution_model) {
+
+            using enum vk::ShaderStageFlagBits;
+
+            switch (execution_model) {
+                case 0: return eVertex;
+                case 1: return eTessellationControl;
+                case 2: return eTessellationEvaluation;
+                case 3: return eGeometry;
+                case 4: return eFragment;
+                case 5: return eCompute;
+                default: throw std::runtime_error("Unsupported SPIR-V execution model");
+            }
+
+        }
+
+        vk::Format to_format (const Type& scalar, uint32_t components) {
+
+            using enum vk::Format;
+
+            if (scalar.operands.at(0) != 32) return eUndefined;
+
+            if (scalar.opcode == op::type_float) {
+                constexpr auto formats = std::array { eR32Sfloat, eR32G32Sfloat, eR32G32B32Sfloat, eR32G32B32A32Sfloat };
+                return formats.at(components - 1);
+            }
+
+            if (scalar.operands.at(1)) {
+                constexpr auto formats = std::array { eR32Sint, eR32G32Sint, eR32G32B32Sint, eR32G32B32A32Sint };
+                return formats.at(components - 1);
+            }
+
+            constexpr auto formats = std::array { eR32Uint, eR32G32Uint, eR32G32B32Uint, eR32G32B32A32Uint };
+            return formats.at(components - 1);
+
+        }
+
+    }
+
+    void ShaderReflection::merge (const ShaderReflection& other) {
+
+        stages |= other.stages;
+
+        for (const auto& [set, bindings] : other.descriptor_sets) {
+
+            auto& merged = descriptor_sets[set];
+
+            for (const auto& binding : bindings) {
+
+                auto existing = std::ranges::find(merged, binding.binding, &vk::DescriptorSetLayoutBinding::binding);
+
+                if (existing == merged.end()) { merged.push_back(binding); continue; }
+
+                if (existing->descriptorType != binding.descriptorType || existing->descriptorCount != binding.descriptorCount)
+                    throw std::runtime_error("Shader stages disagree on a descriptor binding");
+
+                existing->stageFlags |= binding.stageFlags;
+
+            }
+
+            std::ranges::sort(merged, { }, &vk::DescriptorSetLayoutBinding::binding);
+
+        }
+
+        if (other.push_constant_range) {
+
+            if (!push_constant_range) push_constant_range = other.push_constant_range;
+            else {
+                push_constant_range->stageFlags |= other.push_constant_range->stageFlags;
+                push_constant_range->size = std::max(push_constant_range->size, other.push_constant_range->size);
+            }
+
+        }
+
+        if (!other.vertex_inputs.empty()) vertex_inputs = other.vertex_inputs;
+        if (other.stages & vk::ShaderStageFlagBits::eCompute) workgroup_size = other.workgroup_size;
+
+    }
+
+    ShaderReflection reflect_spirv (std::span<const uint32_t> code) {
+
+        if (code.size() < 5 || code[0] != spirv_magic)
+            throw std::runtime_error("Invalid SPIR-V module");
+
+        auto reflection = ShaderReflection();
+
+        auto types = std::unordered_map<uint32_t, Type>();
+        auto constants = std::unordered_map<uint32_t, uint32_t>();
+        auto decorations = std::unordered_map<uint32_t, Decorations>();
+        auto member_decorations = std::unordered_map<uint64_t, Decorations>();
+        auto variables = std::vector<std::array<uint32_t, 3>>();
+
+        auto member_key = [] (uint32_t id, uint32_t member) { return static_cast<uint64_t>(id) << 32 | member; };
+
+        for (std::size_t i = 5; i < code.size();) {
+
+            uint32_t word_count = code[i] >> 16;
+            uint32_t opcode = code[i] & 0xFFFF;
+
+            if (!word_count || i + word_count > code.size())
+                throw std::runtime_error("Malformed SPIR-V instruction");
+
+            auto operands = code.subspan(i + 1, word_count - 1);
+
+            switch (opcode) {
+
+                case op::entry_point:
+                    reflection.stages |= to_stage(operands[0]);
+                    break;
+
+                case op::execution_mode:
+                    // LocalSize
+                    if (operands[1] == 17) reflection.workgroup_size = { operands[2], operands[3], operands[4] };
+                    break;
+
+                case op::decorate:
+                    decorate(decorations[operands[0]], operands.subspan(1));
+                    break;
+
+                case op::member_decorate:
+                    decorate(member_decorations[member_key(operands[0], operands[1])], operands.subspan(2));
+                    break;
+
+                case op::type_int: case op::type_float: case op::type_vector: case op::type_matrix:
+                case op::type_image: case op::type_sampler: case op::type_sampled_image: case op::type_array:
+                case op::type_runtime_array: case op::type_struct: case op::type_pointer:
+                    types[operands[0]] = { opcode, { operands.begin() + 1, operands.end() } };
+                    break;
+
+                case op::constant: case op::spec_constant:
+                    constants[operands[1]] = operands[2];
+                    break;
+
+                case op::variable:
+                    variables.push_back({ operands[0], operands[1], operands[2] });
+                    break;
+
+                default: break;
+
+            }
+
+            i += word_count;
+
+        }
+
+        std::function<uint32_t(uint32_t)> size_of = [&] (uint32_t id) -> uint32_t {
+
+            const auto& type = types.at(id);
+
+            switch (type.opcode) {
+
+                case op::type_int: case op::type_float:
+                    return type.operands.at(0) / 8;
+
+                case op::type_vector: case op::type_matrix:
+                    return size_of(type.operands.at(0)) * type.operands.at(1);
+
+                case op::type_array: {
+                    auto stride = decorations[id].array_stride.value_or(size_of(type.operands.at(0)));
+                    return stride * constants.at(type.operands.at(1));
+                }
+
+                case op::type_struct: {
+
+                    uint32_t size = 0;
+
+                    for (uint32_t member = 0; member < type.operands.size(); member++) {
+
+                        const auto& member_decoration = member_decorations[member_key(id, member)];
+                        const auto& member_type = types.at(type.operands.at(member));
+
+                        auto member_size = size_of(type.operands.at(member));
+                        if (member_type.opcode == op::type_matrix && member_decoration.matrix_stride)
+                            member_size = member_decoration.matrix_stride.value() * member_type.operands.at(1);
+
+                        size = std::max(size, member_decoration.offset.value_or(0) + member_size);
+
+                    }
+
+                    return size;
+
+                }
+
+                default: return 0;
+
+            }
+
+        };
+
+        auto stage = reflection.stages;
+
+        for (const auto& [pointer_id, id, storage_class] : variables) {
+
+            const auto& decoration = decorations[id];
+            auto type_id = types.at(pointer_id).operands.at(1);
+
+            if (storage_class == storage::push_constant) {
+                reflection.push_constant_range = vk::PushConstantRange {
+                    .stageFlags = stage,
+                    .offset = 0,
+                    .size = size_of(type_id)
+                };
+                continue;
+            }
+
+            if (storage_class == storage::input && stage & vk::ShaderStageFlagBits::eVertex) {
+
+                if (decoration.builtin || !decoration.location) continue;
+
+                const auto& type = types.at(type_id);
+                auto is_vector = type.opcode == op::type_vector;
+
+                const auto& scalar = is_vector ? types.at(type.operands.at(0)) : type;
+                auto components = is_vector ? type.operands.at(1) : 1;
+
+                reflection.vertex_inputs.push_back({
+                    .location = decoration.location.value(),
+                    .binding = 0,
+                    .format = to_format(scalar, components)
+                });
+
+                continue;
+
+            }
+
+            bool is_resource = storage_class == storage::uniform_constant
+                || storage_class == storage::uniform || storage_class == storage::storage_buffer;
+
+            if (!is_resource || !decoration.binding) continue;
+
+            uint32_t count = 1;
+            const auto* type = &types.at(type_id);
+
+            if (type->opcode == op::type_array) {
+                count = constants.at(type->operands.at(1));
+                type_id = type->operands.at(0);
+            } else if (type->opcode == op::type_runtime_array) {
+                count = 0;
+                type_id = type->operands.at(0);
+            }
+
+            type = &types.at(type_id);
+
+            using enum vk::DescriptorType;
+            auto descriptor_type = eUniformBuffer;
+
+            switch (type->opcode) {
+
+                case op::type_sampled_image: descriptor_type = eCombinedImageSampler; break;
+                case op::type_sampler: descriptor_type = eSampler; break;
+
+                case op::type_image: {
+                    // Operands: sampled type, dim, depth, arrayed, multisampled, sampled, format
+                    auto dim = type->operands.at(1), sampled = type->operands.at(5);
+                    if (dim == 5) descriptor_type = sampled == 1 ? eUniformTexelBuffer : eStorageTexelBuffer;
+                    else if (dim == 6) descriptor_type = eInputAttachment;
+                    else descriptor_type = sampled == 1 ? eSampledImage : eStorageImage;
+                    break;
+                }
+
+                case op::type_struct:
+                    if (storage_class == storage::storage_buffer || decorations[type_id].buffer_block)
+                        descriptor_type = eStorageBuffer;
+                    break;
+
+                default: throw std::runtime_error("Unsupported SPIR-V resource type");
+
+            }
+
+            reflection.descriptor_sets[decoration.set.value_or(0)].push_back({
+                .binding = decoration.binding.value(),
+                .descriptorType = descriptor_type,
+                .descriptorCount = count,
+                .stageFlags = stage
+            });
+
+        }
+
+        for (auto& [set, bindings] : reflection.descriptor_sets)
+            std::ranges::sort(bindings, { }, &vk::DescriptorSetLayoutBinding::binding);
+
+        std::ranges::sort(reflection.vertex_inputs, { }, &vk::VertexInputAttributeDescription::location);
+
+        return reflection;
+
+    }
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace engine {
+
+    // Interface of a shader as declared in its SPIR-V, used to build layouts instead of writing them by hand
+    struct ShaderReflection {
+
+        vk::ShaderStageFlags stages;
+
+        std::map<uint32_t, std::vector<vk::DescriptorSetLayoutBinding>> descriptor_sets;
+        std::optional<vk::PushConstantRange> push_constant_range;
+        std::vector<vk::VertexInputAttributeDescription> vertex_inputs;
+        std::array<uint32_t, 3> workgroup_size = { 1, 1, 1 };
+
+        void merge (const ShaderReflection& other);
+
+    };
+
+    ShaderReflection reflect_spirv (std::span<const uint32_t> code);
+
+}
@@ -0,0 +1,115 @@
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shader_archive.hpp"
+
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    bool ShaderArchive::open (const std::filesystem::path& path) {
+
+        SCOPED_PERF_LOG;
+
+        auto lock = std::scoped_lock(mutex);
+
+        auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0) {
+            logw("No shader archive at {}, loading loose SPIR-V files", path.string());
+            return false;
+        }
+
+        struct stat status;
+        auto size = fstat(fd, &status) == 0 ? static_cast<std::size_t>(status.st_size) : 0;
+        auto data = size >= sizeof(ShaderArchiveHeader) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+
+        ::close(fd);
+
+        if (data == MAP_FAILED) {
+            loge("Failed to map shader archive {}", path.string());
+            return false;
+        }
+
+        auto bytes = static_cast<const unsigned char*>(data);
+        auto header = ShaderArchiveHeader();
+        std::memcpy(&header, bytes, sizeof(header));
+
+        auto table_size = sizeof(ShaderArchiveHeader) + header.entry_count * sizeof(ShaderArchiveEntry);
+
+        if (header.magic != ShaderArchiveHeader::magic_value || header.version != ShaderArchiveHeader::current_version || table_size > size) {
+            loge("Shader archive {} is invalid or out of date", path.string());
+            munmap(data, size);
+            return false;
+        }
+
+        auto entries = reinterpret_cast<const ShaderArchiveEntry*>(bytes + sizeof(ShaderArchiveHeader));
+        auto directory = path.parent_path();
+
+        for (uint32_t i = 0; i < header.entry_count; i++) {
+
+            const auto& entry = entries[i];
+            auto name = std::filesystem::path(std::string(entry.name, strnlen(entry.name, sizeof(entry.name))));
+
+            if (entry.offset % sizeof(uint32_t) || entry.size % sizeof(uint32_t) || entry.offset + entry.size > size) {
+                loge("Skipping malformed shader archive entry {}", name.string());
+                continue;
+            }
+
+            if constexpr (debug)
+                if (hash_shader_code(bytes + entry.offset, entry.size) != entry.hash)
+                    logw("Shader archive entry {} does not match its hash", name.string());
+
+            auto code = std::span(reinterpret_cast<const uint32_t*>(bytes + entry.offset), entry.size / sizeof(uint32_t));
+            shaders[(directory / name.stem()).string()].push_back({ static_cast<vk::ShaderStageFlagBits>(entry.stage), code });
+
+        }
+
+        mapping = data;
+        mapping_size = size;
+
+        logi("Mapped {} shader stages from {}", header.entry_count, path.string());
+
+        return true;
+
+    }
+
+    void ShaderArchive::close ( ) {
+
+        auto lock = std::scoped_lock(mutex);
+
+        shaders.clear();
+        overrides.clear();
+
+        if (mapping) munmap(mapping, mapping_size);
+
+        mapping = nullptr;
+        mapping_size = 0;
+
+    }
+
+    std::optional<std::vector<ShaderArchive::Stage>> ShaderArchive::find (const std::string& shader_path) {
+
+        auto lock = std::scoped_lock(mutex);
+
+        if (overrides.contains(shader_path)) return std::nullopt;
+
+        auto shader = shaders.find(shader_path);
+        if (shader == shaders.end()) return std::nullopt;
+
+        return shader->second;
+
+    }
+
+    void ShaderArchive::invalidate (const std::string& shader_path) {
+
+        auto lock = std::scoped_lock(mutex);
+        overrides.insert(shader_path);
+
+    }
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "shader_archive_format.hpp"
+
+namespace engine {
+
+    // Shaders packed at build time into a single file that is mmapped once, modules are created
+    // straight from the mapped pages. Shaders missing from the archive or reloaded at runtime
+    // are loaded from loose .spv files instead
+    class ShaderArchive {
+
+        public:
+
+        struct Stage {
+            vk::ShaderStageFlagBits stage;
+            std::span<const uint32_t> code;
+        };
+
+        private:
+
+        static inline std::mutex mutex;
+        static inline void* mapping = nullptr;
+        static inline std::size_t mapping_size = 0;
+
+        static inline std::unordered_map<std::string, std::vector<Stage>> shaders;
+        static inline std::unordered_set<std::string> overrides;
+
+        public:
+
+        static bool open (const std::filesystem::path& path);
+        static void close ( );
+
+        static std::optional<std::vector<Stage>> find (const std::string& shader_path);
+        static void invalidate (const std::string& shader_path);
+
+    };
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace engine {
+
+    // Layout of the packed shader archive: a header, the entry table and then the SPIR-V blobs,
+    // each aligned to 16 bytes. Offsets are from the start of the file and stages are VkShaderStageFlagBits.
+    // Shared with tools/shader_packer.cpp, so it must not depend on anything but the standard library
+    struct ShaderArchiveHeader {
+
+        static constexpr uint32_t magic_value = 0x4153564C; // "LVSA"
+        static constexpr uint32_t current_version = 1;
+
+        uint32_t magic = magic_value;
+        uint32_t version = current_version;
+        uint32_t entry_count = 0;
+        uint32_t reserved = 0;
+
+    };
+
+    struct ShaderArchiveEntry {
+
+        char name[64] = { }; // file name without the .spv extension, like "particles.comp"
+        uint32_t stage = 0;
+        uint32_t reserved = 0;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint64_t hash = 0;
+
+    };
+
+    static_assert(sizeof(ShaderArchiveHeader) == 16);
+    static_assert(sizeof(ShaderArchiveEntry) == 96);
+
+    constexpr std::size_t shader_archive_alignment = 16;
+
+    // FNV-1a over the SPIR-V bytes
+    constexpr uint64_t hash_shader_code (const unsigned char* data, std::size_t size) {
+
+        uint64_t hash = 0xcbf29ce484222325;
+
+        for (std::size_t i = 0; i < size; i++) {
+            hash ^= data[i];
+            hash *= 0x100000001b3;
+        }
+
+        return hash;
+
+    }
+
+}
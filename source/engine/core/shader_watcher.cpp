@@ -0,0 +1,138 @@
+#include <array>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "shader_watcher.hpp"
+
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    static uint64_t hash_source (const std::string& source) {
+
+        uint64_t hash = 0xcbf29ce484222325;
+
+        for (auto character : source) {
+            hash ^= static_cast<uint8_t>(character);
+            hash *= 0x100000001b3;
+        }
+
+        return hash;
+
+    }
+
+    ShaderWatcher::ShaderWatcher (std::filesystem::path source_directory, std::filesystem::path output_directory)
+        : source_directory(source_directory), output_directory(output_directory) {
+
+        cache_directory = output_directory / "cache";
+        std::filesystem::create_directories(cache_directory);
+
+        inotify_fd = inotify_init1(IN_NONBLOCK);
+
+        if (inotify_fd < 0 || inotify_add_watch(inotify_fd, source_directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            logw("Failed to watch {} for shader changes", source_directory.string());
+            return;
+        }
+
+        worker = std::jthread([this] (std::stop_token token) { watch(token); });
+        logi("Watching {} for shader changes", source_directory.string());
+
+    }
+
+    ShaderWatcher::~ShaderWatcher ( ) {
+
+        if (worker.joinable()) {
+            worker.request_stop();
+            worker.join();
+        }
+
+        if (inotify_fd >= 0) close(inotify_fd);
+
+    }
+
+    void ShaderWatcher::watch (std::stop_token token) {
+
+        alignas(inotify_event) auto buffer = std::array<char, 4096>();
+
+        while (!token.stop_requested()) {
+
+            auto descriptor = pollfd { .fd = inotify_fd, .events = POLLIN };
+            if (poll(&descriptor, 1, 100) <= 0) continue;
+
+            auto length = read(inotify_fd, buffer.data(), buffer.size());
+
+            for (ssize_t offset = 0; offset < length;) {
+
+                auto event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+                offset += sizeof(inotify_event) + event->len;
+
+                if (!event->len) continue;
+
+                auto source = source_directory / event->name;
+                auto extension = source.extension();
+
+                if (extension != ".vert" && extension != ".frag" && extension != ".comp") continue;
+                if (!compile(source)) continue;
+
+                auto lock = std::scoped_lock(mutex);
+                changes.push_back((output_directory / source.stem()).string());
+
+            }
+
+        }
+
+    }
+
+    bool ShaderWatcher::compile (const std::filesystem::path& source) {
+
+        auto file = std::ifstream(source, std::ios::binary);
+        auto code = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        auto cached = cache_directory / fmt::format("{:016x}.spv", hash_source(code));
+        auto output = output_directory / (source.filename().string() + ".spv");
+
+        try {
+
+            if (!std::filesystem::exists(cached)) {
+
+                auto temporary = cached; temporary += ".tmp";
+                auto command = fmt::format("glslc \"{}\" -o \"{}\"", source.string(), temporary.string());
+
+                if (std::system(command.c_str()) != 0) {
+                    loge("Failed to compile {}", source.string());
+                    return false;
+                }
+
+                std::filesystem::rename(temporary, cached);
+                logi("Compiled {}", source.string());
+
+            } else logi("Reusing cached SPIR-V for {}", source.string());
+
+            // Copy next to the target and rename, so a pipeline build never reads a half written file
+            auto temporary = output; temporary += ".tmp";
+            std::filesystem::copy_file(cached, temporary, std::filesystem::copy_options::overwrite_existing);
+            std::filesystem::rename(temporary, output);
+
+        } catch (std::filesystem::filesystem_error& error) {
+            loge("Failed to update {}: {}", output.string(), error.what());
+            return false;
+        }
+
+        return true;
+
+    }
+
+    std::vector<std::string> ShaderWatcher::take_changes ( ) {
+
+        auto lock = std::scoped_lock(mutex);
+        return std::exchange(changes, { });
+
+    }
+
+}
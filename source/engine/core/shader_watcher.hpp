@@ -0,0 +1,37 @@
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace engine {
+
+    // Watches GLSL sources with inotify and recompiles them on a worker thread, SPIR-V is
+    // cached on disk by source hash. Reloaded shader paths are handed out by take_changes()
+    class ShaderWatcher {
+
+        std::filesystem::path source_directory;
+        std::filesystem::path output_directory;
+        std::filesystem::path cache_directory;
+
+        int inotify_fd = -1;
+        std::jthread worker;
+
+        std::mutex mutex;
+        std::vector<std::string> changes;
+
+        void watch (std::stop_token token);
+        bool compile (const std::filesystem::path& source);
+
+        public:
+
+        ShaderWatcher (std::filesystem::path source_directory, std::filesystem::path output_directory = "shaders");
+        ~ShaderWatcher ( );
+
+        std::vector<std::string> take_changes ( );
+
+    };
+
+}
@@ -1,3 +1,4 @@
+#include <array>
 #include <fstream>
 #include <stdexcept>
 
@@ -9,20 +10,75 @@
 
 namespace engine {
 
-    Shader::Shader (std::string path) {
+    std::size_t Specialization::hash ( ) const {
+
+        std::size_t seed = 0;
+
+        for (const auto& entry : entries)
+            hash_combine(seed, entry.constantID, entry.offset, entry.size);
+
+        for (const auto& byte : data)
+            hash_combine(seed, static_cast<uint8_t>(byte));
+
+        return seed;
+
+    }
+
+    Shader::Shader (std::string path, const Specialization& specialization)
+        : specialization(specialization), specialization_info(this->specialization.get_info()) {
 
         logi("Creating Shader...");
 
-        auto vertex_path = std::filesystem::path(path + ".vert.spv");
-        auto fragment_path = std::filesystem::path(path + ".frag.spv");
-        auto compute_path = std::filesystem::path(path + ".comp.spv");
+        for (const auto& stage : load_stages(path))
+            add_stage(stage.stage, stage.get());
+
+    }
+
+    ShaderReflection Shader::reflect (std::string path) {
+
+        auto reflection = ShaderReflection();
+
+        for (const auto& stage : load_stages(path))
+            reflection.merge(reflect_spirv(stage.get()));
+
+        return reflection;
+
+    }
+
+    std::size_t Shader::hash_code (std::string path) {
+
+        std::size_t seed = 0;
+
+        for (const auto& stage : load_stages(path)) {
+            hash_combine(seed, static_cast<VkShaderStageFlags>(stage.stage));
+            for (auto word : stage.get()) hash_combine(seed, word);
+        }
+
+        return seed;
+
+    }
+
+    std::vector<Shader::StageCode> Shader::load_stages (const std::string& path) {
+
+        auto stages = std::vector<StageCode>();
+
+        if (auto archived = ShaderArchive::find(path)) {
+            for (const auto& [stage, code] : *archived)
+                stages.push_back({ .stage = stage, .mapped = code });
+            return stages;
+        }
+
+        constexpr auto extensions = std::array {
+            std::pair { vk::ShaderStageFlagBits::eVertex, ".vert.spv" },
+            std::pair { vk::ShaderStageFlagBits::eFragment, ".frag.spv" },
+            std::pair { vk::ShaderStageFlagBits::eCompute, ".comp.spv" }
+        };
+
+        for (const auto& [stage, extension] : extensions)
+            if (auto stage_path = std::filesystem::path(path + extension); std::filesystem::exists(stage_path))
+                stages.push_back({ .stage = stage, .owned = read_from_file(stage_path) });
 
-        if (std::filesystem::exists(vertex_path))
-            add_stage(vk::ShaderStageFlagBits::eVertex, vertex_path);
-        if (std::filesystem::exists(fragment_path))
-            add_stage(vk::ShaderStageFlagBits::eFragment, fragment_path);
-        if (std::filesystem::exists(compute_path))
-            add_stage(vk::ShaderStageFlagBits::eCompute, compute_path);
+        return stages;
 
     }
 
@@ -33,14 +89,14 @@ namespace engine {
 
     }
 
-    void Shader::add_stage (vk::ShaderStageFlagBits stage, std::filesystem::path path) {
+    void Shader::add_stage (vk::ShaderStageFlagBits stage, std::span<const uint32_t> code) {
 
-        auto code = read_from_file(path);
+        reflection.merge(reflect_spirv(code));
 
         auto module_create_info = vk::ShaderModuleCreateInfo {
                 .flags = vk::ShaderModuleCreateFlags(),
-                .codeSize = code.size(),
-                .pCode = reinterpret_cast<const uint32_t*>(code.data())
+                .codeSize = code.size_bytes(),
+                .pCode = code.data()
             };
 
         try {
@@ -55,23 +111,24 @@ namespace engine {
             .flags = vk::PipelineShaderStageCreateFlags(),
             .stage = stage,
             .module = modules.back(),
-            .pName = "main"
+            .pName = "main",
+            .pSpecializationInfo = specialization.empty() ? nullptr : &specialization_info
         };
 
         stages.push_back(stage_create_info);
 
     }
 
-    std::vector<std::byte> Shader::read_from_file (std::filesystem::path path) {
+    std::vector<uint32_t> Shader::read_from_file (std::filesystem::path path) {
 
         auto file = std::ifstream(path, std::ios::ate | std::ios::binary);
 
         if (!file.is_open()) loge("Failed to load data from {}", path.string());
 
         std::size_t size = file.tellg(); file.seekg(0);
-        auto buffer = std::vector<std::byte>(size);
+        auto buffer = std::vector<uint32_t>(size / sizeof(uint32_t));
 
-        file.read(reinterpret_cast<char*>(buffer.data()), size);
+        file.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(uint32_t));
         file.close();
 
         return buffer;
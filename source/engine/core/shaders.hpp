@@ -5,25 +5,86 @@
 #include <filesystem>
 #include <span>
 
+#include "reflection.hpp"
+#include "shader_archive.hpp"
+
 #include "../utils/logging.hpp"
+#include "../utils/utils.hpp"
 
 namespace engine {
 
+    // Specialization constant values applied to every stage of a shader, booleans must be passed as vk::Bool32
+    class Specialization {
+
+        std::vector<vk::SpecializationMapEntry> entries;
+        std::vector<std::byte> data;
+
+        public:
+
+        template <typename T> Specialization& set (uint32_t id, T value) {
+
+            static_assert(std::is_trivially_copyable_v<T>);
+
+            entries.push_back({ .constantID = id, .offset = to_u32(data.size()), .size = sizeof(T) });
+
+            auto bytes = reinterpret_cast<const std::byte*>(&value);
+            data.insert(data.end(), bytes, bytes + sizeof(T));
+
+            return *this;
+
+        }
+
+        constexpr bool empty ( ) const { return entries.empty(); }
+        std::size_t hash ( ) const;
+
+        bool operator== (const Specialization&) const = default;
+
+        vk::SpecializationInfo get_info ( ) const {
+            return vk::SpecializationInfo {
+                .mapEntryCount = to_u32(entries.size()),
+                .pMapEntries = entries.data(),
+                .dataSize = data.size(),
+                .pData = data.data()
+            };
+        }
+
+    };
+
     class Shader {
 
         std::vector<vk::PipelineShaderStageCreateInfo> stages;
         std::vector<vk::ShaderModule> modules;
+        ShaderReflection reflection;
 
-        std::vector<std::byte> read_from_file (std::filesystem::path path);
-        void add_stage (vk::ShaderStageFlagBits stage, std::filesystem::path path);
+        Specialization specialization;
+        vk::SpecializationInfo specialization_info;
+
+        // Stage code either points into the mapped shader archive or owns the words of a loose file
+        struct StageCode {
+            vk::ShaderStageFlagBits stage;
+            std::span<const uint32_t> mapped;
+            std::vector<uint32_t> owned;
+            constexpr std::span<const uint32_t> get ( ) const { return owned.empty() ? mapped : std::span<const uint32_t>(owned); }
+        };
+
+        static std::vector<uint32_t> read_from_file (std::filesystem::path path);
+        static std::vector<StageCode> load_stages (const std::string& path);
+
+        void add_stage (vk::ShaderStageFlagBits stage, std::span<const uint32_t> code);
 
         public:
 
-        Shader (std::string path);
+        Shader (std::string path, const Specialization& specialization = { });
         ~Shader ( );
 
+        static ShaderReflection reflect (std::string path);
+
+        // Hash of the code of every stage, changes whenever the shader is recompiled differently
+        static std::size_t hash_code (std::string path);
+
         constexpr const auto get_stage_info ( ) const { return stages; }
+        constexpr const ShaderReflection& get_reflection ( ) const { return reflection; }
 
     };
 
-}
\ No newline at end of file
+}
@@ -14,6 +14,8 @@ namespace engine {
 
     void SwapChain::create_handle ( ) {
 
+        SCOPED_PERF_LOG;
+
         auto capabilities = device->get_gpu().getSurfaceCapabilitiesKHR(device->get_surface());
         auto modes = device->get_gpu().getSurfacePresentModesKHR(device->get_surface());
         extent = device->get_extent();
@@ -85,7 +87,28 @@ namespace engine {
             frames.at(i).depth_buffer = depth_buffer;
             frames.at(i).color_buffer = color_buffer;
 
-            auto attachments = std::array { color_buffer->get_view(), frames.at(i).view.get(), depth_buffer->get_view() };
+		};
+
+        logi("Created ImageView's for SwapChain");
+
+        make_framebuffers();
+
+        for (auto& frame : frames) {          
+            frame.image_available = make_semaphore(device->get_handle());
+            frame.render_finished = make_semaphore(device->get_handle());
+            frame.in_flight = make_fence(device->get_handle());
+        }
+
+    }
+
+    void SwapChain::make_framebuffers ( ) {
+
+        for (auto& frame : frames) {
+
+            frame.buffer.reset();
+            if (!render_pass) continue;
+
+            auto attachments = std::array { color_buffer->get_view(), frame.view.get(), depth_buffer->get_view() };
 
             auto create_info = vk::FramebufferCreateInfo {
                 .flags = vk::FramebufferCreateFlags(),
@@ -98,20 +121,19 @@ namespace engine {
             };
 
             try {
-                frames.at(i).buffer = device->get_handle().createFramebufferUnique(create_info);
+                frame.buffer = device->get_handle().createFramebufferUnique(create_info);
             } catch (vk::SystemError err) {
                 loge("Failed to create Framebuffer");
             }
 
-		};
+        }
 
-        logi("Created ImageView's for SwapChain");
+    }
 
-        for (auto& frame : frames) {          
-            frame.image_available = make_semaphore(device->get_handle());
-            frame.render_finished = make_semaphore(device->get_handle());
-            frame.in_flight = make_fence(device->get_handle());
-        }
+    void SwapChain::set_render_pass (vk::RenderPass render_pass) {
+
+        this->render_pass = render_pass;
+        make_framebuffers();
 
     }
 
@@ -34,12 +34,13 @@ namespace engine {
         vk::Queue queue;
         vk::UniqueSwapchainKHR handle;
         std::vector<Frame> frames;
-        vk::RenderPass render_pass;
+        vk::RenderPass render_pass; // null when frames are drawn with dynamic rendering
         vk::Extent2D extent;
 
         std::shared_ptr<Device> device = Device::get();
 
         void make_frames ( );
+        void make_framebuffers ( );
 
         public:
 
@@ -56,6 +57,7 @@ namespace engine {
         }
 
         void create_handle ( );
+        void set_render_pass (vk::RenderPass render_pass);
 
         constexpr const vk::SwapchainKHR& get_handle ( ) const { return handle.get(); }
         constexpr std::vector<Frame>& get_frames ( ) { return frames; }
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "stb_image.h"
+
+#include "texture_loader.hpp"
+#include "block_compression.hpp"
+#include "image.hpp"
+#include "ktx2.hpp"
+#include "mipmaps.hpp"
+
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    namespace {
+
+        // Decodes and, unless the device blits them at upload, filters the levels below the first on the same thread
+        DecodedImage load_image (const std::filesystem::path& path, MipFilter filter) {
+
+            auto image = decode_image(path);
+            if (image.pixels.empty() || filter == MipFilter::blit) return image;
+
+            {
+                auto timer = ScopedTimer([&image] (double duration) { image.mipmap_time = duration; });
+                image.mipmaps = generate_mipmaps(image.pixels, image.width, image.height, filter);
+            }
+
+            return image;
+
+        }
+
+        // Workers sleep on the queue until a job or the stop request comes. Declared last, the workers are
+        // joined before the queue they wait on is destroyed
+        class DecodePool {
+
+            std::mutex mutex;
+            std::condition_variable_any condition;
+            std::deque<std::function<void()>> jobs;
+            std::unordered_map<std::string, std::future<DecodedImage>> prefetched;
+            std::vector<std::jthread> workers;
+
+            void work (std::stop_token token) {
+
+                while (true) {
+
+                    auto job = std::function<void()>();
+
+                    {
+                        auto lock = std::unique_lock(mutex);
+                        if (!condition.wait(lock, token, [this] { return !jobs.empty(); })) return;
+                        job = std::move(jobs.front());
+                        jobs.pop_front();
+                    }
+
+                    job();
+
+                }
+
+            }
+
+            public:
+
+            DecodePool ( ) {
+
+                // One thread is left to the caller, which uploads while the workers decode
+                auto count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+                for (std::size_t i = 0; i < std::max(1u, count); ++i)
+                    workers.emplace_back([this] (std::stop_token token) { work(token); });
+
+            }
+
+            std::future<DecodedImage> decode (std::filesystem::path path) {
+
+                auto filter = TextureLoader::get_mip_filter();
+                auto task = std::make_shared<std::packaged_task<DecodedImage()>>([path, filter] { return load_image(path, filter); });
+                auto future = task->get_future();
+
+                {
+                    auto lock = std::lock_guard(mutex);
+                    jobs.emplace_back([task] { (*task)(); });
+                }
+
+                condition.notify_one();
+
+                return future;
+
+            }
+
+            void prefetch (std::string_view path) {
+
+                auto future = decode(std::filesystem::path(path));
+
+                auto lock = std::lock_guard(mutex);
+                prefetched.insert_or_assign(std::string(path), std::move(future));
+
+            }
+
+            std::optional<std::future<DecodedImage>> take_prefetched (std::string_view path) {
+
+                auto lock = std::lock_guard(mutex);
+
+                auto found = prefetched.find(std::string(path));
+                if (found == prefetched.end()) return std::nullopt;
+
+                auto future = std::move(found->second);
+                prefetched.erase(found);
+
+                return future;
+
+            }
+
+            std::size_t get_worker_count ( ) const { return workers.size(); }
+
+        };
+
+        DecodePool& get_pool ( ) {
+
+            static auto pool = DecodePool();
+            return pool;
+
+        }
+
+    }
+
+    DecodedImage decode_image (const std::filesystem::path& path) {
+
+        auto image = DecodedImage();
+        auto data = std::vector<unsigned char>();
+
+        {
+            auto timer = ScopedTimer([&image] (double duration) { image.read_time = duration; });
+
+            auto input = std::ifstream(path, std::ios::binary | std::ios::ate);
+            if (!input) return image;
+
+            data.resize(static_cast<std::size_t>(input.tellg()));
+            input.seekg(0);
+            input.read(reinterpret_cast<char*>(data.data()), data.size());
+
+            if (!input) return image;
+        }
+
+        {
+            auto timer = ScopedTimer([&image] (double duration) { image.decode_time = duration; });
+
+            int width, height, channels;
+            auto pixels = stbi_load_from_memory(data.data(), static_cast<int>(data.size()), &width, &height, &channels, 4);
+
+            if (pixels) {
+                image.width = width;
+                image.height = height;
+                image.pixels.resize(image.width * image.height * 4);
+                std::memcpy(image.pixels.data(), pixels, image.pixels.size());
+                stbi_image_free(pixels);
+            }
+        }
+
+        return image;
+
+    }
+
+    void TextureLoader::prefetch (std::string_view path) {
+
+        if (find_compressed(path)) return;
+
+        get_pool().prefetch(path);
+
+    }
+
+    DecodedImage TextureLoader::take (std::string_view path) {
+
+        auto prefetched = get_pool().take_prefetched(path);
+        auto image = prefetched ? prefetched->get() : load_image(path, mip_filter);
+
+        if (image.pixels.empty()) loge("Failed to decode texture {}", path);
+
+        return image;
+
+    }
+
+    std::vector<std::unique_ptr<Texture>> TextureLoader::load (std::span<const std::filesystem::path> paths, TextureLoadTimings& timings) {
+
+        SCOPED_PERF_LOG;
+
+        auto& pool = get_pool();
+
+        auto decodes = std::vector<std::future<DecodedImage>>();
+        for (const auto& path : paths) decodes.push_back(pool.decode(path));
+
+        auto textures = std::vector<std::unique_ptr<Texture>>(paths.size());
+        auto remaining = std::vector<std::size_t>(paths.size());
+        std::iota(remaining.begin(), remaining.end(), 0);
+
+        while (!remaining.empty()) {
+
+            // Whatever finished first is uploaded first, with nothing finished the oldest decode is waited for
+            auto ready = std::ranges::find_if(remaining, [&] (std::size_t i) {
+                return decodes[i].wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            });
+
+            auto index = ready != remaining.end() ? *ready : remaining.front();
+            remaining.erase(ready != remaining.end() ? ready : remaining.begin());
+
+            auto image = decodes[index].get();
+
+            timings.read += image.read_time;
+            timings.decode += image.decode_time;
+            timings.mipmaps += image.mipmap_time;
+
+            if (image.pixels.empty()) loge("Failed to decode texture {}", paths[index].string());
+
+            textures[index] = std::make_unique<Texture>(std::move(image), &timings);
+
+        }
+
+        return textures;
+
+    }
+
+    std::size_t TextureLoader::get_worker_count ( ) {
+
+        return get_pool().get_worker_count();
+
+    }
+
+    std::optional<std::filesystem::path> TextureLoader::find_compressed (const std::filesystem::path& source) {
+
+        if (source.extension() == ".ktx2") return source;
+        if (!prefer_compressed) return std::nullopt;
+
+        auto compressed = std::filesystem::path(source).replace_extension(".ktx2");
+        auto error = std::error_code();
+
+        if (!std::filesystem::exists(compressed, error)) return std::nullopt;
+
+        // A source edited after the conversion wins over its stale copy
+        if (std::filesystem::exists(source, error) &&
+            std::filesystem::last_write_time(compressed, error) < std::filesystem::last_write_time(source, error)) {
+            logw("{} is older than {}, loading the source", compressed.string(), source.string());
+            return std::nullopt;
+        }
+
+        return compressed;
+
+    }
+
+    bool TextureLoader::convert (const std::filesystem::path& source, const std::filesystem::path& output, MipFilter filter) {
+
+        SCOPED_PERF_LOG;
+
+        auto image = decode_image(source);
+
+        if (image.pixels.empty()) {
+            loge("Failed to decode texture {}", source.string());
+            return false;
+        }
+
+        auto format = pick_block_format(image.pixels);
+
+        auto texture = Ktx2Texture {
+            .format = get_vk_format(format),
+            .width = static_cast<uint32_t>(image.width),
+            .height = static_cast<uint32_t>(image.height)
+        };
+
+        texture.levels.push_back(compress_blocks(image.pixels, image.width, image.height, format));
+
+        auto mipmaps = generate_mipmaps(image.pixels, image.width, image.height, filter);
+
+        for (uint32_t level = 1; level <= mipmaps.size(); ++level)
+            texture.levels.push_back(compress_blocks(mipmaps[level - 1], get_mip_extent(image.width, level), get_mip_extent(image.height, level), format));
+
+        if (!write_ktx2(output, texture)) return false;
+
+        auto compressed_size = std::size_t(0);
+        for (const auto& level : texture.levels) compressed_size += level.size();
+
+        logi("Converted {} to {} with {} {} filtered levels in {} KiB", source.string(), output.string(), texture.levels.size(),
+            to_string(filter), compressed_size / 1024);
+
+        return true;
+
+    }
+
+}
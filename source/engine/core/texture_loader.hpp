@@ -0,0 +1,75 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "mipmaps.hpp"
+
+namespace engine {
+
+    class Texture;
+
+    // Pixels as a texture uploads them, always four 8 bit channels
+    struct DecodedImage {
+        std::size_t width = 0;
+        std::size_t height = 0;
+        std::vector<std::byte> pixels;
+        std::vector<std::vector<std::byte>> mipmaps; // levels below the first when filtered on the CPU
+        double read_time = 0;   // milliseconds
+        double decode_time = 0; // milliseconds
+        double mipmap_time = 0; // milliseconds
+    };
+
+    // Milliseconds spent in every stage of loading textures, summed over the textures. Reading and decoding
+    // run on several threads at once, so their sums can exceed the wall clock time of a load
+    struct TextureLoadTimings {
+        double read = 0;
+        double decode = 0;
+        double mipmaps = 0;
+        double upload = 0;
+    };
+
+    // Reads the whole file first and decodes from memory, so both stages can be timed apart. Empty on failure
+    DecodedImage decode_image (const std::filesystem::path& path);
+
+    // Decodes images on a pool of worker threads while the calling thread goes on, uploads stay on the caller
+    // since they record into the device's queues
+    class TextureLoader {
+
+        static inline bool prefer_compressed = true;
+        static inline MipFilter mip_filter = MipFilter::blit;
+
+        public:
+
+        // Starts decoding in the background, the next Texture constructed from the same path picks up the result.
+        // Paths with a block compressed copy aren't decoded, their Texture reads the copy instead
+        static void prefetch (std::string_view path);
+
+        // Decoded pixels of the path, waits for a prefetch of it when there is one and decodes here otherwise
+        static DecodedImage take (std::string_view path);
+
+        // Loads every texture, the calling thread uploads finished decodes in completion order while the
+        // workers decode the rest. Textures are returned in the order of their paths
+        static std::vector<std::unique_ptr<Texture>> load (std::span<const std::filesystem::path> paths, TextureLoadTimings& timings);
+
+        static std::size_t get_worker_count ( );
+
+        // The path itself for a .ktx2 file, otherwise a .ktx2 file next to it that is at least as new as the source
+        static std::optional<std::filesystem::path> find_compressed (const std::filesystem::path& source);
+
+        // Block compresses the image with its mip chain filtered on the CPU, false when reading or writing failed
+        static bool convert (const std::filesystem::path& source, const std::filesystem::path& output, MipFilter filter = MipFilter::kaiser);
+
+        static void set_prefer_compressed (bool prefer) { prefer_compressed = prefer; }
+
+        // Applies to decodes started afterwards, the decoding workers then also filter the levels below the first
+        static void set_mip_filter (MipFilter filter) { mip_filter = filter; }
+        static MipFilter get_mip_filter ( ) { return mip_filter; }
+
+    };
+
+}
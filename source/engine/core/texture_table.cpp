@@ -0,0 +1,151 @@
+#include <stdexcept>
+
+#include "texture_table.hpp"
+
+#include "device.hpp"
+#include "layout_cache.hpp"
+
+#include "../utils/logging.hpp"
+
+namespace engine {
+
+    void TextureTable::make_set ( ) {
+
+        auto device = Device::get();
+
+        // Matches the unsized sampler2D array at set 0, binding 0 of the fragment shaders
+        auto binding = vk::DescriptorSetLayoutBinding {
+            .binding = 0,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = 0,
+            .stageFlags = vk::ShaderStageFlagBits::eFragment
+        };
+
+        layout = LayoutCache::get_set_layout({ &binding, 1 });
+
+        auto pool_size = vk::DescriptorPoolSize {
+            .type = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = LayoutCache::bindless_capacity
+        };
+
+        auto create_info = vk::DescriptorPoolCreateInfo {
+            .flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+            .maxSets = 1,
+            .poolSizeCount = 1,
+            .pPoolSizes = &pool_size
+        };
+
+        try {
+            pool = device->get_handle().createDescriptorPool(create_info);
+            logi("Successfully created bindless Descriptor Pool");
+        } catch (vk::SystemError err) {
+            throw std::runtime_error("Failed to create bindless Descriptor Pool");
+        }
+
+        auto allocate_info = vk::DescriptorSetAllocateInfo {
+            .descriptorPool = pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &layout
+        };
+
+        try {
+            set = device->get_handle().allocateDescriptorSets(allocate_info).at(0);
+        } catch (vk::SystemError err) {
+            throw std::runtime_error("Failed to allocate bindless DescriptorSet");
+        }
+
+    }
+
+    uint32_t TextureTable::add (vk::Sampler sampler, vk::ImageView view) {
+
+        auto lock = std::scoped_lock(mutex);
+
+        if (!set) make_set();
+
+        uint32_t slot = next_slot;
+
+        if (!free_slots.empty()) {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        } else if (next_slot < LayoutCache::bindless_capacity) next_slot++;
+        else throw std::runtime_error("Bindless texture table is full");
+
+        auto image_info = vk::DescriptorImageInfo {
+            .sampler = sampler,
+            .imageView = view,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        auto write_info = vk::WriteDescriptorSet {
+            .dstSet = set,
+            .dstBinding = 0,
+            .dstArrayElement = slot,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+            .pImageInfo = &image_info
+        };
+
+        Device::get()->get_handle().updateDescriptorSets(1, &write_info, 0, nullptr);
+        update_statistics();
+
+        return slot;
+
+    }
+
+    void TextureTable::remove (uint32_t slot) {
+
+        // The descriptor is left in place, the table is partially bound and the slot is no longer indexed
+        auto lock = std::scoped_lock(mutex);
+        if (!set) return;
+
+        if (retired_slots.size() <= current_frame) retired_slots.resize(current_frame + 1);
+        retired_slots.at(current_frame).push_back(slot);
+
+    }
+
+    void TextureTable::reset_frame (uint32_t frame) {
+
+        auto lock = std::scoped_lock(mutex);
+
+        // Every command buffer that could index these slots was submitted before this frame's last submission
+        if (frame < retired_slots.size()) {
+            auto& retired = retired_slots.at(frame);
+            free_slots.insert(free_slots.end(), retired.begin(), retired.end());
+            retired.clear();
+        }
+
+        current_frame = frame;
+        update_statistics();
+
+    }
+
+    void TextureTable::bind (const vk::CommandBuffer& commands, vk::PipelineLayout pipeline_layout) {
+
+        commands.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout, 0, 1, &set, 0, nullptr);
+
+    }
+
+    void TextureTable::update_statistics ( ) {
+
+        auto retired_count = std::size_t(0);
+        for (const auto& retired : retired_slots) retired_count += retired.size();
+
+        perf_statistics["Bindless textures"] = next_slot - free_slots.size() - retired_count;
+
+    }
+
+    void TextureTable::clear ( ) {
+
+        auto lock = std::scoped_lock(mutex);
+
+        if (pool) Device::get()->get_handle().destroyDescriptorPool(pool);
+
+        pool = nullptr;
+        set = nullptr;
+        next_slot = 0;
+        free_slots.clear();
+        retired_slots.clear();
+
+    }
+
+}
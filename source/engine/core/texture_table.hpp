@@ -0,0 +1,44 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+namespace engine {
+
+    // A single update-after-bind descriptor set holding every sampled texture. Textures register
+    // into a slot and shaders index the table with that slot, so one bind covers all of them
+    class TextureTable {
+
+        static inline std::mutex mutex;
+
+        static inline vk::DescriptorPool pool;
+        static inline vk::DescriptorSetLayout layout;
+        static inline vk::DescriptorSet set;
+
+        static inline uint32_t next_slot = 0;
+        static inline std::vector<uint32_t> free_slots;
+
+        // Slots removed while a frame was recorded, frames still in flight may index them until its fence signals
+        static inline uint32_t current_frame = 0;
+        static inline std::vector<std::vector<uint32_t>> retired_slots;
+
+        static void make_set ( );
+        static void update_statistics ( );
+
+        public:
+
+        static uint32_t add (vk::Sampler sampler, vk::ImageView view);
+
+        // The slot is reused once the frame it was removed in has finished executing
+        static void remove (uint32_t slot);
+
+        // Must only be called once the frame's command buffers have finished executing
+        static void reset_frame (uint32_t frame);
+
+        static void bind (const vk::CommandBuffer& commands, vk::PipelineLayout pipeline_layout);
+
+        static void clear ( );
+
+    };
+
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "vertex_layout.hpp"
+
+namespace engine {
+
+    namespace {
+
+        constexpr auto layout_names = std::array<std::string_view, vertex_layout_count + 1> { "full", "compact", "quantized", "automatic" };
+
+        // Flat meshes have no extent along one axis, every position then quantizes to the minimum
+        glm::vec3 get_quantization_extent (const VertexBounds& bounds) {
+
+            auto extent = bounds.maximum - bounds.minimum;
+            return glm::vec3(extent.x > 0 ? extent.x : 1.f, extent.y > 0 ? extent.y : 1.f, extent.z > 0 ? extent.z : 1.f);
+
+        }
+
+        template <typename T> void store (std::vector<std::byte>& data, std::size_t index, const T& value) {
+
+            std::memcpy(data.data() + index * sizeof(T), &value, sizeof(T));
+
+        }
+
+    }
+
+    std::string_view to_string (VertexLayout layout) {
+
+        return layout_names.at(static_cast<std::size_t>(layout));
+
+    }
+
+    std::optional<VertexLayout> parse_vertex_layout (std::string_view name) {
+
+        auto found = std::ranges::find(layout_names, name);
+        if (found == layout_names.end()) return std::nullopt;
+
+        return static_cast<VertexLayout>(found - layout_names.begin());
+
+    }
+
+    uint32_t get_vertex_stride (VertexLayout layout) {
+
+        switch (layout) {
+            case VertexLayout::compact: return sizeof(CompactVertex);
+            case VertexLayout::quantized: return sizeof(QuantizedVertex);
+            default: return sizeof(Vertex);
+        }
+
+    }
+
+    vk::VertexInputBindingDescription get_binding_description (VertexLayout layout) {
+
+        return {
+            .binding = 0,
+            .stride = get_vertex_stride(layout),
+            .inputRate = vk::VertexInputRate::eVertex
+        };
+
+    }
+
+    std::vector<vk::VertexInputAttributeDescription> get_attribute_descriptions (VertexLayout layout) {
+
+        auto attribute = [] (uint32_t location, vk::Format format, uint32_t offset) {
+            return vk::VertexInputAttributeDescription { .location = location, .binding = 0, .format = format, .offset = offset };
+        };
+
+        switch (layout) {
+
+            case VertexLayout::compact: return {
+                attribute(0, vk::Format::eR32G32B32Sfloat, offsetof(CompactVertex, position)),
+                attribute(2, vk::Format::eR32G32Sfloat, offsetof(CompactVertex, texture_coordinates))
+            };
+
+            case VertexLayout::quantized: return {
+                attribute(0, vk::Format::eR16G16B16A16Unorm, offsetof(QuantizedVertex, position)),
+                attribute(2, vk::Format::eR16G16Sfloat, offsetof(QuantizedVertex, texture_coordinates))
+            };
+
+            default: return Vertex::get_attribute_descriptions();
+
+        }
+
+    }
+
+    VertexBounds get_bounds (std::span<const Vertex> vertices) {
+
+        if (vertices.empty()) return { };
+
+        auto bounds = VertexBounds { glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()) };
+
+        for (const auto& vertex : vertices) {
+            bounds.minimum = glm::min(bounds.minimum, vertex.position);
+            bounds.maximum = glm::max(bounds.maximum, vertex.position);
+        }
+
+        return bounds;
+
+    }
+
+    VertexLayout resolve_layout (VertexLayout requested, std::span<const Vertex> vertices) {
+
+        if (requested != VertexLayout::automatic) return requested;
+        if (vertices.empty()) return VertexLayout::full;
+
+        auto color = vertices.front().color;
+        auto uniform = std::ranges::all_of(vertices, [&color] (const Vertex& vertex) { return vertex.color == color; });
+
+        return uniform ? VertexLayout::compact : VertexLayout::full;
+
+    }
+
+    glm::mat4x4 get_dequantization (VertexLayout layout, const VertexBounds& bounds) {
+
+        if (layout != VertexLayout::quantized) return glm::mat4x4(1.f);
+
+        return glm::scale(glm::translate(glm::mat4x4(1.f), bounds.minimum), get_quantization_extent(bounds));
+
+    }
+
+    std::vector<std::byte> encode_vertices (std::span<const Vertex> vertices, VertexLayout layout, const VertexBounds& bounds) {
+
+        auto data = std::vector<std::byte>(vertices.size() * get_vertex_stride(layout));
+
+        if (layout == VertexLayout::full) {
+            std::memcpy(data.data(), vertices.data(), vertices.size_bytes());
+            return data;
+        }
+
+        if (layout == VertexLayout::compact) {
+            for (std::size_t i = 0; i < vertices.size(); ++i)
+                store(data, i, CompactVertex { vertices[i].position, vertices[i].texture_coordinates });
+            return data;
+        }
+
+        auto extent = get_quantization_extent(bounds);
+        constexpr auto unorm_max = float(std::numeric_limits<uint16_t>::max());
+
+        for (std::size_t i = 0; i < vertices.size(); ++i) {
+
+            auto normalized = glm::clamp((vertices[i].position - bounds.minimum) / extent, 0.f, 1.f);
+            auto quantized = glm::round(normalized * unorm_max);
+
+            store(data, i, QuantizedVertex {
+                .position = { uint16_t(quantized.x), uint16_t(quantized.y), uint16_t(quantized.z), 0 },
+                .texture_coordinates = { glm::packHalf1x16(vertices[i].texture_coordinates.x), glm::packHalf1x16(vertices[i].texture_coordinates.y) }
+            });
+
+        }
+
+        return data;
+
+    }
+
+}
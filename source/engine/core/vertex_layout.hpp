@@ -0,0 +1,64 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "../utils/primitives.hpp"
+
+namespace engine {
+
+    // How a model lays out its vertex buffer, the CPU copy of a model always stays in the full Vertex layout
+    enum class VertexLayout : uint32_t {
+        full,      // float position, color and texture coordinates as in Vertex, 32 bytes
+        compact,   // float position and texture coordinates, for meshes whose color is uniform, 20 bytes
+        quantized, // 16 bit positions normalized to the mesh bounds and half float texture coordinates, 12 bytes
+        automatic  // only requested, compact for meshes whose color is uniform and full otherwise
+    };
+
+    // Layouts a vertex buffer can have, automatic is not one of them
+    constexpr std::size_t vertex_layout_count = 3;
+
+    struct CompactVertex {
+        glm::vec3 position;
+        glm::vec2 texture_coordinates;
+    };
+
+    // The position has a fourth component since three component 16 bit formats are rarely supported as vertex input
+    struct QuantizedVertex {
+        uint16_t position[4];
+        uint16_t texture_coordinates[2];
+    };
+
+    static_assert(sizeof(CompactVertex) == 20);
+    static_assert(sizeof(QuantizedVertex) == 12);
+
+    // Box the quantized positions are relative to
+    struct VertexBounds {
+        glm::vec3 minimum = glm::vec3(0.f);
+        glm::vec3 maximum = glm::vec3(0.f);
+    };
+
+    std::string_view to_string (VertexLayout layout);
+    std::optional<VertexLayout> parse_vertex_layout (std::string_view name);
+
+    uint32_t get_vertex_stride (VertexLayout layout);
+
+    // Vertex input of shaders reading position at location 0 and texture coordinates at location 2,
+    // color at location 1 is only provided by the full layout
+    vk::VertexInputBindingDescription get_binding_description (VertexLayout layout);
+    std::vector<vk::VertexInputAttributeDescription> get_attribute_descriptions (VertexLayout layout);
+
+    VertexBounds get_bounds (std::span<const Vertex> vertices);
+
+    // Layouts asked for by name are kept as they are, automatic drops color when every vertex has the same one
+    VertexLayout resolve_layout (VertexLayout requested, std::span<const Vertex> vertices);
+
+    // Maps positions as read by the vertex input back to model space, meant to be folded into the model
+    // matrix so shaders need no dequantization of their own. Identity for the float layouts
+    glm::mat4x4 get_dequantization (VertexLayout layout, const VertexBounds& bounds);
+
+    std::vector<std::byte> encode_vertices (std::span<const Vertex> vertices, VertexLayout layout, const VertexBounds& bounds);
+
+}
@@ -1,10 +1,17 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <stdexcept>
+
 #include "engine.hpp"
 
 #include "core/image.hpp"
 #include "core/pipeline.hpp"
+#include "core/pipeline_registry.hpp"
+#include "core/layout_cache.hpp"
+#include "core/descriptor_allocator.hpp"
+#include "core/shader_archive.hpp"
+#include "core/texture_table.hpp"
 
 #include "utils/utils.hpp"
 #include "utils/logging.hpp"
@@ -14,6 +21,8 @@ namespace engine {
 
     Engine::Engine (GLFWwindow* window) {
 
+        startup_time = std::chrono::high_resolution_clock::now();
+
         logi("Creating Engine instance...");
 
         if constexpr (debug) {
@@ -33,39 +42,43 @@ namespace engine {
 
         auto ec = glz::read_file(settings, "engine_settings.json");
 
+        ShaderArchive::open("shaders/shaders.pak");
+
         dldi = vk::DispatchLoaderDynamic(device->get_instance(), vkGetInstanceProcAddr);
         if constexpr (debug) debug_messenger = make_debug_messenger(device->get_instance(), dldi);
 
         auto indices = get_queue_family_indices(device->get_gpu(), device->get_surface());
         queue = device->get_handle().getQueue(indices.graphics_family.value(), 0);
 
+        is_dynamic_rendering = settings.dynamic_rendering && device->supports_dynamic_rendering();
+        if (settings.dynamic_rendering && !is_dynamic_rendering) logw("Dynamic rendering is not supported, using a render pass");
+
+        auto depth_format = Image::get_depth_format();
+        depth_aspect = vk::ImageAspectFlagBits::eDepth;
+        if (depth_format != vk::Format::eD32Sfloat) depth_aspect |= vk::ImageAspectFlagBits::eStencil;
+
         render_pass = create_render_pass();
-        swapchain = std::make_unique<SwapChain>(render_pass);
+        swapchain = std::make_unique<SwapChain>(get_target_render_pass());
         max_frames_in_flight = swapchain->get_frames().size();
 
-        // Layouts
-        descriptor_set_layout = create_descriptor_set_layout();
+        auto reflection = Shader::reflect("shaders/basic");
 
-        auto push_constant_range = vk::PushConstantRange {
-            .stageFlags = vk::ShaderStageFlagBits::eVertex,
-            .offset = 0,
-            .size = sizeof(MVPMatrix)
-        };
+        if (!reflection.push_constant_range || reflection.push_constant_range->size != sizeof(DrawConstants))
+            throw std::runtime_error("shaders/basic push constants do not match DrawConstants");
 
-        auto sample_count = get_max_sample_count(device->get_gpu());
-        pipeline_layout = create_pipeline_layout(&descriptor_set_layout, &push_constant_range);
-        pipeline = create_pipeline({
-            .multisampling_info = create_multisampling_info(sample_count, true),
-            .layout = pipeline_layout,
-            .render_pass = render_pass,
-            .shader_path = "shaders/basic",
-        });
+        pipeline_layout = LayoutCache::get_pipeline_layout(reflection);
+        make_pipeline();
 
         make_command_pool();
         make_command_buffers();
 
-        if (is_imgui_enabled) ui = std::make_unique<UI>(max_frames_in_flight, render_pass);
-        particle_system = std::make_unique<ParticleSystem>(max_frames_in_flight, render_pass);
+#if defined(SHADER_SOURCE_DIR)
+        if constexpr (debug) shader_watcher = std::make_unique<ShaderWatcher>(SHADER_SOURCE_DIR);
+#endif
+
+        if (is_imgui_enabled) ui = std::make_unique<UI>(max_frames_in_flight, get_target_render_pass());
+        auto particle_backend = settings.cpu_particles ? ParticleBackend::eCPU : ParticleBackend::eGPU;
+        particle_system = std::make_unique<ParticleSystem>(max_frames_in_flight, get_target_render_pass(), particle_backend);
 
     }
 
@@ -83,9 +96,13 @@ namespace engine {
         device->get_handle().destroyCommandPool(command_pool);
 
         logi("Destroying Pipeline");
-        device->get_handle().destroyPipelineLayout(pipeline_layout);
-        device->get_handle().destroyDescriptorSetLayout(descriptor_set_layout);
-        device->get_handle().destroyPipeline(pipeline);
+        ui.reset();
+        particle_system.reset();
+        pipelines = { };
+        TextureTable::clear();
+        DescriptorAllocator::clear();
+        LayoutCache::clear();
+        ShaderArchive::close();
         device->get_handle().destroyRenderPass(render_pass);
 
     }
@@ -105,6 +122,48 @@ namespace engine {
         if (fps_limiter.is_enabled)
             fps_limiter.set_target(settings.fps_limit);
 
+        using enum ParticleBlending;
+        particle_system->set_blending(settings.additive_particles ? eAdditive : eOrdered);
+
+        auto dynamic_rendering = settings.dynamic_rendering && device->supports_dynamic_rendering();
+        if (dynamic_rendering != is_dynamic_rendering) set_dynamic_rendering(dynamic_rendering);
+
+    }
+
+    void Engine::make_pipeline ( ) {
+
+        auto sample_count = get_max_sample_count(device->get_gpu());
+
+        for (std::size_t i = 0; i < vertex_layout_count; ++i) {
+            auto layout = static_cast<VertexLayout>(i);
+            pipelines.at(i) = PipelineRegistry::acquire({
+                .binding_description = get_binding_description(layout),
+                .attribute_descriptions = get_attribute_descriptions(layout),
+                .multisampling_info = create_multisampling_info(sample_count, true),
+                .layout = pipeline_layout,
+                .render_pass = get_target_render_pass(),
+                .shader_path = "shaders/basic",
+            });
+        }
+
+    }
+
+    void Engine::set_dynamic_rendering (bool enabled) {
+
+        SCOPED_PERF_LOG;
+
+        device->get_handle().waitIdle();
+        is_dynamic_rendering = enabled;
+
+        // Graphics pipelines are only compatible with the render pass they were built for
+        swapchain->set_render_pass(get_target_render_pass());
+        make_pipeline();
+        particle_system->set_render_pass(get_target_render_pass());
+        if (ui) ui->set_render_pass(get_target_render_pass());
+
+        current_frame = 0;
+        logi("Switched to {}", enabled ? "dynamic rendering" : "render pass rendering");
+
     }
 
     void Engine::make_command_pool ( ) {
@@ -146,7 +205,7 @@ namespace engine {
 
     }
 
-    void Engine::apply_camera_transformation (uint32_t index) {
+    void Engine::apply_camera_transformation (uint32_t index, const glm::mat4x4& dequantization) {
 
         SCOPED_PERF_LOG;
 
@@ -157,22 +216,40 @@ namespace engine {
 
         float delta = std::chrono::duration<float, std::chrono::seconds::period>(start - current).count();
 
+        auto model = glm::rotate(glm::mat4(1.0f), delta / 3 * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        auto pvm = get_view_projection() * model * dequantization;
+
+        constexpr auto stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+        frame.commands.pushConstants(pipeline_layout, stages, offsetof(DrawConstants, pvm), sizeof(glm::mat4x4), &pvm);
+
+    }
+
+    glm::mat4x4 Engine::get_view_projection ( ) const {
+
         auto aspect = static_cast<float>(swapchain->get_extent().width) / static_cast<float>(swapchain->get_extent().height);
-        auto projection = glm::perspective(glm::radians(45.0f), aspect, .1f, 10.0f); projection[1][1] *= -1;
+        auto projection = glm::perspective(glm::radians(field_of_view), aspect, .1f, 10.0f); projection[1][1] *= -1;
 
-        auto ubo = MVPMatrix { 
-            .model = glm::rotate(glm::mat4(1.0f), delta / 3 * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-            .view = glm::lookAt(glm::vec3(2.0f, 1.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.3f), glm::vec3(0.0f, 0.0f, 1.0f)),
-            .projection = projection
-        }; 
+        auto view = glm::lookAt(get_camera_position(), get_camera_target(), glm::vec3(0.0f, 0.0f, 1.0f));
 
-        frame.commands.pushConstants(pipeline_layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(MVPMatrix), &ubo);
+        return projection * view;
 
     }
 
-    void Engine::record_draw_commands (uint32_t index, std::function<void()> draw_callback) {
+    LodSelector Engine::get_lod_selector ( ) const {
+
+        auto height = static_cast<float>(swapchain->get_extent().height);
+
+        return {
+            .pixels_per_unit = settings.lod_threshold > 0 ? height / 2 / std::tan(glm::radians(field_of_view) / 2) : 0,
+            .threshold = settings.lod_threshold
+        };
+
+    }
+
+    void Engine::record_draw_commands (uint32_t index, std::function<void()> prepare_callback, std::function<void()> draw_callback) {
 
         SCOPED_PERF_LOG;
+        auto timer = ScopedTimer([this] (double duration) { record_time = duration; });
 
         const auto& frame = swapchain->get_frames().at(index);
         frame.commands.reset();
@@ -183,21 +260,9 @@ namespace engine {
             loge("Failed to begin command record");
         }
 
-        auto clear_values = std::array {
-            vk::ClearValue { std::array { .1f, .1f, .1f, 1.f } },
-            vk::ClearValue { },
-            vk::ClearValue { .depthStencil = { 1.f, 0 } },
-        };
+        if (prepare_callback) prepare_callback();
 
-        auto renderpass_info = vk::RenderPassBeginInfo {
-            .renderPass = render_pass,
-            .framebuffer = frame.buffer.get(),
-            .renderArea = {{0, 0}, swapchain->get_extent()},
-            .clearValueCount = to_u32(clear_values.size()),
-            .pClearValues = clear_values.data()
-        };
-
-        frame.commands.beginRenderPass(renderpass_info, vk::SubpassContents::eInline);
+        begin_rendering(index);
 
         auto viewport = vk::Viewport {
             .width = static_cast<float>(swapchain->get_extent().width),
@@ -212,7 +277,7 @@ namespace engine {
 
         draw_callback();
 
-        frame.commands.endRenderPass();
+        end_rendering(index);
 
         try {
             frame.commands.end();
@@ -222,8 +287,147 @@ namespace engine {
 
     }
 
+    void Engine::begin_rendering (uint32_t index) {
+
+        using enum vk::PipelineStageFlagBits;
+        using enum vk::ImageLayout;
+        using access = vk::AccessFlagBits;
+
+        const auto& frame = swapchain->get_frames().at(index);
+        const auto& target = swapchain->get_frames().at(frame.index);
+
+        auto clear_color = vk::ClearValue { std::array { .1f, .1f, .1f, 1.f } };
+        auto clear_depth = vk::ClearValue { .depthStencil = { 1.f, 0 } };
+
+        if (!is_dynamic_rendering) {
+
+            auto clear_values = std::array { clear_color, vk::ClearValue { }, clear_depth };
+
+            auto renderpass_info = vk::RenderPassBeginInfo {
+                .renderPass = render_pass,
+                .framebuffer = target.buffer.get(),
+                .renderArea = {{0, 0}, swapchain->get_extent()},
+                .clearValueCount = to_u32(clear_values.size()),
+                .pClearValues = clear_values.data()
+            };
+
+            frame.commands.beginRenderPass(renderpass_info, vk::SubpassContents::eInline);
+            return;
+
+        }
+
+        // Layout transitions the render pass performed implicitly, attachments are shared between frames
+        insert_image_memory_barrier(frame.commands, target.image, vk::ImageAspectFlagBits::eColor,
+            { eColorAttachmentOutput, eColorAttachmentOutput }, { { }, access::eColorAttachmentWrite }, { eUndefined, eColorAttachmentOptimal });
+
+        insert_image_memory_barrier(frame.commands, target.color_buffer->get_handle(), vk::ImageAspectFlagBits::eColor,
+            { eColorAttachmentOutput, eColorAttachmentOutput }, { access::eColorAttachmentWrite, access::eColorAttachmentWrite }, { eUndefined, eColorAttachmentOptimal });
+
+        insert_image_memory_barrier(frame.commands, target.depth_buffer->get_handle(), depth_aspect,
+            { eLateFragmentTests, eEarlyFragmentTests | eLateFragmentTests },
+            { access::eDepthStencilAttachmentWrite, access::eDepthStencilAttachmentRead | access::eDepthStencilAttachmentWrite },
+            { eUndefined, eDepthStencilAttachmentOptimal });
+
+        auto color_attachment = vk::RenderingAttachmentInfo {
+            .imageView = target.color_buffer->get_view(),
+            .imageLayout = eColorAttachmentOptimal,
+            .resolveMode = vk::ResolveModeFlagBits::eAverage,
+            .resolveImageView = target.view.get(),
+            .resolveImageLayout = eColorAttachmentOptimal,
+            .loadOp = vk::AttachmentLoadOp::eClear,
+            .storeOp = vk::AttachmentStoreOp::eDontCare,
+            .clearValue = clear_color
+        };
+
+        auto depth_attachment = vk::RenderingAttachmentInfo {
+            .imageView = target.depth_buffer->get_view(),
+            .imageLayout = eDepthStencilAttachmentOptimal,
+            .loadOp = vk::AttachmentLoadOp::eClear,
+            .storeOp = vk::AttachmentStoreOp::eDontCare,
+            .clearValue = clear_depth
+        };
+
+        auto rendering_info = vk::RenderingInfo {
+            .renderArea = {{0, 0}, swapchain->get_extent()},
+            .layerCount = 1,
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &color_attachment,
+            .pDepthAttachment = &depth_attachment
+        };
+
+        frame.commands.beginRendering(rendering_info);
+
+    }
+
+    void Engine::end_rendering (uint32_t index) {
+
+        using enum vk::PipelineStageFlagBits;
+        using enum vk::ImageLayout;
+
+        const auto& frame = swapchain->get_frames().at(index);
+
+        if (!is_dynamic_rendering) {
+            frame.commands.endRenderPass();
+            return;
+        }
+
+        frame.commands.endRendering();
+
+        insert_image_memory_barrier(frame.commands, swapchain->get_frames().at(frame.index).image, vk::ImageAspectFlagBits::eColor,
+            { eColorAttachmentOutput, eBottomOfPipe }, { vk::AccessFlagBits::eColorAttachmentWrite, { } },
+            { eColorAttachmentOptimal, ePresentSrcKHR });
+
+    }
+
     void Engine::draw (std::shared_ptr<Object> object) {
 
+        render_frame(nullptr, [&] (const vk::CommandBuffer& commands) {
+            TextureTable::bind(commands, pipeline_layout);
+            apply_camera_transformation(current_frame, object->model.get_dequantization());
+            object->bind(commands, get_pipeline(object->model.get_layout()), pipeline_layout);
+            object->draw(commands);
+        });
+
+    }
+
+    void Engine::draw (std::shared_ptr<Scene> scene) {
+
+        auto view_projection = get_view_projection();
+
+        render_frame(
+            [&] (const vk::CommandBuffer& commands) { scene->record_cull(commands, current_frame, view_projection); },
+            [&] (const vk::CommandBuffer& commands) { scene->draw(commands, current_frame, view_projection, get_target_render_pass()); }
+        );
+
+    }
+
+    void Engine::draw (std::shared_ptr<InstanceBatcher> batcher) {
+
+        auto view_projection = get_view_projection();
+
+        auto lod_selector = get_lod_selector();
+
+        render_frame(nullptr, [&] (const vk::CommandBuffer& commands) {
+            batcher->draw(commands, current_frame, view_projection, lod_selector, get_target_render_pass());
+        });
+
+    }
+
+    void Engine::draw (std::shared_ptr<ClusterRenderer> renderer) {
+
+        auto view_projection = get_view_projection();
+        auto camera_position = get_camera_position();
+
+        render_frame(
+            [&] (const vk::CommandBuffer& commands) { renderer->record_cull(commands, current_frame, view_projection, camera_position); },
+            [&] (const vk::CommandBuffer& commands) { renderer->draw(commands, current_frame, view_projection, get_target_render_pass()); }
+        );
+
+    }
+
+    void Engine::render_frame (std::function<void(const vk::CommandBuffer&)> prepare_callback,
+        std::function<void(const vk::CommandBuffer&)> draw_callback) {
+
         fps_limiter.delay();
 
         SCOPED_PERF_LOG;
@@ -239,19 +443,28 @@ namespace engine {
             is_settings_changed = false;
         }
 
+        if (shader_watcher)
+            for (const auto& shader_path : shader_watcher->take_changes()) {
+                ShaderArchive::invalidate(shader_path);
+                PipelineRegistry::reload(shader_path);
+            }
+
+        PipelineRegistry::update();
+
         particle_system->record_compute_commands(current_frame);
         particle_system->compute_submit(current_frame);
 
         auto& frame = swapchain->get_frames().at(current_frame);
         frame.index = swapchain->acquire_image(current_frame);
+        DescriptorAllocator::reset_frame(current_frame);
+        TextureTable::reset_frame(current_frame);
 
-        record_draw_commands(current_frame, [&] {
+        auto prepare = [&] { prepare_callback(frame.commands); };
 
-            particle_system->draw(current_frame, frame.commands);
+        record_draw_commands(current_frame, prepare_callback ? prepare : std::function<void()>(), [&] {
 
-            apply_camera_transformation(current_frame);
-            object->bind(frame.commands, pipeline, pipeline_layout);
-            object->draw(frame.commands);
+            particle_system->draw(current_frame, frame.commands);
+            draw_callback(frame.commands);
 
             if (is_imgui_enabled && settings.gui_visible) {
                 UI::new_frame();
@@ -265,6 +478,12 @@ namespace engine {
         if (!swapchain->present_image(current_frame))
             { current_frame = 0; return; }
 
+        if (is_first_frame) {
+            auto duration = std::chrono::high_resolution_clock::now() - startup_time;
+            logi("Time to first frame: {:.3f}ms", std::chrono::duration<double, std::milli>(duration).count());
+            is_first_frame = false;
+        }
+
         current_frame = (current_frame + 1) % max_frames_in_flight;
 
     }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <chrono>
 #include <functional>
 #include <memory>
 
@@ -9,6 +11,13 @@
 #include "core/device.hpp"
 #include "core/swapchain.hpp"
 #include "core/model.hpp"
+#include "core/pipeline.hpp"
+#include "core/shader_watcher.hpp"
+
+#include "scene.hpp"
+#include "cluster_renderer.hpp"
+#include "instance_batcher.hpp"
+#include "scene_graph.hpp"
 
 #include "ui_overlay.hpp"
 #include "particle_system.hpp"
@@ -20,28 +29,29 @@ namespace engine {
 
     struct Object {
 
-        Object (std::string_view texture_path, std::string_view model_path)
-            : texture(texture_path), model(model_path) { };
+        Object (std::string_view texture_path, std::string_view model_path, VertexLayout layout = VertexLayout::automatic)
+            : texture(texture_path), model(model_path, layout) { };
 
-        Object (std::string_view texture_path, std::span<Vertex> vertices, std::span<uint16_t> indices)
-            : texture(texture_path), model(vertices, indices) { };
+        Object (std::string_view texture_path, std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+            VertexLayout layout = VertexLayout::automatic) : texture(texture_path), model(vertices, indices, layout) { };
 
         Texture texture;
         Model model;
 
         constexpr void bind (const vk::CommandBuffer& commands, const vk::Pipeline& pipeline, const vk::PipelineLayout& layout) {
 
-            auto offsets = std::array<vk::DeviceSize, 1> { }; 
+            auto texture_index = texture.get_index();
+            constexpr auto stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+
             commands.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
-            commands.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, 1, &texture.get_descriptor_set(), 0, nullptr);
-            commands.bindVertexBuffers(0, 1, &model.get_vertex(), offsets.data());
-            commands.bindIndexBuffer(model.get_index(), 0, vk::IndexType::eUint16);
+            commands.pushConstants(layout, stages, offsetof(DrawConstants, texture_index), sizeof(uint32_t), &texture_index);
+            model.bind(commands);
 
         }
 
         constexpr void draw (const vk::CommandBuffer& commands) {
 
-            commands.drawIndexed(model.get_indices_count(), 1, 0, 0, 0);
+            model.draw(commands);
 
         }
 
@@ -52,8 +62,12 @@ namespace engine {
         bool vsync = false;
         bool gui_visible = false;
         int fps_limit = -1;
+        bool additive_particles = false;
+        bool cpu_particles = false;
+        bool dynamic_rendering = false;
+        float lod_threshold = 1.0f; // pixels a level of detail may deviate on screen, 0 draws full detail
 
-        GLZ_LOCAL_META(Settings, vsync, gui_visible, fps_limit);
+        GLZ_LOCAL_META(Settings, vsync, gui_visible, fps_limit, additive_particles, cpu_particles, dynamic_rendering, lod_threshold);
     };
 
     class Engine {
@@ -61,6 +75,9 @@ namespace engine {
         uint32_t max_frames_in_flight, current_frame = 0;
         bool is_imgui_enabled = true;
 
+        std::chrono::high_resolution_clock::time_point startup_time;
+        bool is_first_frame = true;
+
         Settings settings;
         bool is_settings_changed = true;
         FPSLimiter fps_limiter;
@@ -73,22 +90,41 @@ namespace engine {
         std::unique_ptr<UI> ui;
         std::unique_ptr<ParticleSystem> particle_system;
         std::unique_ptr<SwapChain> swapchain;
+        std::unique_ptr<ShaderWatcher> shader_watcher;
 
-        vk::Pipeline pipeline;
+        // One per vertex layout, built in the background together
+        std::array<std::shared_ptr<PipelineHandle>, vertex_layout_count> pipelines;
         vk::RenderPass render_pass;
         vk::PipelineLayout pipeline_layout;
-        vk::DescriptorSetLayout descriptor_set_layout;
+
+        bool is_dynamic_rendering = false;
+        vk::ImageAspectFlags depth_aspect;
 
         vk::Queue queue;
         vk::CommandPool command_pool;
 
         void setup_particles ( );
 
+        void make_pipeline ( );
+        vk::Pipeline get_pipeline (VertexLayout layout) const { return pipelines.at(static_cast<std::size_t>(layout))->get(); }
+        void set_dynamic_rendering (bool enabled);
+        constexpr vk::RenderPass get_target_render_pass ( ) const { return is_dynamic_rendering ? vk::RenderPass() : render_pass; }
+
         void make_command_pool ( );
         void make_command_buffers ( );
         
-        void apply_camera_transformation (uint32_t index);
-        void record_draw_commands (uint32_t index, std::function<void()> draw_callback);
+        double record_time = 0;
+
+        static constexpr float field_of_view = 45.0f; // degrees, vertical
+
+        glm::mat4x4 get_view_projection ( ) const;
+        LodSelector get_lod_selector ( ) const;
+        void apply_camera_transformation (uint32_t index, const glm::mat4x4& dequantization);
+        void record_draw_commands (uint32_t index, std::function<void()> prepare_callback, std::function<void()> draw_callback);
+        void render_frame (std::function<void(const vk::CommandBuffer&)> prepare_callback,
+            std::function<void(const vk::CommandBuffer&)> draw_callback);
+        void begin_rendering (uint32_t index);
+        void end_rendering (uint32_t index);
         void submit (uint32_t index);
 
     public:
@@ -104,6 +140,9 @@ namespace engine {
 
             if constexpr (key == "vsync"_fs) settings.vsync = value;
             if constexpr (key == "fps_limit"_fs) settings.fps_limit = value;
+            if constexpr (key == "additive_particles"_fs) settings.additive_particles = value;
+            if constexpr (key == "dynamic_rendering"_fs) settings.dynamic_rendering = value;
+            if constexpr (key == "lod_threshold"_fs) settings.lod_threshold = value;
 
             if constexpr (key == "gui_visible"_fs) { 
                 if (is_imgui_enabled) settings.gui_visible = value;
@@ -121,6 +160,16 @@ namespace engine {
         ~Engine ( );
 
         void draw (std::shared_ptr<Object> object);
+        void draw (std::shared_ptr<Scene> scene);
+        void draw (std::shared_ptr<InstanceBatcher> batcher);
+        void draw (std::shared_ptr<ClusterRenderer> renderer);
+
+        // The fixed camera frames are rendered from
+        glm::vec3 get_camera_position ( ) const { return glm::vec3(2.0f, 1.0f, 2.0f); }
+        glm::vec3 get_camera_target ( ) const { return glm::vec3(0.0f, 0.0f, 0.3f); }
+
+        // CPU time spent recording the last frame's command buffer
+        constexpr double get_record_time ( ) const { return record_time; }
 
     };
 
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include "instance_batcher.hpp"
+#include "engine.hpp"
+
+#include "core/layout_cache.hpp"
+#include "core/pipeline_registry.hpp"
+#include "core/texture_table.hpp"
+
+#include "utils/utils.hpp"
+#include "utils/logging.hpp"
+
+namespace engine {
+
+    InstanceBatcher::InstanceBatcher ( ) {
+
+        pipeline_layout = LayoutCache::get_pipeline_layout("shaders/instanced");
+
+    }
+
+    InstanceBatcher::~InstanceBatcher ( ) {
+
+        // Frames in flight may still read the instance buffers
+        device->get_handle().waitIdle();
+
+        pipelines = { };
+
+    }
+
+    void InstanceBatcher::submit (std::shared_ptr<Object> object, const glm::mat4x4& transform, uint64_t id) {
+
+        auto [index, inserted] = batch_indices.try_emplace(object.get(), batches.size());
+        if (inserted) batches.push_back({ .source = object });
+
+        auto& batch = batches.at(index->second);
+
+        // A destroyed object's address may be taken by a new one, whose instances start without history
+        if (batch.source.lock() != object) batch = { .source = object };
+
+        batch.object = object;
+        batch.transforms.push_back(transform);
+        batch.ids.push_back(id);
+
+    }
+
+    void InstanceBatcher::clear ( ) {
+
+        for (auto& batch : batches) {
+            batch.object.reset();
+            batch.transforms.clear();
+            batch.ids.clear();
+        }
+
+        if (std::ranges::none_of(batches, [] (const Batch& batch) { return batch.source.expired(); })) return;
+
+        std::erase_if(batches, [] (const Batch& batch) { return batch.source.expired(); });
+
+        batch_indices.clear();
+        for (std::size_t i = 0; i < batches.size(); ++i) batch_indices.emplace(batches[i].source.lock().get(), i);
+
+    }
+
+    std::size_t InstanceBatcher::get_instance_count ( ) const {
+
+        return std::accumulate(batches.begin(), batches.end(), std::size_t(0),
+            [] (std::size_t sum, const Batch& batch) { return sum + batch.transforms.size(); });
+
+    }
+
+    void InstanceBatcher::make_pipeline (vk::RenderPass render_pass) {
+
+        auto sample_count = get_max_sample_count(device->get_gpu());
+
+        this->render_pass = render_pass;
+
+        for (std::size_t i = 0; i < vertex_layout_count; ++i) {
+            auto layout = static_cast<VertexLayout>(i);
+            pipelines.at(i) = PipelineRegistry::acquire({
+                .binding_description = get_binding_description(layout),
+                .attribute_descriptions = get_attribute_descriptions(layout),
+                .instance_binding_description = InstanceData::get_binding_description(),
+                .instance_attribute_descriptions = InstanceData::get_attribute_descriptions(),
+                .multisampling_info = create_multisampling_info(sample_count, true),
+                .layout = pipeline_layout,
+                .render_pass = render_pass,
+                .shader_path = "shaders/instanced"
+            });
+        }
+
+    }
+
+    void InstanceBatcher::upload (InstanceFrame& frame) {
+
+        // Instances compared and written at once, static content is only compared after its first frames
+        constexpr std::size_t range_size = 64;
+
+        auto mapped = static_cast<InstanceData*>(frame.buffer->get_mapped());
+        auto valid_count = std::min(frame.uploaded.size(), instances.size());
+        auto written = std::size_t(0);
+        auto first_written = instances.size(), last_written = std::size_t(0);
+
+        frame.uploaded.resize(instances.size());
+
+        for (std::size_t first = 0; first < instances.size(); first += range_size) {
+
+            auto count = std::min(range_size, instances.size() - first);
+            auto bytes = count * sizeof(InstanceData);
+
+            if (first + count <= valid_count && !std::memcmp(instances.data() + first, frame.uploaded.data() + first, bytes)) continue;
+
+            std::memcpy(mapped + first, instances.data() + first, bytes);
+            std::memcpy(frame.uploaded.data() + first, instances.data() + first, bytes);
+            written += bytes;
+
+            first_written = std::min(first_written, first);
+            last_written = first + count;
+
+        }
+
+        // One flush over the span of the written ranges, a no-op on coherent memory
+        if (written) frame.buffer->flush(first_written * sizeof(InstanceData), (last_written - first_written) * sizeof(InstanceData));
+
+        perf_statistics["Instance bytes written"] = written;
+
+    }
+
+    void InstanceBatcher::draw (const vk::CommandBuffer& commands, uint32_t index, const glm::mat4x4& view_projection,
+        const LodSelector& lod_selector, vk::RenderPass render_pass) {
+
+        SCOPED_PERF_LOG;
+
+        draw_count = 0;
+        triangle_count = 0;
+
+        if (batches.empty()) return;
+        if (!pipelines.front() || render_pass != this->render_pass) make_pipeline(render_pass);
+
+        instances.resize(get_instance_count());
+        auto size = instances.size() * sizeof(InstanceData);
+
+        if (index >= instance_frames.size()) instance_frames.resize(index + 1);
+
+        auto& frame = instance_frames.at(index);
+        if (!frame.buffer || frame.buffer->get_size() < size) {
+            frame.buffer = std::make_unique<Buffer>(std::bit_ceil(size), vk::BufferUsageFlagBits::eVertexBuffer, true);
+            frame.uploaded.clear();
+        }
+
+        constexpr auto stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+        auto offsets = std::array<vk::DeviceSize, 1> { };
+
+        // Every layout shares the pipeline layout, so descriptors and push constants survive pipeline switches
+        auto bound_layout = VertexLayout::full;
+
+        commands.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.front()->get());
+        TextureTable::bind(commands, pipeline_layout);
+        commands.pushConstants(pipeline_layout, stages, 0, sizeof(glm::mat4x4), &view_projection);
+        commands.bindVertexBuffers(1, 1, &frame.buffer->get_handle(), offsets.data());
+
+        auto bind = [&] (const Object& object) {
+            if (auto layout = object.model.get_layout(); layout != bound_layout) {
+                commands.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.at(static_cast<std::size_t>(layout))->get());
+                bound_layout = layout;
+            }
+            auto texture_index = object.texture.get_index();
+            commands.pushConstants(pipeline_layout, stages, offsetof(DrawConstants, texture_index), sizeof(uint32_t), &texture_index);
+            object.model.bind(commands);
+        };
+
+        // Batches are packed back to back and sorted by level of detail inside, each draw selects its range through firstInstance
+        auto first_instance = uint32_t(0);
+
+        for (auto& batch : batches) {
+
+            if (batch.transforms.empty()) continue;
+
+            const auto& model = batch.object->model;
+            auto sphere = model.get_bounding_sphere();
+            auto center = glm::vec4(glm::vec3(sphere), 1.f);
+            auto last_lod = to_u32(model.get_lods().size() - 1);
+
+            batch.lods.resize(batch.transforms.size(), 0);
+
+            auto has_ids = std::ranges::any_of(batch.ids, [] (uint64_t id) { return id != no_id; });
+
+            if (has_ids) for (std::size_t i = 0; i < batch.ids.size(); ++i)
+                if (auto found = batch.id_lods.find(batch.ids[i]); found != batch.id_lods.end()) batch.lods[i] = found->second;
+
+            auto level_counts = std::array<uint32_t, max_lod_count> { };
+
+            for (std::size_t i = 0; i < batch.transforms.size(); ++i) {
+
+                const auto& transform = batch.transforms[i];
+
+                // Clip space w is the view depth, measured to the near side of the bounding sphere
+                auto scale = std::sqrt(std::max({ glm::dot(transform[0], transform[0]), glm::dot(transform[1], transform[1]),
+                    glm::dot(transform[2], transform[2]) }));
+                auto depth = (view_projection * (transform * center)).w;
+                auto radius = sphere.w * scale;
+
+                if (depth + radius < 0) batch.lods[i] = last_lod;
+                else batch.lods[i] = lod_selector.select(model.get_lods(), scale, std::max(depth - radius, 1e-3f), batch.lods[i]);
+
+                ++level_counts[batch.lods[i]];
+
+            }
+
+            // Only ids submitted this frame are kept, the history of removed instances goes with them
+            if (has_ids) {
+                batch.id_lods.clear();
+                for (std::size_t i = 0; i < batch.ids.size(); ++i)
+                    if (batch.ids[i] != no_id) batch.id_lods[batch.ids[i]] = batch.lods[i];
+            }
+
+            auto level_offsets = std::array<uint32_t, max_lod_count> { };
+            std::exclusive_scan(level_counts.begin(), level_counts.end(), level_offsets.begin(), first_instance);
+
+            auto cursors = level_offsets;
+            for (std::size_t i = 0; i < batch.transforms.size(); ++i)
+                instances[cursors[batch.lods[i]]++] = { .transform = batch.transforms[i] * model.get_dequantization() };
+
+            if (is_batching) bind(*batch.object);
+
+            for (uint32_t lod = 0; lod <= last_lod; ++lod) {
+
+                auto count = level_counts[lod];
+                if (!count) continue;
+
+                if (is_batching) {
+                    model.draw(commands, count, level_offsets[lod], lod);
+                    draw_count += model.get_submeshes(lod).size();
+                } else for (uint32_t i = 0; i < count; ++i) {
+                    bind(*batch.object);
+                    model.draw(commands, 1, level_offsets[lod] + i, lod);
+                    draw_count += model.get_submeshes(lod).size();
+                }
+
+                triangle_count += model.get_triangle_count(lod) * count;
+
+            }
+
+            first_instance += to_u32(batch.transforms.size());
+
+        }
+
+        upload(frame);
+
+        perf_statistics["Draw calls"] = draw_count;
+        perf_statistics["Triangles drawn"] = triangle_count;
+
+    }
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "core/device.hpp"
+#include "core/memory.hpp"
+#include "core/model.hpp"
+#include "core/pipeline.hpp"
+#include "core/vertex_layout.hpp"
+
+#include "utils/primitives.hpp"
+
+namespace engine {
+
+    struct Object;
+
+    // Collects transforms of objects and draws all instances of an object with one instanced draw call.
+    // An object couples one mesh and one texture, so identical mesh and material pairs share a batch
+    class InstanceBatcher {
+
+        // Batches are found by the address of their object and live as long as it does, the reference held
+        // while instances are submitted is dropped by clear() so the batcher never keeps an object alive
+        struct Batch {
+            std::weak_ptr<Object> source;
+            std::shared_ptr<Object> object;
+            std::vector<glm::mat4x4> transforms;
+            std::vector<uint64_t> ids;
+            std::vector<uint8_t> lods; // level each instance was drawn at last, the starting point of the next selection
+            std::unordered_map<uint64_t, uint8_t> id_lods; // the same for instances submitted with an id
+        };
+
+        std::shared_ptr<Device> device = Device::get();
+
+        std::vector<Batch> batches;
+        std::unordered_map<const Object*, std::size_t> batch_indices;
+
+        // Per frame in flight, grown when the submitted instances no longer fit. What was last written to the
+        // buffer is kept on the CPU so only ranges that changed since are written again
+        struct InstanceFrame {
+            std::unique_ptr<Buffer> buffer;
+            std::vector<InstanceData> uploaded;
+        };
+
+        std::vector<InstanceFrame> instance_frames;
+        std::vector<InstanceData> instances; // packed for the frame being drawn
+
+        vk::PipelineLayout pipeline_layout;
+        std::array<std::shared_ptr<PipelineHandle>, vertex_layout_count> pipelines;
+        vk::RenderPass render_pass;
+
+        bool is_batching = true;
+        std::size_t draw_count = 0;
+        std::size_t triangle_count = 0;
+
+        void make_pipeline (vk::RenderPass render_pass);
+        void upload (InstanceFrame& frame);
+
+        public:
+
+        InstanceBatcher ( );
+        ~InstanceBatcher ( );
+
+        static constexpr uint64_t no_id = std::numeric_limits<uint64_t>::max();
+
+        // Instances stay submitted until clear(), static content only has to be submitted once. The LOD history
+        // of an instance outlives clear(), it follows the id when one is given and the submission order otherwise
+        void submit (std::shared_ptr<Object> object, const glm::mat4x4& transform, uint64_t id = no_id);
+
+        // Also forgets the batches of objects destroyed since
+        void clear ( );
+
+        // Every instance is drawn at the level of detail picked by the selector, the model's dequantization
+        // is folded into the transforms as they are written
+        void draw (const vk::CommandBuffer& commands, uint32_t index, const glm::mat4x4& view_projection,
+            const LodSelector& lod_selector, vk::RenderPass render_pass);
+
+        // Without batching every instance gets its own binds and draw call, kept to measure the difference
+        constexpr void set_batching (bool enabled) { is_batching = enabled; }
+
+        constexpr std::size_t get_draw_count ( ) const { return draw_count; }
+        constexpr std::size_t get_triangle_count ( ) const { return triangle_count; }
+        std::size_t get_instance_count ( ) const;
+
+    };
+
+}
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <execution>
+#include <thread>
+
+#include "particle_simulator.hpp"
+
+#include "utils/logging.hpp"
+
+namespace engine {
+
+    ParticleSimulator::ParticleSimulator (std::span<const Particle> particles) {
+
+        auto size = particles.size();
+
+        position_x.resize(size); position_y.resize(size);
+        velocity_x.resize(size); velocity_y.resize(size);
+        colors.resize(size);
+
+        for (std::size_t i = 0; i < size; i++) {
+            position_x.at(i) = particles[i].position.x;
+            position_y.at(i) = particles[i].position.y;
+            velocity_x.at(i) = particles[i].velocity.x;
+            velocity_y.at(i) = particles[i].velocity.y;
+            colors.at(i) = particles[i].color;
+        }
+
+        auto threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+        chunk_size = std::max(min_chunk_size, size / (threads * 4));
+
+        for (std::size_t begin = 0; begin < size; begin += chunk_size)
+            chunks.push_back(begin);
+
+    }
+
+    void ParticleSimulator::step_chunk (std::size_t begin, std::size_t end, float delta) {
+
+        auto px = position_x.data(), py = position_y.data();
+        auto vx = velocity_x.data(), vy = velocity_y.data();
+
+        // Branchless on purpose, the selects below compile to vector blends
+        for (std::size_t i = begin; i < end; i++) {
+
+            float x = px[i] + vx[i] * delta;
+            float y = py[i] + vy[i] * delta;
+
+            px[i] = x; py[i] = y;
+
+            vx[i] = (x <= -1.f || x >= 1.f) ? -vx[i] : vx[i];
+            vy[i] = (y <= -1.f || y >= 1.f) ? -vy[i] : vy[i];
+
+        }
+
+    }
+
+    void ParticleSimulator::step (float delta) {
+
+        SCOPED_PERF_LOG;
+
+        std::for_each(std::execution::par_unseq, chunks.begin(), chunks.end(), [this, delta] (std::size_t begin) {
+            step_chunk(begin, std::min(begin + chunk_size, get_size()), delta);
+        });
+
+    }
+
+    void ParticleSimulator::write (std::span<Particle> output) const {
+
+        auto size = std::min(output.size(), get_size());
+
+        for (std::size_t i = 0; i < size; i++) {
+            output[i].position = { position_x[i], position_y[i] };
+            output[i].velocity = { velocity_x[i], velocity_y[i] };
+            output[i].color = colors[i];
+        }
+
+    }
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "utils/primitives.hpp"
+
+namespace engine {
+
+    // CPU implementation of shaders/particles.comp, keeps particles as SoA so the
+    // update loop vectorizes and splits into chunks processed in parallel
+    class ParticleSimulator {
+
+        static constexpr std::size_t min_chunk_size = 256;
+
+        // About four chunks per hardware thread, so the parallel loop balances without chunks too small to vectorize
+        std::size_t chunk_size;
+
+        std::vector<float> position_x, position_y;
+        std::vector<float> velocity_x, velocity_y;
+        std::vector<glm::vec4> colors;
+
+        std::vector<std::size_t> chunks;
+
+        void step_chunk (std::size_t begin, std::size_t end, float delta);
+
+        public:
+
+        ParticleSimulator (std::span<const Particle> particles);
+
+        void step (float delta);
+        void write (std::span<Particle> output) const;
+
+        constexpr const std::size_t get_size ( ) const { return colors.size(); }
+        constexpr const std::size_t get_chunk_count ( ) const { return chunks.size(); }
+
+    };
+
+}
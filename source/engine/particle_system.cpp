@@ -1,14 +1,91 @@
+#include <fstream>
 #include <random>
 
 #include "particle_system.hpp"
 
+#include "core/descriptor_allocator.hpp"
+#include "core/layout_cache.hpp"
+#include "core/shaders.hpp"
+
 #include "utils/utils.hpp"
 #include "utils/logging.hpp"
 
 namespace engine {
 
-    ParticleSystem::ParticleSystem (uint32_t frames_in_flight, const vk::RenderPass& render_pass)
-        : frames_in_flight(frames_in_flight), render_pass(render_pass) {
+    namespace {
+
+        constexpr auto workgroup_cache_path = "particles_workgroup.bin";
+
+        // Workgroup size picked by autotuning, only reused on the device, driver and shader code it was measured with
+        struct WorkgroupCache {
+            uint32_t magic = 0x4B475750;
+            uint32_t vendor_id;
+            uint32_t device_id;
+            uint32_t driver_version;
+            uint64_t shader_hash;
+            uint32_t workgroup_size;
+        };
+
+        WorkgroupCache make_workgroup_cache (const vk::PhysicalDeviceProperties& properties, uint32_t workgroup_size = 0) {
+
+            return WorkgroupCache {
+                .vendor_id = properties.vendorID,
+                .device_id = properties.deviceID,
+                .driver_version = properties.driverVersion,
+                .shader_hash = Shader::hash_code("shaders/particles"),
+                .workgroup_size = workgroup_size
+            };
+
+        }
+
+        std::optional<uint32_t> read_workgroup_cache (const vk::PhysicalDeviceProperties& properties) {
+
+            auto file = std::ifstream(workgroup_cache_path, std::ios::binary);
+            auto cache = WorkgroupCache();
+
+            if (!file.read(reinterpret_cast<char*>(&cache), sizeof(cache))) return std::nullopt;
+
+            auto expected = make_workgroup_cache(properties);
+            const auto& limits = properties.limits;
+
+            bool valid = cache.magic == expected.magic
+                && cache.vendor_id == expected.vendor_id
+                && cache.device_id == expected.device_id
+                && cache.driver_version == expected.driver_version
+                && cache.shader_hash == expected.shader_hash
+                && cache.workgroup_size > 0
+                && cache.workgroup_size <= limits.maxComputeWorkGroupSize.at(0)
+                && cache.workgroup_size <= limits.maxComputeWorkGroupInvocations;
+
+            if (!valid) return std::nullopt;
+
+            return cache.workgroup_size;
+
+        }
+
+        void write_workgroup_cache (const vk::PhysicalDeviceProperties& properties, uint32_t workgroup_size) {
+
+            auto file = std::ofstream(workgroup_cache_path, std::ios::binary | std::ios::trunc);
+
+            if (!file.is_open()) { logw("Failed to open {} for writing", workgroup_cache_path); return; }
+
+            auto cache = make_workgroup_cache(properties, workgroup_size);
+            file.write(reinterpret_cast<const char*>(&cache), sizeof(cache));
+
+        }
+
+    }
+
+    ParticleSystem::ParticleSystem (uint32_t frames_in_flight, const vk::RenderPass& render_pass, ParticleBackend backend)
+        : frames_in_flight(frames_in_flight), render_pass(render_pass), backend(backend) {
+
+        auto indices = get_queue_family_indices(device->get_gpu(), device->get_surface());
+        auto queue_families = device->get_gpu().getQueueFamilyProperties();
+
+        if (!(queue_families.at(indices.graphics_family.value()).queueFlags & vk::QueueFlagBits::eCompute)) {
+            logw("Graphics queue does not support compute, falling back to CPU particles");
+            this->backend = ParticleBackend::eCPU;
+        }
 
         fill_particles();
         prepare_buffers();
@@ -16,57 +93,82 @@ namespace engine {
         make_command_pool();
         make_command_buffers();
 
-        make_descriptor_set_layout();
+        auto reflection = Shader::reflect("shaders/particles");
+
+        descriptor_set_layout = LayoutCache::get_set_layout(reflection.descriptor_sets.at(0));
         make_descriptor_set();
 
-        auto push_constant_range = vk::PushConstantRange {
-            .stageFlags = vk::ShaderStageFlagBits::eCompute,
-            .offset = 0,
-            .size = sizeof(float)
-        };
+        compute_layout = LayoutCache::get_pipeline_layout(reflection);
 
-        compute_layout = create_pipeline_layout(&descriptor_set_layout.get(), &push_constant_range);
-        compute_pipeline = create_compute_pipeline(compute_layout, "shaders/particles");
+        workgroup_size = reflection.workgroup_size.at(0);
+        if (this->backend == ParticleBackend::eGPU) workgroup_size = autotune_workgroup_size(workgroup_size);
 
-        graphics_layout = create_pipeline_layout();
-        auto sample_count = get_max_sample_count(device->get_gpu());
-        graphics_pipeline = create_pipeline({
-            .binding_description = Particle::get_binding_description(),
-            .attribute_descriptions = Particle::get_attribute_descriptions(),
-            .input_assembly_info = create_input_assembly_info(vk::PrimitiveTopology::ePointList),
-            .multisampling_info = create_multisampling_info(sample_count, true),
-            .depth_stencil_info = create_depth_stencil_info(false, false),
-            .color_blend_attachment = create_color_blend_attachment(true,
-                { vk::BlendFactor::eSrcAlpha,  vk::BlendFactor::eOneMinusSrcAlpha }, vk::BlendOp::eAdd,
-                { vk::BlendFactor::eOneMinusSrcAlpha,  vk::BlendFactor::eDstAlpha }, vk::BlendOp::eAdd
-            ),
-            .layout = graphics_layout,
-            .render_pass = render_pass,
-            .shader_path = "shaders/g_particles"
-        });
+        auto specialization = Specialization().set(0, workgroup_size);
+        compute_pipeline = PipelineRegistry::acquire_compute(compute_layout, "shaders/particles", specialization);
+
+        graphics_layout = LayoutCache::get_pipeline_layout("shaders/g_particles");
+        ordered_pipeline = make_graphics_pipeline(ParticleBlending::eOrdered);
+        additive_pipeline = make_graphics_pipeline(ParticleBlending::eAdditive);
 
         for (uint32_t i = 0; i < frames_in_flight; i++) {
             fences.push_back(make_fence(device->get_handle()));
             semaphores.push_back(make_semaphore(device->get_handle()));
         }
 
-        auto indices = get_queue_family_indices(device->get_gpu(), device->get_surface());
         queue = device->get_handle().getQueue(indices.graphics_family.value(), 0);
 
     }
 
     ParticleSystem::~ParticleSystem ( ) {
 
-        device->get_handle().destroyPipeline(compute_pipeline);
-        device->get_handle().destroyPipelineLayout(compute_layout);
-
-        device->get_handle().destroyPipeline(graphics_pipeline);
-        device->get_handle().destroyPipelineLayout(graphics_layout);
+        compute_pipeline.reset();
+        ordered_pipeline.reset();
+        additive_pipeline.reset();
 
         device->get_handle().destroyCommandPool(command_pool);
 
     }
 
+    std::shared_ptr<PipelineHandle> ParticleSystem::make_graphics_pipeline (ParticleBlending mode) {
+
+        // Particles are drawn in screen space at a fixed depth, so there is no view depth to sort them by.
+        // The additive mode uses a commutative blend equation instead, color is accumulated weighted by
+        // alpha so the result doesn't depend on the order particles are drawn in. Destination alpha is left as it is
+        auto color_blend_attachment = create_color_blend_attachment(true,
+            { vk::BlendFactor::eSrcAlpha,  vk::BlendFactor::eOneMinusSrcAlpha }, vk::BlendOp::eAdd,
+            { vk::BlendFactor::eOneMinusSrcAlpha,  vk::BlendFactor::eDstAlpha }, vk::BlendOp::eAdd
+        );
+
+        if (mode == ParticleBlending::eAdditive)
+            color_blend_attachment = create_color_blend_attachment(true,
+                { vk::BlendFactor::eSrcAlpha,  vk::BlendFactor::eOne }, vk::BlendOp::eAdd,
+                { vk::BlendFactor::eZero,  vk::BlendFactor::eOne }, vk::BlendOp::eAdd
+            );
+
+        auto sample_count = get_max_sample_count(device->get_gpu());
+
+        return PipelineRegistry::acquire({
+            .binding_description = Particle::get_binding_description(),
+            .attribute_descriptions = Particle::get_attribute_descriptions(),
+            .input_assembly_info = create_input_assembly_info(vk::PrimitiveTopology::ePointList),
+            .multisampling_info = create_multisampling_info(sample_count, true),
+            .depth_stencil_info = create_depth_stencil_info(false, false),
+            .color_blend_attachment = color_blend_attachment,
+            .layout = graphics_layout,
+            .render_pass = render_pass,
+            .shader_path = "shaders/g_particles"
+        });
+
+    }
+
+    void ParticleSystem::set_render_pass (vk::RenderPass render_pass) {
+
+        this->render_pass = render_pass;
+        ordered_pipeline = make_graphics_pipeline(ParticleBlending::eOrdered);
+        additive_pipeline = make_graphics_pipeline(ParticleBlending::eAdditive);
+
+    }
+
     void ParticleSystem::fill_particles ( ) {
 
         auto random_device = std::random_device{}();
@@ -105,6 +207,113 @@ namespace engine {
             buffers.push_back(buffer);
         }
 
+        if (backend != ParticleBackend::eCPU) return;
+
+        simulator = std::make_unique<ParticleSimulator>(particles);
+
+        for (uint32_t i = 0; i < frames_in_flight; i++)
+            staging_buffers.push_back(std::make_shared<Buffer>(buffer_size, eTransferSrc, true));
+
+    }
+
+    void ParticleSystem::record_simulator_upload (uint32_t index, float delta) {
+
+        auto& staging = staging_buffers.at(index);
+
+        simulator->step(delta);
+        simulator->write({ static_cast<Particle*>(staging->get_mapped()), particles_count });
+        staging->flush();
+
+        auto copy_region = vk::BufferCopy {
+            .size = staging->get_size()
+        };
+
+        command_buffers.at(index).copyBuffer(staging->get_handle(), buffers.at(index)->get_handle(), 1, &copy_region);
+
+    }
+
+    uint32_t ParticleSystem::autotune_workgroup_size (uint32_t fallback) {
+
+        SCOPED_PERF_LOG;
+
+        using enum vk::PipelineBindPoint;
+
+        auto properties = device->get_gpu().getProperties();
+
+        if (auto cached = read_workgroup_cache(properties)) {
+            logi("Using cached particles workgroup size {}", *cached);
+            return *cached;
+        }
+
+        auto indices = get_queue_family_indices(device->get_gpu(), device->get_surface());
+        auto queue_family = device->get_gpu().getQueueFamilyProperties().at(indices.graphics_family.value());
+
+        if (!queue_family.timestampValidBits) return fallback;
+
+        auto candidates = std::vector<uint32_t>();
+        for (uint32_t size = 32; size <= properties.limits.maxComputeWorkGroupInvocations; size *= 2)
+            if (size <= properties.limits.maxComputeWorkGroupSize.at(0)) candidates.push_back(size);
+
+        auto query_pool_info = vk::QueryPoolCreateInfo {
+            .queryType = vk::QueryType::eTimestamp,
+            .queryCount = 2
+        };
+
+        auto query_pool = device->get_handle().createQueryPoolUnique(query_pool_info);
+
+        constexpr uint32_t repetitions = 32;
+        auto best_size = fallback;
+        auto best_time = std::numeric_limits<double>::max();
+
+        for (auto size : candidates) {
+
+            auto pipeline = create_compute_pipeline(compute_layout, "shaders/particles", Specialization().set(0, size));
+            if (!pipeline) continue;
+
+            float delta = 0.f;
+
+            { // TransientBuffer waits for the submission to finish when it goes out of scope
+
+                auto transient_buffer = TransientBuffer(true);
+                auto& commands = transient_buffer.get();
+
+                commands.resetQueryPool(query_pool.get(), 0, 2);
+                commands.pushConstants(compute_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(float), &delta);
+                commands.bindPipeline(eCompute, pipeline);
+                commands.bindDescriptorSets(eCompute, compute_layout, 0, 1, &descriptor_sets.at(0), 0, nullptr);
+
+                commands.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, query_pool.get(), 0);
+                for (uint32_t i = 0; i < repetitions; i++) commands.dispatch(get_group_count(size), 1, 1);
+                commands.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, query_pool.get(), 1);
+
+                transient_buffer.submit();
+
+            }
+
+            auto timestamps = std::array<uint64_t, 2>();
+            auto result = device->get_handle().getQueryPoolResults(query_pool.get(), 0, 2, sizeof(timestamps), timestamps.data(),
+                sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+
+            device->get_handle().destroyPipeline(pipeline);
+
+            if (result != vk::Result::eSuccess) continue;
+
+            auto time = (timestamps.at(1) - timestamps.at(0)) * properties.limits.timestampPeriod * 0.000001;
+            logi("Particles workgroup size {} took {:.4f}ms", size, time);
+
+            if (time < best_time) {
+                best_time = time;
+                best_size = size;
+            }
+
+        }
+
+        logi("Selected particles workgroup size {}", best_size);
+
+        if (best_time < std::numeric_limits<double>::max()) write_workgroup_cache(properties, best_size);
+
+        return best_size;
+
     }
 
     void ParticleSystem::make_command_pool ( ) {
@@ -143,101 +352,34 @@ namespace engine {
 
     }
 
-    void ParticleSystem::make_descriptor_set_layout ( ) {
-
-        auto bindings = Particle::get_descriptor_set_layout_bindings();
-
-        auto create_info = vk::DescriptorSetLayoutCreateInfo {
-            .flags = vk::DescriptorSetLayoutCreateFlags(),
-            .bindingCount = to_u32(bindings.size()),
-            .pBindings = bindings.data()
-        };
-
-        try {
-            descriptor_set_layout = Device::get()->get_handle().createDescriptorSetLayoutUnique(create_info);
-            logi("Created DescriptorSet Pipeline layout");
-        } catch (vk::SystemError error) {
-            loge("Failed to create DescriptorSet layout");
-        }
-
-    };
-
     void ParticleSystem::make_descriptor_set ( ) {
 
-        auto pool_sizes = std::array {
-            vk::DescriptorPoolSize {
-                .type = vk::DescriptorType::eStorageBuffer,
-                .descriptorCount = 2 * frames_in_flight
-            }
-        };
-
-        auto create_info = vk::DescriptorPoolCreateInfo {
-            .flags = vk::DescriptorPoolCreateFlags(),
-            .maxSets = frames_in_flight,
-            .poolSizeCount = to_u32(pool_sizes.size()),
-            .pPoolSizes = pool_sizes.data()
-        };
-
-        try {
-            descriptor_pool = device->get_handle().createDescriptorPoolUnique(create_info);
-            logi("Successfully created Descriptor Pool");
-        } catch (vk::SystemError err) {
-            loge("Failed to create Descriptor Pool");
-        }
-
-        auto layouts = std::array {
-            descriptor_set_layout.get(),
-            descriptor_set_layout.get(),
-            descriptor_set_layout.get()
-        };
-
-        auto allocate_info = vk::DescriptorSetAllocateInfo {
-            .descriptorPool = descriptor_pool.get(),
-            .descriptorSetCount = frames_in_flight,
-            .pSetLayouts = layouts.data()
-        };
-
-        try {
-            descriptor_sets = device->get_handle().allocateDescriptorSets(allocate_info);
-            logi("Allocated DescriptorSet's");
-        } catch (vk::SystemError err) {
-            loge("Failed to allocate DescriptorSet's");
-        }
+        descriptor_sets.clear();
 
         for (uint32_t i = 0; i < frames_in_flight; i++) {
 
-            auto last_frame_sbo = vk::DescriptorBufferInfo {
-                .buffer = buffers.at((i - 1) % frames_in_flight)->get_handle(),
-                .offset = 0,
-                .range = sizeof(Particle) * particles_count
-            };
-
-            auto current_frame_sbo = vk::DescriptorBufferInfo {
-                .buffer = buffers.at(i)->get_handle(),
-                .offset = 0,
-                .range = sizeof(Particle) * particles_count
-            };
-
-            auto descriptor_writes = std::array {
-                vk::WriteDescriptorSet {
-                    .dstSet = descriptor_sets.at(i),
-                    .dstBinding = 0,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = vk::DescriptorType::eStorageBuffer,
-                    .pBufferInfo = &last_frame_sbo
+            auto bindings = std::array {
+                DescriptorBinding {
+                    .binding = 0,
+                    .type = vk::DescriptorType::eStorageBuffer,
+                    .buffer = {
+                        .buffer = buffers.at((i + frames_in_flight - 1) % frames_in_flight)->get_handle(),
+                        .offset = 0,
+                        .range = sizeof(Particle) * particles_count
+                    }
                 },
-                vk::WriteDescriptorSet {
-                    .dstSet = descriptor_sets.at(i),
-                    .dstBinding = 1,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = vk::DescriptorType::eStorageBuffer,
-                    .pBufferInfo = &current_frame_sbo
+                DescriptorBinding {
+                    .binding = 1,
+                    .type = vk::DescriptorType::eStorageBuffer,
+                    .buffer = {
+                        .buffer = buffers.at(i)->get_handle(),
+                        .offset = 0,
+                        .range = sizeof(Particle) * particles_count
+                    }
                 }
             };
 
-            device->get_handle().updateDescriptorSets(to_u32(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+            descriptor_sets.push_back(DescriptorAllocator::get(descriptor_set_layout, bindings));
 
         }
 
@@ -266,12 +408,17 @@ namespace engine {
             loge("Failed to begin command record");
         }
 
-        commands.pushConstants(compute_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(float), &delta);
+        if (backend == ParticleBackend::eCPU) record_simulator_upload(index, delta);
+        else {
 
-        commands.bindPipeline(vk::PipelineBindPoint::eCompute, compute_pipeline);
-        commands.bindDescriptorSets(vk::PipelineBindPoint::eCompute, compute_layout, 0, 1, &descriptor_sets.at(index), 0, nullptr);
+            commands.pushConstants(compute_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(float), &delta);
 
-        commands.dispatch(particles_count / 256, 1, 1);
+            commands.bindPipeline(vk::PipelineBindPoint::eCompute, compute_pipeline->get());
+            commands.bindDescriptorSets(vk::PipelineBindPoint::eCompute, compute_layout, 0, 1, &descriptor_sets.at(index), 0, nullptr);
+
+            commands.dispatch(get_group_count(workgroup_size), 1, 1);
+
+        }
 
         try {
             commands.end();
@@ -283,9 +430,12 @@ namespace engine {
 
     void ParticleSystem::draw (uint32_t index, const vk::CommandBuffer& commands) {
 
-        
+        SCOPED_PERF_LOG;
+
+        auto& pipeline = blending == ParticleBlending::eOrdered ? ordered_pipeline : additive_pipeline;
+
         auto offsets = std::array<vk::DeviceSize, 1> { }; 
-        commands.bindPipeline(vk::PipelineBindPoint::eGraphics, graphics_pipeline);
+        commands.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->get());
         commands.bindVertexBuffers(0, 1, &buffers.at(index)->get_handle(), offsets.data());
         commands.draw(particles_count, 1, 0, 0);
 
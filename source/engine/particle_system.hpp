@@ -2,11 +2,22 @@
 
 #include "core/memory.hpp"
 #include "core/pipeline.hpp"
+#include "core/pipeline_registry.hpp"
+
+#include "particle_simulator.hpp"
 
 #include "utils/primitives.hpp"
 
 namespace engine {
 
+    enum class ParticleBlending {
+        eOrdered, eAdditive
+    };
+
+    enum class ParticleBackend {
+        eGPU, eCPU
+    };
+
     class ParticleSystem {
 
         uint32_t frames_in_flight;
@@ -16,43 +27,58 @@ namespace engine {
         std::vector<Particle> particles;
         std::vector<std::shared_ptr<Buffer>> buffers;
 
+        ParticleBackend backend;
+        std::unique_ptr<ParticleSimulator> simulator;
+        std::vector<std::shared_ptr<Buffer>> staging_buffers;
+
         std::vector<vk::UniqueFence> fences;
         std::vector<vk::UniqueSemaphore> semaphores;
 
         vk::RenderPass render_pass;
-        vk::Pipeline graphics_pipeline;
+        std::shared_ptr<PipelineHandle> ordered_pipeline;
+        std::shared_ptr<PipelineHandle> additive_pipeline;
         vk::PipelineLayout graphics_layout;
+        ParticleBlending blending = ParticleBlending::eOrdered;
 
-        vk::Pipeline compute_pipeline;
+        std::shared_ptr<PipelineHandle> compute_pipeline;
         vk::PipelineLayout compute_layout;
+        uint32_t workgroup_size;
         vk::Queue queue;
 
-        vk::UniqueDescriptorPool descriptor_pool;
-        vk::UniqueDescriptorSetLayout descriptor_set_layout;
+        vk::DescriptorSetLayout descriptor_set_layout;
         std::vector<vk::DescriptorSet> descriptor_sets;
 
         vk::CommandPool command_pool;
         std::vector<vk::CommandBuffer> command_buffers;
 
-        void make_descriptor_set_layout ( );
         void make_descriptor_set ( );
 
         void fill_particles ( );
         void prepare_buffers ( );
+        void record_simulator_upload (uint32_t index, float delta);
 
         void make_command_pool ( );
         void make_command_buffers ( );
 
+        // Times the candidate sizes once per device, driver and shader code, later runs read the result back from a file
+        uint32_t autotune_workgroup_size (uint32_t fallback);
+        constexpr uint32_t get_group_count (uint32_t size) const { return (to_u32(particles_count) + size - 1) / size; }
+
+        std::shared_ptr<PipelineHandle> make_graphics_pipeline (ParticleBlending mode);
+
         public:
 
         ParticleSystem ( ) = default;
-        ParticleSystem (uint32_t frames_in_flight, const vk::RenderPass& render_pass);
+        ParticleSystem (uint32_t frames_in_flight, const vk::RenderPass& render_pass, ParticleBackend backend = ParticleBackend::eGPU);
         ~ParticleSystem ( );
 
         void record_compute_commands (uint32_t index);
         void draw (uint32_t index, const vk::CommandBuffer& commands);
         void compute_submit (uint32_t index);
 
+        constexpr void set_blending (ParticleBlending mode) { blending = mode; }
+        void set_render_pass (vk::RenderPass render_pass);
+
         constexpr const vk::Semaphore get_semaphore (uint32_t index) const { return semaphores.at(index).get(); }
 
     };
@@ -0,0 +1,233 @@
+#include <algorithm>
+
+#include "scene.hpp"
+
+#include "core/descriptor_allocator.hpp"
+#include "core/layout_cache.hpp"
+#include "core/pipeline_registry.hpp"
+#include "core/shaders.hpp"
+#include "core/texture_table.hpp"
+
+#include "utils/utils.hpp"
+#include "utils/logging.hpp"
+
+namespace engine {
+
+    // Push constants of shaders/cull.comp
+    struct CullConstants {
+        std::array<glm::vec4, 6> planes;
+        uint32_t instance_count;
+    };
+
+    Scene::Scene ( ) {
+
+        auto reflection = Shader::reflect("shaders/cull");
+        cull_workgroup_size = reflection.workgroup_size.at(0);
+
+        cull_set_layout = LayoutCache::get_set_layout(reflection.descriptor_sets.at(0));
+        cull_layout = LayoutCache::get_pipeline_layout(reflection);
+        cull_pipeline = PipelineRegistry::acquire_compute(cull_layout, "shaders/cull");
+
+        draw_layout = LayoutCache::get_pipeline_layout("shaders/scene");
+
+    }
+
+    Scene::~Scene ( ) {
+
+        // Frames in flight may still read the instance and indirect buffers
+        device->get_handle().waitIdle();
+
+        cull_pipeline.reset();
+        draw_pipeline.reset();
+
+    }
+
+    uint32_t Scene::add_mesh (const Model& model) {
+
+        auto model_vertices = model.get_vertices();
+        auto model_indices = model.get_indices();
+
+        auto minimum = glm::vec3(std::numeric_limits<float>::max());
+        auto maximum = glm::vec3(std::numeric_limits<float>::lowest());
+
+        for (const auto& vertex : model_vertices) {
+            minimum = glm::min(minimum, vertex.position);
+            maximum = glm::max(maximum, vertex.position);
+        }
+
+        auto center = (minimum + maximum) * 0.5f;
+        auto radius = 0.f;
+
+        for (const auto& vertex : model_vertices)
+            radius = std::max(radius, glm::distance(center, vertex.position));
+
+        auto first_index = indices.size();
+
+        // Scene geometry always uses 32 bit indices, submesh local indices are rebased onto the model's vertices.
+        // Only the full detail level is drawn here
+        for (const auto& submesh : model.get_submeshes())
+            for (auto index : model_indices.subspan(submesh.first_index, submesh.index_count))
+                indices.push_back(index + submesh.vertex_offset);
+
+        meshes.push_back({
+            .index_count = to_u32(indices.size() - first_index),
+            .first_index = to_u32(first_index),
+            .vertex_offset = static_cast<int32_t>(vertices.size()),
+            .bounds = glm::vec4(center, radius)
+        });
+
+        vertices.insert(vertices.end(), model_vertices.begin(), model_vertices.end());
+
+        return to_u32(meshes.size() - 1);
+
+    }
+
+    void Scene::add_instance (uint32_t mesh, uint32_t texture, const glm::mat4x4& transform) {
+
+        instances.push_back({ .transform = transform, .mesh = mesh, .texture = texture });
+
+    }
+
+    void Scene::upload ( ) {
+
+        SCOPED_PERF_LOG;
+
+        using enum vk::BufferUsageFlagBits;
+
+        vertex_buffer = std::make_unique<Buffer>(vertices.size() * sizeof(Vertex), eVertexBuffer, false, true);
+        vertex_buffer->write(vertices.data());
+
+        index_buffer = std::make_unique<Buffer>(indices.size() * sizeof(uint32_t), eIndexBuffer, false, true);
+        index_buffer->write(indices.data());
+
+        mesh_buffer = std::make_unique<Buffer>(meshes.size() * sizeof(SceneMesh), eStorageBuffer, false, true);
+        mesh_buffer->write(meshes.data());
+
+        instance_buffer = std::make_unique<Buffer>(instances.size() * sizeof(SceneInstance), eStorageBuffer, false, true);
+        instance_buffer->write(instances.data());
+
+        auto draw_reflection = Shader::reflect("shaders/scene");
+        auto instance_layout = LayoutCache::get_set_layout(draw_reflection.descriptor_sets.at(1));
+
+        auto bindings = std::array {
+            DescriptorBinding {
+                .binding = 0,
+                .type = vk::DescriptorType::eStorageBuffer,
+                .buffer = { .buffer = instance_buffer->get_handle(), .offset = 0, .range = VK_WHOLE_SIZE }
+            }
+        };
+
+        instance_set = DescriptorAllocator::get(instance_layout, bindings);
+
+        // Frame resources refer to the old buffers
+        command_buffers.clear();
+        count_buffers.clear();
+
+        logi("Uploaded scene with {} meshes and {} instances", meshes.size(), instances.size());
+
+    }
+
+    void Scene::make_frame (uint32_t index) {
+
+        using enum vk::BufferUsageFlagBits;
+
+        command_buffers.resize(index + 1);
+        count_buffers.resize(index + 1);
+
+        auto max_draws = std::max<std::size_t>(instances.size(), 1);
+
+        command_buffers.at(index) = std::make_unique<Buffer>(max_draws * sizeof(vk::DrawIndexedIndirectCommand), eStorageBuffer | eIndirectBuffer, false, true);
+        count_buffers.at(index) = std::make_unique<Buffer>(sizeof(uint32_t), eStorageBuffer | eIndirectBuffer | eTransferDst, false, true);
+
+    }
+
+    void Scene::make_draw_pipeline (vk::RenderPass render_pass) {
+
+        auto sample_count = get_max_sample_count(device->get_gpu());
+
+        this->render_pass = render_pass;
+        draw_pipeline = PipelineRegistry::acquire({
+            .multisampling_info = create_multisampling_info(sample_count, true),
+            .layout = draw_layout,
+            .render_pass = render_pass,
+            .shader_path = "shaders/scene"
+        });
+
+    }
+
+    void Scene::record_cull (const vk::CommandBuffer& commands, uint32_t index, const glm::mat4x4& view_projection) {
+
+        SCOPED_PERF_LOG;
+
+        if (instances.empty() || !instance_buffer) return;
+        if (index >= command_buffers.size() || !command_buffers.at(index)) make_frame(index);
+
+        auto storage_binding = [] (uint32_t binding, const Buffer& buffer) {
+            return DescriptorBinding {
+                .binding = binding,
+                .type = vk::DescriptorType::eStorageBuffer,
+                .buffer = { .buffer = buffer.get_handle(), .offset = 0, .range = VK_WHOLE_SIZE }
+            };
+        };
+
+        auto bindings = std::array {
+            storage_binding(0, *mesh_buffer),
+            storage_binding(1, *instance_buffer),
+            storage_binding(2, *command_buffers.at(index)),
+            storage_binding(3, *count_buffers.at(index))
+        };
+
+        auto cull_set = DescriptorAllocator::get_transient(index, cull_set_layout, bindings);
+
+        commands.fillBuffer(count_buffers.at(index)->get_handle(), 0, sizeof(uint32_t), 0);
+
+        auto clear_barrier = vk::MemoryBarrier {
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite
+        };
+
+        commands.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(), 1, &clear_barrier, 0, nullptr, 0, nullptr);
+
+        auto constants = CullConstants {
+            .planes = get_frustum_planes(view_projection),
+            .instance_count = to_u32(instances.size())
+        };
+
+        commands.bindPipeline(vk::PipelineBindPoint::eCompute, cull_pipeline->get());
+        commands.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cull_layout, 0, 1, &cull_set, 0, nullptr);
+        commands.pushConstants(cull_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullConstants), &constants);
+        commands.dispatch((constants.instance_count + cull_workgroup_size - 1) / cull_workgroup_size, 1, 1);
+
+        auto cull_barrier = vk::MemoryBarrier {
+            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+            .dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead
+        };
+
+        commands.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect,
+            vk::DependencyFlags(), 1, &cull_barrier, 0, nullptr, 0, nullptr);
+
+    }
+
+    void Scene::draw (const vk::CommandBuffer& commands, uint32_t index, const glm::mat4x4& view_projection, vk::RenderPass render_pass) {
+
+        SCOPED_PERF_LOG;
+
+        if (instances.empty() || index >= command_buffers.size() || !command_buffers.at(index)) return;
+        if (!draw_pipeline || render_pass != this->render_pass) make_draw_pipeline(render_pass);
+
+        auto offsets = std::array<vk::DeviceSize, 1> { };
+
+        commands.bindPipeline(vk::PipelineBindPoint::eGraphics, draw_pipeline->get());
+        TextureTable::bind(commands, draw_layout);
+        commands.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, draw_layout, 1, 1, &instance_set, 0, nullptr);
+        commands.pushConstants(draw_layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(glm::mat4x4), &view_projection);
+        commands.bindVertexBuffers(0, 1, &vertex_buffer->get_handle(), offsets.data());
+        commands.bindIndexBuffer(index_buffer->get_handle(), 0, vk::IndexType::eUint32);
+
+        commands.drawIndexedIndirectCount(command_buffers.at(index)->get_handle(), 0, count_buffers.at(index)->get_handle(), 0,
+            to_u32(instances.size()), sizeof(vk::DrawIndexedIndirectCommand));
+
+    }
+
+}
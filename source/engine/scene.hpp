@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "core/device.hpp"
+#include "core/memory.hpp"
+#include "core/model.hpp"
+#include "core/pipeline.hpp"
+
+#include "utils/primitives.hpp"
+
+namespace engine {
+
+    // Layouts match the std430 structs in shaders/cull.comp and shaders/scene.vert
+    struct SceneMesh {
+        uint32_t index_count;
+        uint32_t first_index;
+        int32_t vertex_offset;
+        uint32_t padding = 0;
+        glm::vec4 bounds; // bounding sphere, center and radius
+    };
+
+    struct SceneInstance {
+        glm::mat4x4 transform;
+        uint32_t mesh;
+        uint32_t texture;
+        std::array<uint32_t, 2> padding = { };
+    };
+
+    static_assert(sizeof(SceneMesh) == 32);
+    static_assert(sizeof(SceneInstance) == 80);
+
+    // Instances drawn by the GPU: a compute pass frustum culls them into indirect draw commands and
+    // a single drawIndexedIndirectCount draws the survivors, so recording cost doesn't grow with the scene
+    class Scene {
+
+        std::shared_ptr<Device> device = Device::get();
+
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<SceneMesh> meshes;
+        std::vector<SceneInstance> instances;
+
+        std::unique_ptr<Buffer> vertex_buffer;
+        std::unique_ptr<Buffer> index_buffer;
+        std::unique_ptr<Buffer> mesh_buffer;
+        std::unique_ptr<Buffer> instance_buffer;
+
+        // Per frame in flight, created on first use of a frame index. The cull set binding them is
+        // transient, taken from the frame's descriptor pools every time the cull is recorded
+        std::vector<std::unique_ptr<Buffer>> command_buffers;
+        std::vector<std::unique_ptr<Buffer>> count_buffers;
+
+        vk::DescriptorSetLayout cull_set_layout;
+        vk::PipelineLayout cull_layout;
+        vk::PipelineLayout draw_layout;
+        std::shared_ptr<PipelineHandle> cull_pipeline;
+        std::shared_ptr<PipelineHandle> draw_pipeline;
+        vk::DescriptorSet instance_set;
+        vk::RenderPass render_pass;
+
+        uint32_t cull_workgroup_size;
+
+        void make_frame (uint32_t index);
+        void make_draw_pipeline (vk::RenderPass render_pass);
+
+        public:
+
+        Scene ( );
+        ~Scene ( );
+
+        uint32_t add_mesh (const Model& model);
+        void add_instance (uint32_t mesh, uint32_t texture, const glm::mat4x4& transform);
+
+        // Moves geometry and instances to the GPU, must be called after the scene is built
+        void upload ( );
+
+        void record_cull (const vk::CommandBuffer& commands, uint32_t index, const glm::mat4x4& view_projection);
+        void draw (const vk::CommandBuffer& commands, uint32_t index, const glm::mat4x4& view_projection, vk::RenderPass render_pass);
+
+        constexpr std::size_t get_instance_count ( ) const { return instances.size(); }
+
+    };
+
+}
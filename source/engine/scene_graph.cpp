@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <span>
+
+#include "scene_graph.hpp"
+#include "instance_batcher.hpp"
+
+#include "utils/utils.hpp"
+#include "utils/logging.hpp"
+
+namespace engine {
+
+    NodeHandle SceneGraph::add_node (const glm::mat4x4& local_transform, std::optional<NodeHandle> parent, std::shared_ptr<Object> object) {
+
+        auto handle = to_u32(handles.size());
+        auto parent_index = parent ? indices.at(*parent) : no_parent;
+        auto depth = parent ? depths.at(parent_index) + 1 : 0;
+
+        local_transforms.push_back(local_transform);
+        world_transforms.push_back(local_transform);
+        parents.push_back(parent_index);
+        depths.push_back(depth);
+        dirty.push_back(1);
+        objects.push_back(object);
+        handles.push_back(handle);
+        indices.push_back(to_u32(handles.size() - 1));
+
+        // Appending keeps parents ahead of children but not the level order, the next update sorts again
+        is_sorted = false;
+
+        dirty_depth = std::min(dirty_depth, depth);
+
+        return handle;
+
+    }
+
+    void SceneGraph::set_local_transform (NodeHandle node, const glm::mat4x4& local_transform) {
+
+        auto index = indices.at(node);
+
+        local_transforms.at(index) = local_transform;
+        dirty.at(index) = 1;
+        dirty_depth = std::min(dirty_depth, depths.at(index));
+
+        // Before sorting the positions aren't final, sort() marks every level instead
+        if (is_sorted) dirty_ranges.at(depths.at(index)).add(index, index + 1);
+
+    }
+
+    void SceneGraph::sort ( ) {
+
+        SCOPED_PERF_LOG;
+
+        auto order = std::vector<uint32_t>(get_size());
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::stable_sort(order, { }, [this] (uint32_t index) { return depths[index]; });
+
+        auto new_index = std::vector<uint32_t>(order.size());
+
+        // Levels are placed top down, so the parents of a level already have their final positions to order it by
+        for (std::size_t begin = 0, end = 0; begin < order.size(); begin = end) {
+
+            end = begin;
+            while (end < order.size() && depths[order[end]] == depths[order[begin]]) ++end;
+
+            if (depths[order[begin]] > 0)
+                std::stable_sort(order.begin() + begin, order.begin() + end,
+                    [&] (uint32_t a, uint32_t b) { return new_index[parents[a]] < new_index[parents[b]]; });
+
+            for (auto i = begin; i < end; ++i) new_index[order[i]] = to_u32(i);
+
+        }
+
+        auto reorder = [&order] (auto& values) {
+            auto sorted = std::remove_reference_t<decltype(values)>();
+            sorted.reserve(values.size());
+            for (auto index : order) sorted.push_back(std::move(values[index]));
+            values = std::move(sorted);
+        };
+
+        for (auto& parent : parents) if (parent != no_parent) parent = new_index[parent];
+
+        reorder(local_transforms); reorder(world_transforms);
+        reorder(parents); reorder(depths);
+        reorder(dirty); reorder(objects);
+        reorder(handles);
+
+        for (uint32_t i = 0; i < handles.size(); ++i) indices[handles[i]] = i;
+
+        level_offsets.clear();
+        level_chunks.clear();
+
+        for (std::size_t i = 0; i < depths.size(); ++i) {
+            if (i == 0 || depths[i] != depths[i - 1]) {
+                level_offsets.push_back(i);
+                level_chunks.emplace_back();
+            }
+            if ((i - level_offsets.back()) % chunk_size == 0) level_chunks.back().push_back(i);
+        }
+
+        level_offsets.push_back(depths.size());
+
+        // Positions changed, every level from the first dirty one is visited once and its dirty flags decide
+        dirty_ranges.assign(level_chunks.size(), { });
+        for (std::size_t depth = dirty_depth; depth < dirty_ranges.size(); ++depth)
+            dirty_ranges[depth].add(level_offsets[depth], level_offsets[depth + 1]);
+
+        is_sorted = true;
+
+    }
+
+    void SceneGraph::update_level (uint32_t depth, DirtyRange range) {
+
+        auto level_begin = level_offsets.at(depth);
+        const auto& chunks = level_chunks.at(depth);
+
+        auto first_chunk = chunks.begin() + (range.begin - level_begin) / chunk_size;
+        auto last_chunk = chunks.begin() + (range.end - level_begin + chunk_size - 1) / chunk_size;
+
+        auto local = local_transforms.data();
+        auto world = world_transforms.data();
+        auto parent = parents.data();
+        auto flags = dirty.data();
+
+        std::for_each(std::execution::par_unseq, first_chunk, last_chunk, [=] (std::size_t chunk) {
+
+            auto begin = std::max(chunk, range.begin);
+            auto end = std::min(chunk + chunk_size, range.end);
+
+            // Parents live on the level above which is already final, so a dirty parent marks its children
+            if (depth == 0) {
+                for (auto i = begin; i < end; ++i)
+                    if (flags[i]) world[i] = local[i];
+            } else {
+                for (auto i = begin; i < end; ++i) {
+                    flags[i] |= flags[parent[i]];
+                    if (flags[i]) world[i] = world[parent[i]] * local[i];
+                }
+            }
+
+        });
+
+    }
+
+    void SceneGraph::update ( ) {
+
+        if (dirty_depth == clean) return;
+
+        SCOPED_PERF_LOG;
+
+        if (!is_sorted) sort();
+
+        for (auto depth = dirty_depth; depth < get_depth(); ++depth) {
+
+            auto& range = dirty_ranges.at(depth);
+
+            // Parents of a level are sorted, the children of the dirty range above are found by bisection
+            if (depth > dirty_depth) if (const auto& above = dirty_ranges.at(depth - 1); !above.empty()) {
+                auto level = std::span(parents).subspan(level_offsets.at(depth), level_offsets.at(depth + 1) - level_offsets.at(depth));
+                auto first = std::ranges::lower_bound(level, to_u32(above.begin)) - level.begin();
+                auto last = std::ranges::lower_bound(level, to_u32(above.end)) - level.begin();
+                if (first < last) range.add(level_offsets.at(depth) + first, level_offsets.at(depth) + last);
+            }
+
+            if (!range.empty()) update_level(depth, range);
+
+        }
+
+        for (auto depth = dirty_depth; depth < get_depth(); ++depth) {
+            auto& range = dirty_ranges.at(depth);
+            if (!range.empty()) std::fill(dirty.begin() + range.begin, dirty.begin() + range.end, 0);
+            range = { };
+        }
+
+        dirty_depth = clean;
+
+    }
+
+    void SceneGraph::submit (InstanceBatcher& batcher) const {
+
+        for (std::size_t i = 0; i < objects.size(); ++i)
+            if (objects[i]) batcher.submit(objects[i], world_transforms[i], handles[i]);
+
+    }
+
+}
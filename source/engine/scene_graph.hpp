@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "utils/primitives.hpp"
+
+namespace engine {
+
+    struct Object;
+    class InstanceBatcher;
+
+    using NodeHandle = uint32_t;
+
+    // Transform hierarchy stored as flat arrays ordered by depth, so every parent precedes its children and
+    // each depth level can be updated in parallel once the level above it is done. Inside a level nodes follow
+    // the order of their parents, so the children of a range of nodes form a range as well. Only the ranges
+    // holding nodes whose local transform changed and their descendants are visited, an untouched graph costs
+    // nothing per frame
+    class SceneGraph {
+
+        static constexpr std::size_t chunk_size = 1024;
+        static constexpr uint32_t no_parent = std::numeric_limits<uint32_t>::max();
+        static constexpr uint32_t clean = std::numeric_limits<uint32_t>::max();
+
+        // Span of a level containing every changed node, the clean nodes between them are checked and skipped
+        struct DirtyRange {
+            std::size_t begin = std::numeric_limits<std::size_t>::max();
+            std::size_t end = 0;
+
+            constexpr bool empty ( ) const { return begin >= end; }
+            constexpr void add (std::size_t first, std::size_t last) { begin = std::min(begin, first); end = std::max(end, last); }
+        };
+
+        // Indexed by position in depth order
+        std::vector<glm::mat4x4> local_transforms;
+        std::vector<glm::mat4x4> world_transforms;
+        std::vector<uint32_t> parents;
+        std::vector<uint32_t> depths;
+        std::vector<uint8_t> dirty;
+        std::vector<std::shared_ptr<Object>> objects;
+        std::vector<NodeHandle> handles;
+
+        // Handles stay valid when sorting moves nodes around
+        std::vector<uint32_t> indices;
+
+        // First index of each depth level followed by the end, and the chunk starts of each level
+        std::vector<std::size_t> level_offsets;
+        std::vector<std::vector<std::size_t>> level_chunks;
+        std::vector<DirtyRange> dirty_ranges;
+
+        bool is_sorted = true;
+        uint32_t dirty_depth = clean;
+
+        void sort ( );
+        void update_level (uint32_t depth, DirtyRange range);
+
+        public:
+
+        NodeHandle add_node (const glm::mat4x4& local_transform, std::optional<NodeHandle> parent = std::nullopt,
+            std::shared_ptr<Object> object = nullptr);
+
+        void set_local_transform (NodeHandle node, const glm::mat4x4& local_transform);
+
+        // Recomputes world transforms below every node changed since the last update
+        void update ( );
+
+        // Queues every node with an object for drawing with its world transform, the handle identifies the instance
+        void submit (InstanceBatcher& batcher) const;
+
+        const glm::mat4x4& get_local_transform (NodeHandle node) const { return local_transforms.at(indices.at(node)); }
+        const glm::mat4x4& get_world_transform (NodeHandle node) const { return world_transforms.at(indices.at(node)); }
+
+        constexpr std::size_t get_size ( ) const { return handles.size(); }
+        constexpr std::size_t get_depth ( ) const { return level_offsets.empty() ? 0 : level_offsets.size() - 1; }
+
+    };
+
+}
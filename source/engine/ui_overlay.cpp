@@ -6,6 +6,9 @@
 #include "ui_overlay.hpp"
 
 #include "core/pipeline.hpp"
+#include "core/pipeline_registry.hpp"
+#include "core/layout_cache.hpp"
+#include "core/texture_table.hpp"
 
 #include "utils/logging.hpp"
 #include "utils/primitives.hpp"
@@ -19,25 +22,35 @@ namespace engine {
 		ImGui::DestroyContext();
 
         logi("Destroying UI Pipeline");
-        device->get_handle().destroyPipelineLayout(pipeline_layout);
-        device->get_handle().destroyDescriptorSetLayout(descriptor_set_layout);
-        device->get_handle().destroyPipeline(pipeline);
+        pipeline.reset();
 
     }
 
     void UI::create_handle ( ) {
 
-        descriptor_set_layout = create_descriptor_set_layout();
+        pipeline_layout = LayoutCache::get_pipeline_layout("shaders/imgui");
+        make_pipeline();
 
-        auto push_constant_range = vk::PushConstantRange {
-            .stageFlags = vk::ShaderStageFlagBits::eVertex,
-            .offset = 0,
-            .size = sizeof(glm::vec2) * 2
-        };
+        ImGui::CreateContext();
+        ImGui::StyleColorsDark();
+        ImGui::GetStyle().WindowRounding = 10.f;
+
+        auto& io = ImGui::GetIO();
+        io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset; 
+
+        ImGui_ImplGlfw_InitForVulkan(const_cast<GLFWwindow*>(device->get_window()), false);
+        create_font_texture();
+        register_callbacks();
+
+        vertex_buffers.resize(image_count);
+        index_buffers.resize(image_count);
+
+    }
+
+    void UI::make_pipeline ( ) {
 
         auto sample_count = get_max_sample_count(device->get_gpu());
-        pipeline_layout = create_pipeline_layout(&descriptor_set_layout, &push_constant_range);
-        pipeline = create_pipeline({
+        pipeline = PipelineRegistry::acquire({
             .binding_description = ImVertex::get_binding_description(),
             .attribute_descriptions = ImVertex::get_attribute_descriptions(),
             .rasterization_info = create_rasterization_info(vk::CullModeFlagBits::eNone),
@@ -52,19 +65,12 @@ namespace engine {
             .shader_path = "shaders/imgui"
         });
 
-        ImGui::CreateContext();
-        ImGui::StyleColorsDark();
-        ImGui::GetStyle().WindowRounding = 10.f;
+    }
 
-        auto& io = ImGui::GetIO();
-        io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset; 
+    void UI::set_render_pass (vk::RenderPass render_pass) {
 
-        ImGui_ImplGlfw_InitForVulkan(const_cast<GLFWwindow*>(device->get_window()), false);
-        create_font_texture();
-        register_callbacks();
-
-        vertex_buffers.resize(image_count);
-        index_buffers.resize(image_count);
+        this->render_pass = render_pass;
+        make_pipeline();
 
     }
 
@@ -133,16 +139,17 @@ namespace engine {
 
     void UI::draw (uint32_t index, const vk::CommandBuffer& commands) {
 
-        extern std::map<std::string_view, double> perf_counters;
-
         SCOPED_PERF_LOG;
 
-        if (!perf_counters.empty()) {
+        if (!perf_counters.empty() || !perf_statistics.empty()) {
 
             ImGui::Begin("Perf Counters", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
 
             for (auto[name, duration] : perf_counters)
                 ImGui::Text("%s: %.3fms", name.data(), duration);
+
+            for (auto[name, value] : perf_statistics)
+                ImGui::Text("%s: %zu", name.data(), value);
                 
             ImGui::End();
 
@@ -152,8 +159,8 @@ namespace engine {
 
         if (!update_buffers(index)) return;
 
-        commands.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
-        commands.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout, 0, 1, &font_texture->get_descriptor_set(), 0, nullptr);
+        commands.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->get());
+        TextureTable::bind(commands, pipeline_layout);
 
         auto offsets = std::array<vk::DeviceSize, 1> { }; 
         commands.bindVertexBuffers(0, 1, &vertex_buffers.at(index)->get_handle(), offsets.data());
@@ -164,9 +171,10 @@ namespace engine {
 
         auto scale = glm::vec2(2.0f / draw_data->DisplaySize.x, 2.0f / draw_data->DisplaySize.y);
         auto translate = glm::vec2(-1.f - draw_data->DisplayPos.x * scale.x, -1.f - draw_data->DisplayPos.y * scale.y);
-        auto constant = std::array { scale, translate };
+        auto constant = ImConstants { .scale = scale, .translate = translate, .texture_index = font_texture->get_index() };
 
-        commands.pushConstants(pipeline_layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(glm::vec2) * 2, &constant);
+        constexpr auto stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+        commands.pushConstants(pipeline_layout, stages, 0, sizeof(ImConstants), &constant);
 
         auto command_lists = std::vector(draw_data->CmdLists, draw_data->CmdLists + draw_data->CmdListsCount);
 
@@ -8,14 +8,14 @@
 #include "core/device.hpp"
 #include "core/memory.hpp"
 #include "core/image.hpp"
+#include "core/pipeline.hpp"
 
 namespace engine {
 
     class UI {
 
-        vk::Pipeline pipeline;
+        std::shared_ptr<PipelineHandle> pipeline;
         vk::PipelineLayout pipeline_layout;
-        vk::DescriptorSetLayout descriptor_set_layout;
         vk::RenderPass render_pass;
 
         std::shared_ptr<Device> device = Device::get();
@@ -27,6 +27,7 @@ namespace engine {
         uint32_t image_count;
 
         void create_handle ( );
+        void make_pipeline ( );
         void create_font_texture ( );
         void register_callbacks ( );
 
@@ -40,6 +41,7 @@ namespace engine {
 
         static void new_frame();
         void draw (uint32_t index, const vk::CommandBuffer& commands);
+        void set_render_pass (vk::RenderPass render_pass);
         static void end_frame();
 
     };
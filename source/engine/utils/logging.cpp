@@ -138,6 +138,7 @@ namespace engine {
     }
 
     std::map<std::string_view, double> perf_counters = { };
+    std::map<std::string_view, std::size_t> perf_statistics = { };
 
     ScopedTimer add_perf_counter (std::source_location location) {
 
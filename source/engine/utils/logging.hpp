@@ -3,6 +3,8 @@
 #include <source_location>
 #include <functional>
 #include <chrono>
+#include <map>
+#include <string_view>
 
 #include <fmt/core.h>
 
@@ -46,6 +48,10 @@ namespace engine {
     
     ScopedTimer add_perf_counter (std::source_location = std::source_location::current());
 
+    // Shown by the overlay, durations in milliseconds by function and counts by name
+    extern std::map<std::string_view, double> perf_counters;
+    extern std::map<std::string_view, std::size_t> perf_statistics;
+
 }
 
 #if defined(DEBUG) 
@@ -1,9 +1,8 @@
 #pragma once
 
 #include <array>
-
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include <bit>
+#include <cstdint>
 
 #include <imgui.h>
 
@@ -109,6 +108,13 @@ namespace engine {
 
     };
 
+    // Push constants of shaders/imgui
+    struct ImConstants {
+        glm::vec2 scale;
+        glm::vec2 translate;
+        uint32_t texture_index;
+    };
+
     struct Particle {
 
         glm::vec2 position;
@@ -148,46 +154,71 @@ namespace engine {
 
         }
 
-        static auto get_descriptor_set_layout_bindings ( ) {
+    };
 
-            auto bindings = std::array {
-                vk::DescriptorSetLayoutBinding {
-                    .binding = 0,
-                    .descriptorType = vk::DescriptorType::eStorageBuffer,
-                    .descriptorCount = 1,
-                    .stageFlags = vk::ShaderStageFlagBits::eCompute
-                },
-                vk::DescriptorSetLayoutBinding {
-                    .binding =1,
-                    .descriptorType = vk::DescriptorType::eStorageBuffer,
-                    .descriptorCount = 1,
-                    .stageFlags = vk::ShaderStageFlagBits::eCompute
-                }
+    // Per instance stream of shaders/instanced, the transform takes one attribute location per column
+    struct InstanceData {
+
+        glm::mat4x4 transform;
+
+        static auto get_binding_description ( ) {
+
+            auto description = vk::VertexInputBindingDescription {
+                .binding = 1,
+                .stride = sizeof(InstanceData),
+                .inputRate = vk::VertexInputRate::eInstance
             };
 
-            return bindings;
+            return description;
+
+        }
+
+        static auto get_attribute_descriptions ( ) {
+
+            auto descriptions = std::vector<vk::VertexInputAttributeDescription>();
+
+            for (uint32_t column = 0; column < 4; ++column)
+                descriptions.push_back({
+                    .location = 3 + column,
+                    .binding = 1,
+                    .format = vk::Format::eR32G32B32A32Sfloat,
+                    .offset = static_cast<uint32_t>(offsetof(InstanceData, transform) + column * sizeof(glm::vec4))
+                });
+
+            return descriptions;
 
         }
 
     };
 
-    struct MVPMatrix {
-        glm::mat4x4 model;
-        glm::mat4x4 view;
-        glm::mat4x4 projection;
-        glm::mat4x4 pvm = projection * view * model;
+    // Push constants of shaders/basic, kept within the 128 bytes every device guarantees
+    struct DrawConstants {
+        glm::mat4x4 pvm;
+        uint32_t texture_index;
     };
 
 };
 
+// Mixes the bit patterns of every component, negative zero is folded into zero to agree with operator==
 template <> struct std::hash<engine::Vertex> {
     std::size_t operator() (const engine::Vertex& vertex) const noexcept {
 
-        auto hash_position = std::hash<glm::vec3>{}(vertex.position);
-        auto hash_color = std::hash<glm::vec2>{}(vertex.color);
-        auto hash_coords = std::hash<glm::vec2>{}(vertex.texture_coordinates);
+        auto components = std::array {
+            vertex.position.x, vertex.position.y, vertex.position.z,
+            vertex.color.x, vertex.color.y, vertex.color.z,
+            vertex.texture_coordinates.x, vertex.texture_coordinates.y
+        };
+
+        auto hash = uint64_t(0);
+
+        for (auto component : components)
+            hash = (std::rotl(hash, 5) ^ std::bit_cast<uint32_t>(component + 0.f)) * 0x9e3779b97f4a7c15;
+
+        hash ^= hash >> 33; hash *= 0xff51afd7ed558ccd;
+        hash ^= hash >> 33; hash *= 0xc4ceb9fe1a85ec53;
+        hash ^= hash >> 33;
 
-        return ((hash_position ^ hash_color << 1) >> 1) ^ (hash_coords << 1);
+        return static_cast<std::size_t>(hash);
 
     };
 };
\ No newline at end of file
@@ -84,4 +84,21 @@ namespace engine {
 
     }
 
-}
\ No newline at end of file
+    std::array<glm::vec4, 6> get_frustum_planes (const glm::mat4x4& view_projection) {
+
+        auto row = [&] (int i) { return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]); };
+
+        // Clip space depth goes from 0 to 1, so the near plane is the third row alone
+        auto planes = std::array {
+            row(3) + row(0), row(3) - row(0),
+            row(3) + row(1), row(3) - row(1),
+            row(2), row(3) - row(2)
+        };
+
+        for (auto& plane : planes) plane /= glm::length(glm::vec3(plane));
+
+        return planes;
+
+    }
+
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <functional>
 #include <optional>
 
 #include "transient.hpp"
@@ -48,6 +50,13 @@ namespace engine {
 
     vk::SampleCountFlagBits get_max_sample_count (const vk::PhysicalDevice& physical_device);
 
+    // Normalized planes of the view frustum with normals pointing inwards, for a projection with depth from 0 to 1
+    std::array<glm::vec4, 6> get_frustum_planes (const glm::mat4x4& view_projection);
+
     constexpr uint32_t to_u32 (std::size_t value) { return static_cast<uint32_t>(value); }
 
+    template <typename...Ts> constexpr void hash_combine (std::size_t& seed, const Ts&...values) {
+        ((seed ^= std::hash<Ts>{}(values) + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2)), ...);
+    }
+
 }
\ No newline at end of file
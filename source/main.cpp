@@ -1,16 +1,66 @@
 #include <memory>
+#include <algorithm>
+#include <optional>
 #include <vector>
 
 #include "app.hpp"
 
+#include "engine/core/mesh_cache.hpp"
+#include "engine/core/texture_loader.hpp"
+
 auto main (const int argc, const char* const* argv) -> int {
 
     auto args = std::vector<std::string_view>(argv, argv + argc);
     auto program = args.at(0).substr(args.at(0).find_last_of("/") + 1);
 
+    // Filter of mipmaps made on the CPU, by the texture converter and by the loader at runtime
+    auto mip_filter = std::optional<engine::MipFilter>();
+
+    if (auto flag = std::ranges::find(args, "--mip-filter"); flag != args.end()) {
+
+        if (std::next(flag) == args.end() || !(mip_filter = engine::parse_mip_filter(*std::next(flag)))) {
+            fmt::print("usage: {} --mip-filter <blit|box|kaiser|lanczos>\n", program);
+            return 1;
+        }
+
+        args.erase(flag, std::next(flag, 2));
+
+    }
+
+    // Offline conversion runs without a window or device
+    if (auto flag = std::ranges::find(args, "--convert-mesh"); flag != args.end()) {
+
+        if (std::distance(flag, args.end()) < 2) {
+            fmt::print("usage: {} --convert-mesh <source.obj> [output.mesh]\n", program);
+            return 1;
+        }
+
+        auto source = std::filesystem::path(*std::next(flag));
+        auto cache = std::distance(flag, args.end()) > 2 ? std::filesystem::path(*std::next(flag, 2)) : engine::MeshCache::get_cache_path(source);
+
+        return engine::MeshCache::convert(source, cache) ? 0 : 1;
+
+    }
+
+    if (auto flag = std::ranges::find(args, "--convert-texture"); flag != args.end()) {
+
+        if (std::distance(flag, args.end()) < 2) {
+            fmt::print("usage: {} --convert-texture <source> [output.ktx2]\n", program);
+            return 1;
+        }
+
+        auto source = std::filesystem::path(*std::next(flag));
+        auto output = std::distance(flag, args.end()) > 2 ? std::filesystem::path(*std::next(flag, 2)) : std::filesystem::path(source).replace_extension(".ktx2");
+
+        return engine::TextureLoader::convert(source, output, mip_filter.value_or(engine::MipFilter::kaiser)) ? 0 : 1;
+
+    }
+
+    if (mip_filter) engine::TextureLoader::set_mip_filter(*mip_filter);
+
     auto app = std::make_unique<App>(program);
 
-    app->run();
+    if (!app->run_benchmark(args)) app->run();
 
     return 0;
     
@@ -0,0 +1,94 @@
+// Packs compiled SPIR-V files into a single shader archive, run by the build after glslc
+// usage: shader-packer <output> <shader.stage.spv>...
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../source/engine/core/shader_archive_format.hpp"
+
+using namespace engine;
+
+static uint32_t get_stage (const std::filesystem::path& path) {
+
+    // VkShaderStageFlagBits, taken from the extension in front of .spv
+    auto extension = path.stem().extension();
+
+    if (extension == ".vert") return 0x00000001;
+    if (extension == ".frag") return 0x00000010;
+    if (extension == ".comp") return 0x00000020;
+
+    return 0;
+
+}
+
+int main (int argc, char** argv) {
+
+    if (argc < 2) {
+        std::cerr << "usage: shader-packer <output> <shader.stage.spv>...\n";
+        return 1;
+    }
+
+    auto header = ShaderArchiveHeader { .entry_count = static_cast<uint32_t>(argc - 2) };
+    auto entries = std::vector<ShaderArchiveEntry>(header.entry_count);
+    auto blobs = std::vector<std::vector<char>>(header.entry_count);
+
+    auto offset = sizeof(ShaderArchiveHeader) + entries.size() * sizeof(ShaderArchiveEntry);
+
+    for (std::size_t i = 0; i < entries.size(); i++) {
+
+        auto path = std::filesystem::path(argv[i + 2]);
+        auto name = path.stem().string();
+
+        auto file = std::ifstream(path, std::ios::binary);
+        blobs[i] = std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        if (!file || get_stage(path) == 0 || name.size() >= sizeof(ShaderArchiveEntry::name) || blobs[i].size() % sizeof(uint32_t)) {
+            std::cerr << "shader-packer: cannot pack " << path << "\n";
+            return 1;
+        }
+
+        offset = (offset + shader_archive_alignment - 1) / shader_archive_alignment * shader_archive_alignment;
+
+        auto& entry = entries[i];
+        std::memcpy(entry.name, name.data(), name.size());
+        entry.stage = get_stage(path);
+        entry.offset = offset;
+        entry.size = blobs[i].size();
+        entry.hash = hash_shader_code(reinterpret_cast<const unsigned char*>(blobs[i].data()), blobs[i].size());
+
+        offset += entry.size;
+
+    }
+
+    // Write next to the target and rename, so a running engine never maps a half written archive
+    auto output = std::filesystem::path(argv[1]);
+    auto temporary = output; temporary += ".tmp";
+
+    {
+        auto file = std::ofstream(temporary, std::ios::binary | std::ios::trunc);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ShaderArchiveEntry));
+
+        for (std::size_t i = 0; i < entries.size(); i++) {
+            auto padding = std::vector<char>(entries[i].offset - static_cast<std::size_t>(file.tellp()), 0);
+            file.write(padding.data(), padding.size());
+            file.write(blobs[i].data(), blobs[i].size());
+        }
+
+        if (!file) {
+            std::cerr << "shader-packer: failed to write " << temporary << "\n";
+            return 1;
+        }
+    }
+
+    std::filesystem::rename(temporary, output);
+
+    return 0;
+
+}